@@ -0,0 +1,155 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+
+/** Notes: *************************************************************************** 
+
+Helpers shared by the benchmarks. Each benchmark prints a table for the reader and,
+with -o <file>, appends its results to a CSV-file, one row per value:
+
+  bench,metric,value,unit
+  latency,press->fork.p50,612.4,us
+
+The rows of two builds can thus be joined on bench and metric and compared. The
+daemon under test is started with a private configuration and socket and is only
+considered up, once it answered its first command.
+
+*************************************************************************************/
+
+/** Global Includes: ****************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <vector>
+#include <algorithm>
+
+/** Local Defines: ******************************************************************/
+
+#define BENCH_TIMEOUT_NS 5000000000ULL
+
+/** Helper Functions: ***************************************************************/
+
+inline unsigned long long Now() {
+    struct timespec Time;
+    clock_gettime(CLOCK_REALTIME, &Time);
+    return (unsigned long long) Time.tv_sec * 1000000000ULL + Time.tv_nsec;
+}
+
+inline void SleepUntil(unsigned long long ullTime) {
+    struct timespec Time;
+    Time.tv_sec  = ullTime / 1000000000ULL;
+    Time.tv_nsec = ullTime % 1000000000ULL;
+    while (clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &Time, 0) == EINTR);
+}
+
+inline bool SendCommand(const char* sSocket, const char* sCommand) {
+    int    iSocketID;
+    char   Buffer[256];
+    struct sockaddr_un SocketAddress;
+    bool   bResult;
+    /** Connect to the private socket of the daemon under test:                     */
+    iSocketID = socket(AF_LOCAL, SOCK_STREAM, 0);
+    if (iSocketID < 0) return false;
+    memset(&SocketAddress, 0, sizeof(SocketAddress));
+    SocketAddress.sun_family = AF_LOCAL;
+    snprintf(SocketAddress.sun_path, sizeof(SocketAddress.sun_path), "%s", sSocket);
+    bResult = (connect(iSocketID, (struct sockaddr*) &SocketAddress, sizeof(SocketAddress)) == 0);
+    /** Send the command and wait for the reply, if there is one:                   */
+    if ((bResult) && (sCommand != 0)) {
+        send(iSocketID, sCommand, strlen(sCommand), 0);
+        recv(iSocketID, Buffer, sizeof(Buffer), 0);
+    }
+    close(iSocketID);
+    return bResult;
+}
+
+inline bool WriteFile(const char* sFileName, const char* sContent, mode_t Mode) {
+    FILE *fp;
+    fp = fopen(sFileName, "w");
+    if (fp == 0) return false;
+    fputs(sContent, fp);
+    fclose(fp);
+    chmod(sFileName, Mode);
+    return true;
+}
+
+inline bool StartDaemon(const char* sBinary, const char* sConfig, const char* sSocket) {
+    unsigned long long ullStart;
+    pid_t pid;
+    char  sStatus[256];
+    /** The daemon forks itself into the background, its socket is given via env:   */
+    setenv("BUZZERD_SOCKET", sSocket, 1);
+    snprintf(sStatus, sizeof(sStatus), "%s.status", sSocket);
+    setenv("BUZZERD_STATUS", sStatus, 1);
+    pid = fork();
+    if (pid == 0) {
+        execl(sBinary, sBinary, "-c", sConfig, (char*) 0);
+        _exit(127);
+    }
+    if (pid < 0) return false;
+    waitpid(pid, 0, 0);
+    /** The socket is bound before the fork, so wait for the first reply instead:   */
+    ullStart = Now();
+    while (! SendCommand(sSocket, "-w\n")) {
+        if ((Now() - ullStart) > BENCH_TIMEOUT_NS) return false;
+        usleep(1000);
+    }
+    return true;
+}
+
+inline unsigned long long Percentile(std::vector<unsigned long long>& Values, double dRank) {
+    size_t i;
+    if (Values.empty()) return 0;
+    std::sort(Values.begin(), Values.end());
+    i = (size_t) (dRank * (Values.size() - 1) + 0.5);
+    return Values[i];
+}
+
+inline void WriteResult(const char* sFile, const char* sBench, const char* sMetric, double dValue, const char* sUnit) {
+    FILE *fp;
+    /** Without a file, there is only the table:                                    */
+    if (sFile == 0) return;
+    fp = fopen(sFile, "a");
+    if (fp == 0) return;
+    fseek(fp, 0, SEEK_END);
+    if (ftell(fp) == 0) fprintf(fp, "bench,metric,value,unit\n");
+    fprintf(fp, "%s,%s,%.1f,%s\n", sBench, sMetric, dValue, sUnit);
+    fclose(fp);
+}
+
+inline void WriteTails(const char* sFile, const char* sBench, const char* sMetric,
+                       std::vector<unsigned long long>& Values) {
+    char sName[128];
+    /** The usual percentiles of a latency in us:                                   */
+    snprintf(sName, sizeof(sName), "%s.p50",  sMetric);
+    WriteResult(sFile, sBench, sName, Percentile(Values, 0.50)  / 1000.0, "us");
+    snprintf(sName, sizeof(sName), "%s.p99",  sMetric);
+    WriteResult(sFile, sBench, sName, Percentile(Values, 0.99)  / 1000.0, "us");
+    snprintf(sName, sizeof(sName), "%s.p999", sMetric);
+    WriteResult(sFile, sBench, sName, Percentile(Values, 0.999) / 1000.0, "us");
+    snprintf(sName, sizeof(sName), "%s.max",  sMetric);
+    WriteResult(sFile, sBench, sName, Percentile(Values, 1.00)  / 1000.0, "us");
+}
@@ -0,0 +1,202 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+
+/** Notes: *************************************************************************** 
+
+Jitter benchmark of the input-thread. It samples a simulated GPIO with the real
+input-thread and gesture-engine at 1 kHz and reports, how far the intervals between
+the samples deviate from the period: once as a normal thread and once with SCHED_FIFO,
+each on an idle system and under synthetic load. The load is one busy process per CPU
+plus one process, which writes and syncs a file in a loop:
+
+  normal/idle  normal/load  fifo/idle  fifo/load
+
+SCHED_FIFO needs root or CAP_SYS_NICE, otherwise its rows show the normal thread.
+
+Usage: buzzerd-jitter [-d <seconds>] [-c <cpu>] [-p <priority>] [-o <csv-file>]
+
+*************************************************************************************/
+
+/** Global Includes: ****************************************************************/
+
+#include <stdlib.h>
+#include <fcntl.h>
+#include <signal.h>
+
+#include "Bench.h"
+#include "../src/GpioBackend.h"
+#include "../src/PressRing.h"
+#include "../src/Gestures.h"
+#include "../src/InputThread.h"
+
+/** Local Defines: ******************************************************************/
+
+#define PERIOD_NS       1000000ULL
+#define DEFAULT_SECONDS 2
+#define DEFAULT_PRIO    50
+#define MAX_SAMPLES     100000
+
+/** Class Definition: ***************************************************************/
+
+/** Reads no button at all, but notes the time of each sample:                      */
+
+class CGpioClock : public CGpioBackend {
+public:
+    // Properties:
+    unsigned long long ull_Samples[MAX_SAMPLES];
+    int                i_Samples;
+    // Methods:
+    CGpioClock() : i_Samples(0) {};
+    bool Init      (const unsigned int* puiButtons, const int* piLeds, int nButtons) { return true; };
+    void Close     () {};
+    void WriteLed  (int iButton, bool bOn) {};
+    unsigned long long ReadButtons() {
+        struct timespec Time;
+        clock_gettime(CLOCK_MONOTONIC, &Time);
+        if (i_Samples < MAX_SAMPLES) {
+            ull_Samples[i_Samples++] = (unsigned long long) Time.tv_sec * 1000000000ULL + Time.tv_nsec;
+        }
+        return 0;
+    };
+};
+
+/** Global Variables: ***************************************************************/
+
+const char* s_Csv = 0;
+CGpioClock  Clock;
+CPressRing  Ring;
+CGestures   Gestures;
+std::vector<pid_t> Load;
+
+/** Helper Functions: ***************************************************************/
+
+void StartLoad() {
+    /** Variables:                                                                  */
+    char  sFile[64], Buffer[65536];
+    long  i, nCpus;
+    pid_t pid;
+    int   iFd;
+    /** One busy process per CPU:                                                   */
+    nCpus = sysconf(_SC_NPROCESSORS_ONLN);
+    for (i=0; i<nCpus; i++) {
+        pid = fork();
+        if (pid == 0) {
+            for (;;) asm volatile("");
+        }
+        if (pid > 0) Load.push_back(pid);
+    }
+    /** One process, which keeps the disk and the page-cache busy:                  */
+    pid = fork();
+    if (pid == 0) {
+        snprintf(sFile, sizeof(sFile), "/tmp/buzzerd-jitter.%i", getpid());
+        iFd = open(sFile, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        unlink(sFile);
+        memset(Buffer, 0x55, sizeof(Buffer));
+        while (iFd >= 0) {
+            for (i=0; i<64; i++) {
+                if (write(iFd, Buffer, sizeof(Buffer)) < 0) break;
+            }
+            fsync(iFd);
+            lseek(iFd, 0, SEEK_SET);
+        }
+        _exit(0);
+    }
+    if (pid > 0) Load.push_back(pid);
+}
+
+void StopLoad() {
+    /** Variables:                                                                  */
+    size_t i;
+    for (i=0; i<Load.size(); i++) kill(Load[i], SIGKILL);
+    for (i=0; i<Load.size(); i++) waitpid(Load[i], 0, 0);
+    Load.clear();
+}
+
+void Measure(const char* sName, int iSeconds, int iPriority, int iCpu, bool bLoad) {
+    /** Variables:                                                                  */
+    CInputThread       Input;
+    unsigned long long ullPins[GESTURE_COUNT];
+    std::vector<unsigned long long> Deviation;
+    long long          llDelta;
+    bool               bRealtime;
+    int                i;
+    /** Sample for the given time with the real input-thread:                       */
+    memset(ullPins, 0, sizeof(ullPins));
+    Gestures.Configure(&Ring, ullPins, 5000000ULL, PERIOD_NS, 800000000ULL, 300000000ULL, 200000000ULL);
+    Clock.i_Samples = 0;
+    if (bLoad) StartLoad();
+    if (! Input.Start(&Clock, &Gestures, &Ring, PERIOD_NS, iPriority, iCpu)) {
+        printf("ERR: Unable to start the input-thread!\n");
+        StopLoad();
+        return;
+    }
+    bRealtime = Input.Realtime();
+    sleep(iSeconds);
+    Input.Stop();
+    StopLoad();
+    /** Each interval is compared with the period:                                  */
+    for (i=1; i<Clock.i_Samples; i++) {
+        llDelta = (long long) (Clock.ull_Samples[i] - Clock.ull_Samples[i-1]) - (long long) PERIOD_NS;
+        Deviation.push_back((llDelta < 0) ? -llDelta : llDelta);
+    }
+    printf("  %-12s %8i %10.1f %10.1f %10.1f %10.1f%s\n", sName, Clock.i_Samples,
+           Percentile(Deviation, 0.50)  / 1000.0,
+           Percentile(Deviation, 0.99)  / 1000.0,
+           Percentile(Deviation, 0.999) / 1000.0,
+           Percentile(Deviation, 1.00)  / 1000.0,
+           ((iPriority > 0) && (! bRealtime)) ? "  (no SCHED_FIFO)" : "");
+    WriteTails(s_Csv, "jitter", sName, Deviation);
+}
+
+/** Main-Function: ******************************************************************/
+
+int main(int argc, char **argv) {
+    /** Variables:                                                                  */
+    int iSeconds  = DEFAULT_SECONDS;
+    int iPriority = DEFAULT_PRIO;
+    int iCpu      = -1;
+    int i;
+    
+    /** Parse the arguments:                                                        */
+    for (i=1; i<argc; i++) {
+        if ((strcmp(argv[i], "-d") == 0) && (i+1 < argc)) {
+            iSeconds  = atoi(argv[++i]);
+        }else if ((strcmp(argv[i], "-c") == 0) && (i+1 < argc)) {
+            iCpu      = atoi(argv[++i]);
+        }else if ((strcmp(argv[i], "-p") == 0) && (i+1 < argc)) {
+            iPriority = atoi(argv[++i]);
+        }else if ((strcmp(argv[i], "-o") == 0) && (i+1 < argc)) {
+            s_Csv     = argv[++i];
+        }else{
+            printf("Usage: %s [-d <seconds>] [-c <cpu>] [-p <priority>] [-o <csv-file>]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (iSeconds < 1) iSeconds = 1;
+    
+    /** Run all four cases and report the deviation of the intervals:               */
+    printf("Deviation of the sampling-interval of %llu us in us:\n", PERIOD_NS / 1000);
+    printf("  %-12s %8s %10s %10s %10s %10s\n", "", "samples", "p50", "p99", "p99.9", "max");
+    Measure("normal/idle", iSeconds, 0,         iCpu, false);
+    Measure("normal/load", iSeconds, 0,         iCpu, true );
+    Measure("fifo/idle",   iSeconds, iPriority, iCpu, false);
+    Measure("fifo/load",   iSeconds, iPriority, iCpu, true );
+    return 0;
+}
@@ -0,0 +1,197 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/** Notes: *************************************************************************** 
+
+End-to-end latency benchmark of the daemon on the simulated GPIO backend. It starts
+the given buzzerd binary with a private configuration, socket and FIFO, injects
+presses through the FIFO and evaluates the record-file of the simulation. The handler
+alternates its exit-code, so that every press toggles the LED in the success-mode:
+
+  press->fork  time from the injected edge until the daemon forked
+  press->exec  time from the injected edge until the handler-script was running
+  exit->LED    time from reaping the handler until the LED was written
+
+Usage: buzzerd-bench <path-to-buzzerd> [-n <presses>] [-o <csv-file>]
+
+*************************************************************************************/
+
+/** Global Includes: ****************************************************************/
+
+#include <stdlib.h>
+#include <fcntl.h>
+#include <signal.h>
+
+#include "Bench.h"
+
+/** Local Defines: ******************************************************************/
+
+#define DEFAULT_PRESSES 1000
+#define GAP_NS          60000000ULL
+#define TIMEOUT_NS      5000000000ULL
+
+/** Global Variables: ***************************************************************/
+
+char s_Dir    [256];
+char s_Config [512];
+char s_Script [512];
+char s_Fifo   [512];
+char s_Record [512];
+char s_Socket [108];
+char s_Output [512];
+char s_State  [512];
+
+/** Helper Functions: ***************************************************************/
+
+void PrintRow(const char* sName, std::vector<unsigned long long>& Values) {
+    printf("  %-12s %10.1f %10.1f %10.1f\n", sName,
+           Percentile(Values, 0.50) / 1000.0,
+           Percentile(Values, 0.99) / 1000.0,
+           Percentile(Values, 1.00) / 1000.0);
+}
+
+/** Main-Function: ******************************************************************/
+
+int main(int argc, char **argv) {
+    /** Variables:                                                                  */
+    int                iPresses = DEFAULT_PRESSES;
+    int                i, iFifo, iRecord, iLost = 0;
+    char               sBuffer[4096], sLine[128];
+    int                iLineLen = 0;
+    ssize_t            RxLen;
+    unsigned long long ullPress, ullFork, ullExec, ullExit, ullLed, ullStamp;
+    const char*        sCsv = 0;
+    char               cEvent;
+    std::vector<unsigned long long> PressFork, PressExec, ExitLed;
+    
+    /** Parse the arguments:                                                        */
+    if (argc < 2) {
+        printf("Usage: %s <path-to-buzzerd> [-n <presses>] [-o <csv-file>]\n", argv[0]);
+        return 1;
+    }
+    for (i=2; i<(argc-1); i++) {
+        if (strcmp(argv[i], "-n") == 0) iPresses = atoi(argv[i+1]);
+        if (strcmp(argv[i], "-o") == 0) sCsv     = argv[i+1];
+    }
+    
+    /** Prepare a private directory with configuration, handler and socket:         */
+    strcpy(s_Dir, "/tmp/buzzerd-bench.XXXXXX");
+    if (mkdtemp(s_Dir) == 0) {
+        printf("ERR: Unable to create a temporary directory!\n");
+        return 1;
+    }
+    snprintf(s_Config, sizeof(s_Config), "%s/buzzerd.conf", s_Dir);
+    snprintf(s_Script, sizeof(s_Script), "%s/handler.sh",   s_Dir);
+    snprintf(s_Fifo,   sizeof(s_Fifo),   "%s/input",        s_Dir);
+    snprintf(s_Record, sizeof(s_Record), "%s/record",       s_Dir);
+    snprintf(s_Socket, sizeof(s_Socket), "%s/socket",       s_Dir);
+    snprintf(s_Output, sizeof(s_Output), "%s/output",       s_Dir);
+    snprintf(s_State,  sizeof(s_State),  "%s/state",        s_Dir);
+    snprintf(sBuffer, sizeof(sBuffer),
+             "#!/bin/bash\nprintf 'E %%s 0\\n' \"${EPOCHREALTIME/./}000\" >> %s\n"
+             "read -r n < %s\necho $((1-n)) > %s\nexit $n\n",
+             s_Record, s_State, s_State);
+    WriteFile(s_Script, sBuffer, 0755);
+    snprintf(sBuffer, sizeof(sBuffer),
+             "Executable   %s\nClientOutput %s\nLED          success\n"
+             "Input        sim\nSimInput     %s\nSimRecord    %s\n",
+             s_Script, s_Output, s_Fifo, s_Record);
+    WriteFile(s_Config, sBuffer, 0644);
+    WriteFile(s_Record, "", 0666);
+    WriteFile(s_State,  "0", 0666);
+    
+    /** Start the daemon, which forks itself into the background:                   */
+    if (! StartDaemon(argv[1], s_Config, s_Socket)) {
+        printf("ERR: The daemon did not come up!\n");
+        return 1;
+    }
+    iFifo   = open(s_Fifo,   O_WRONLY);
+    iRecord = open(s_Record, O_RDONLY);
+    if ((iFifo < 0) || (iRecord < 0)) {
+        printf("ERR: Unable to open the simulation files!\n");
+        SendCommand(s_Socket, "-q\n");
+        return 1;
+    }
+    
+    /** Inject the presses one after another:                                       */
+    printf("Injecting %i presses ...\n", iPresses);
+    for (i=0; i<iPresses; i++) {
+        /** Press and release the button:                                           */
+        ullPress = Now();
+        snprintf(sBuffer, sizeof(sBuffer), "press %llu\nrelease %llu\n", ullPress, ullPress + 1000000ULL);
+        write(iFifo, sBuffer, strlen(sBuffer));
+        /** Follow the record until the LED was updated after the handler exited:   */
+        ullFork = ullExec = ullExit = ullLed = 0;
+        while ((ullLed == 0) && ((Now() - ullPress) < TIMEOUT_NS)) {
+            RxLen = read(iRecord, sBuffer, sizeof(sBuffer));
+            if (RxLen <= 0) {
+                usleep(100);
+                continue;
+            }
+            for (ssize_t n=0; n<RxLen; n++) {
+                if (sBuffer[n] != '\n') {
+                    if (iLineLen < (int) sizeof(sLine) - 1) sLine[iLineLen++] = sBuffer[n];
+                    continue;
+                }
+                sLine[iLineLen] = 0;
+                iLineLen        = 0;
+                if (sscanf(sLine, "%c %llu", &cEvent, &ullStamp) != 2) continue;
+                if (ullStamp < ullPress) continue;
+                if      ((cEvent == 'F') && (ullFork == 0))                    ullFork = ullStamp;
+                else if ((cEvent == 'E') && (ullExec == 0))                    ullExec = ullStamp;
+                else if ((cEvent == 'X') && (ullExit == 0))                    ullExit = ullStamp;
+                else if ((cEvent == 'L') && (ullExit != 0) && (ullLed == 0))   ullLed  = ullStamp;
+            }
+        }
+        if ((ullFork == 0) || (ullExec == 0) || (ullLed == 0)) {
+            iLost++;
+        }else{
+            PressFork.push_back(ullFork - ullPress);
+            PressExec.push_back(ullExec - ullPress);
+            ExitLed  .push_back(ullLed  - ullExit );
+        }
+        /** Keep the next press out of the debounce-window:                         */
+        SleepUntil(ullPress + GAP_NS);
+    }
+    
+    /** Shut the daemon down and clean up:                                          */
+    SendCommand(s_Socket, "-q\n");
+    close(iFifo);
+    close(iRecord);
+    unlink(s_Config);
+    unlink(s_Script);
+    unlink(s_Fifo);
+    unlink(s_Record);
+    unlink(s_Output);
+    unlink(s_State);
+    unlink(s_Socket);
+    rmdir(s_Dir);
+    
+    /** Report the results:                                                         */
+    printf("\nLatency over %i presses in us (%i lost):\n", (int) PressFork.size(), iLost);
+    printf("  %-12s %10s %10s %10s\n", "", "p50", "p99", "max");
+    PrintRow("press->fork", PressFork);
+    PrintRow("press->exec", PressExec);
+    PrintRow("exit->LED",   ExitLed);
+    WriteTails (sCsv, "latency", "press->fork", PressFork);
+    WriteTails (sCsv, "latency", "press->exec", PressExec);
+    WriteTails (sCsv, "latency", "exit->LED",   ExitLed);
+    WriteResult(sCsv, "latency", "lost", iLost, "presses");
+    return (iLost == 0) ? 0 : 2;
+}
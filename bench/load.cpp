@@ -0,0 +1,240 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+
+/** Notes: *************************************************************************** 
+
+Load generator for the control-socket. It opens many connections at once, each of
+which sends a command, waits for its reply and sends the next one, and reports the
+commands per second and the latency from sending a command until its reply:
+
+  commands/s   all replies of all connections per second
+  latency      time from sending a command until its complete reply
+
+Without -s, it starts the given buzzerd binary on the simulated GPIO with a private
+configuration and socket, like the latency benchmark, so no hardware is needed.
+
+Usage: buzzerd-load <path-to-buzzerd> | -s <socket> [-c <connections>] [-d <seconds>]
+                    [-m <command>] [-o <csv-file>]
+
+*************************************************************************************/
+
+/** Global Includes: ****************************************************************/
+
+#include <stdlib.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+
+#include "Bench.h"
+
+/** Local Defines: ******************************************************************/
+
+#define DEFAULT_CONNECTIONS 32
+#define DEFAULT_SECONDS     3
+#define MAX_CONNECTIONS     64                  // Limit of the control-server.
+
+/** Type-Definitions: ***************************************************************/
+
+struct SLoadClient {
+    int                i_Fd;
+    unsigned long long ull_Sent;                // Time of the pending command.
+    int                i_RxLen;
+    char               s_Rx[1024];
+};
+
+/** Global Variables: ***************************************************************/
+
+char        s_Dir    [256];
+char        s_Config [512];
+char        s_Fifo   [512];
+char        s_Socket [108];
+SLoadClient Clients[MAX_CONNECTIONS];
+
+/** Helper Functions: ***************************************************************/
+
+int Connect(const char* sSocket) {
+    struct sockaddr_un Address;
+    int iFd;
+    /** Connect, before the socket is made non-blocking:                            */
+    iFd = socket(AF_LOCAL, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (iFd < 0) return -1;
+    memset(&Address, 0, sizeof(Address));
+    Address.sun_family = AF_LOCAL;
+    snprintf(Address.sun_path, sizeof(Address.sun_path), "%s", sSocket);
+    if (connect(iFd, (struct sockaddr*) &Address, sizeof(Address)) != 0) {
+        close(iFd);
+        return -1;
+    }
+    fcntl(iFd, F_SETFL, O_NONBLOCK);
+    return iFd;
+}
+
+/** Main-Function: ******************************************************************/
+
+int main(int argc, char **argv) {
+    /** Variables:                                                                  */
+    const char*        sBinary = 0;
+    const char*        sCsv    = 0;
+    const char*        sSocket = 0;
+    char               sCommand[256] = "-w";
+    char               sBuffer[1024];
+    int                iConnections = DEFAULT_CONNECTIONS;
+    int                iSeconds     = DEFAULT_SECONDS;
+    int                i, j, n, iEpoll, iLen, iErrors = 0;
+    ssize_t            RxLen;
+    char*              pEnd;
+    SLoadClient*       pClient;
+    struct epoll_event Event, Events[MAX_CONNECTIONS];
+    unsigned long long ullStart, ullEnd, ullNow;
+    std::vector<unsigned long long> Latency;
+    
+    /** Parse the arguments:                                                        */
+    for (i=1; i<argc; i++) {
+        if ((strcmp(argv[i], "-s") == 0) && (i+1 < argc)) {
+            sSocket      = argv[++i];
+        }else if ((strcmp(argv[i], "-c") == 0) && (i+1 < argc)) {
+            iConnections = atoi(argv[++i]);
+        }else if ((strcmp(argv[i], "-d") == 0) && (i+1 < argc)) {
+            iSeconds     = atoi(argv[++i]);
+        }else if ((strcmp(argv[i], "-m") == 0) && (i+1 < argc)) {
+            snprintf(sCommand, sizeof(sCommand), "%s", argv[++i]);
+        }else if ((strcmp(argv[i], "-o") == 0) && (i+1 < argc)) {
+            sCsv         = argv[++i];
+        }else if ((argv[i][0] != '-') && (sBinary == 0)) {
+            sBinary      = argv[i];
+        }else{
+            sBinary      = 0;
+            sSocket      = 0;
+            break;
+        }
+    }
+    if ((sBinary == 0) && (sSocket == 0)) {
+        printf("Usage: %s <path-to-buzzerd> | -s <socket> [-c <connections>] [-d <seconds>] [-m <command>] "
+               "[-o <csv-file>]\n", argv[0]);
+        return 1;
+    }
+    if (iConnections < 1)               iConnections = 1;
+    if (iConnections > MAX_CONNECTIONS) iConnections = MAX_CONNECTIONS;
+    if (iSeconds < 1)                   iSeconds     = 1;
+    strcat(sCommand, "\n");
+    
+    /** Start a daemon of its own, unless a running one is given:                   */
+    if (sSocket == 0) {
+        strcpy(s_Dir, "/tmp/buzzerd-load.XXXXXX");
+        if (mkdtemp(s_Dir) == 0) {
+            printf("ERR: Unable to create a temporary directory!\n");
+            return 1;
+        }
+        snprintf(s_Config, sizeof(s_Config), "%s/buzzerd.conf", s_Dir);
+        snprintf(s_Fifo,   sizeof(s_Fifo),   "%s/input",        s_Dir);
+        snprintf(s_Socket, sizeof(s_Socket), "%s/socket",       s_Dir);
+        snprintf(sBuffer, sizeof(sBuffer),
+                 "Executable   /bin/true\nClientOutput /dev/null\nLED          success\n"
+                 "Input        sim\nSimInput     %s\n", s_Fifo);
+        WriteFile(s_Config, sBuffer, 0644);
+        if (! StartDaemon(sBinary, s_Config, s_Socket)) {
+            printf("ERR: The daemon did not come up!\n");
+            return 1;
+        }
+        sSocket = s_Socket;
+    }
+    
+    /** Open all connections and send their first command:                          */
+    iEpoll = epoll_create1(EPOLL_CLOEXEC);
+    iLen   = strlen(sCommand);
+    for (i=0; i<iConnections; i++) {
+        Clients[i].i_Fd    = Connect(sSocket);
+        Clients[i].i_RxLen = 0;
+        if (Clients[i].i_Fd < 0) {
+            printf("ERR: Unable to open connection %i!\n", i + 1);
+            iConnections = i;
+            break;
+        }
+        memset(&Event, 0, sizeof(Event));
+        Event.events   = EPOLLIN;
+        Event.data.u32 = i;
+        epoll_ctl(iEpoll, EPOLL_CTL_ADD, Clients[i].i_Fd, &Event);
+    }
+    printf("Sending \"%.*s\" on %i connections for %i s ...\n", iLen - 1, sCommand, iConnections, iSeconds);
+    ullStart = Now();
+    ullEnd   = ullStart + iSeconds * 1000000000ULL;
+    for (i=0; i<iConnections; i++) {
+        Clients[i].ull_Sent = Now();
+        send(Clients[i].i_Fd, sCommand, iLen, MSG_NOSIGNAL);
+    }
+    
+    /** Each reply is timed and answered with the next command:                     */
+    ullNow = ullStart;
+    while ((ullNow < ullEnd) && (iConnections > 0)) {
+        n = epoll_wait(iEpoll, Events, MAX_CONNECTIONS, 100);
+        ullNow = Now();
+        for (i=0; i<n; i++) {
+            pClient = &Clients[Events[i].data.u32];
+            RxLen   = recv(pClient->i_Fd, &pClient->s_Rx[pClient->i_RxLen], sizeof(pClient->s_Rx) - pClient->i_RxLen, 0);
+            if (RxLen <= 0) {
+                if ((RxLen < 0) && (errno == EAGAIN)) continue;
+                printf("ERR: The daemon closed a connection!\n");
+                ullEnd = ullNow;
+                break;
+            }
+            pClient->i_RxLen += RxLen;
+            pEnd = (char*) memchr(pClient->s_Rx, '\n', pClient->i_RxLen);
+            if (pEnd == 0) {
+                if (pClient->i_RxLen == (int) sizeof(pClient->s_Rx)) pClient->i_RxLen = 0;
+                continue;
+            }
+            /** The reply is complete, so the next command follows right away:      */
+            Latency.push_back(ullNow - pClient->ull_Sent);
+            if (strncmp(pClient->s_Rx, "ERR", 3) == 0) iErrors++;
+            j = (pEnd - pClient->s_Rx) + 1;
+            pClient->i_RxLen -= j;
+            memmove(pClient->s_Rx, &pClient->s_Rx[j], pClient->i_RxLen);
+            pClient->ull_Sent = Now();
+            send(pClient->i_Fd, sCommand, iLen, MSG_NOSIGNAL);
+        }
+    }
+    ullNow = Now();
+    
+    /** Close the connections and shut down the own daemon:                         */
+    for (i=0; i<iConnections; i++) close(Clients[i].i_Fd);
+    close(iEpoll);
+    if (sSocket == s_Socket) {
+        SendCommand(s_Socket, "-q\n");
+        unlink(s_Config);
+        unlink(s_Fifo);
+        unlink(s_Socket);
+        rmdir(s_Dir);
+    }
+    
+    /** Report the results:                                                         */
+    printf("\n%i commands in %.2f s (%i errors): %.0f commands/s\n", (int) Latency.size(),
+           (ullNow - ullStart) / 1e9, iErrors, Latency.size() * 1e9 / (ullNow - ullStart));
+    printf("Latency in us:\n");
+    printf("  %-12s %10s %10s %10s %10s\n", "", "p50", "p99", "p99.9", "max");
+    printf("  %-12s %10.1f %10.1f %10.1f %10.1f\n", "command",
+           Percentile(Latency, 0.50)  / 1000.0,
+           Percentile(Latency, 0.99)  / 1000.0,
+           Percentile(Latency, 0.999) / 1000.0,
+           Percentile(Latency, 1.00)  / 1000.0);
+    WriteResult(sCsv, "load", "connections", iConnections, "connections");
+    WriteResult(sCsv, "load", "commands/s", Latency.size() * 1e9 / (ullNow - ullStart), "1/s");
+    WriteResult(sCsv, "load", "errors", iErrors, "commands");
+    WriteTails (sCsv, "load", "command", Latency);
+    return (iErrors == 0) ? 0 : 2;
+}
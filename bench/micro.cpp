@@ -0,0 +1,272 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+
+/** Notes: *************************************************************************** 
+
+Microbenchmarks of the hot paths of the daemon, which run within this process and
+need neither the daemon nor any GPIO:
+
+  checkcmd     CConfigHandler::CheckCmd, one line against all keys of the parser
+  readconfig   CConfigHandler::ReadConfig of a configuration with 32 buttons
+  dispatch     CConfigHandler::HandleCommand of a query and of an LED-command
+  client       one command through CControlServer on a local socket, incl. reply
+  spawn        CSpawner::Spawn of /bin/true and the time until it was reaped
+
+Usage: buzzerd-micro [-n <iterations>] [-o <csv-file>]
+
+*************************************************************************************/
+
+/** Global Includes: ****************************************************************/
+
+#include <stdlib.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+
+#include "Bench.h"
+#include "../src/ConfigHandler.h"
+#include "../src/ControlServer.h"
+#include "../src/RunLog.h"
+#include "../src/Metrics.h"
+#include "../src/Spawner.h"
+
+/** Local Defines: ******************************************************************/
+
+#define DEFAULT_ITERATIONS 100000
+#define SPAWN_DIVISOR      20                   // Spawning is much slower.
+
+/** Global Variables: ***************************************************************/
+
+const char*    s_Csv = 0;
+char           s_Dir   [256];
+char           s_Config[512];
+char           s_Socket[108];
+CConfigHandler Config;
+CRunLog        Runs;
+CMetrics       Metrics;
+CControlServer Control;
+
+/** The keys, which the parser checks each line of the configuration-file for:      */
+
+const char* s_Keys[] = {
+    "Executable", "ClientOutput", "LED", "LedBusy", "LedFailure", "LedTimeout", "LedBrightness", "ExecMode",
+    "Workers", "MaxParallel", "QueueSize", "Overflow", "BatchSize", "BatchWindow", "Timeout", "KillGrace",
+    "LimitCpu", "LimitMemory", "Cgroup", "CpuMax", "MemoryMax", "Input", "GpioChip", "ButtonPin", "LedPin",
+    "Button", "SimInput", "SimRecord", "TraceRecord", "Journal", "JournalSize", "JournalSync", "MetricsFile",
+    "MetricsInterval", "SampleRate", "RealtimePriority", "RealtimeCpu", "Debounce", "LongPress",
+    "DoublePress", "HoldRepeat", "debug", 0
+};
+
+/** Helper Functions: ***************************************************************/
+
+void PrintRow(const char* sName, int iOps, unsigned long long ullTime) {
+    /** Report the mean time of one operation:                                      */
+    printf("  %-20s %10i %12.1f\n", sName, iOps, (double) ullTime / iOps);
+    WriteResult(s_Csv, "micro", sName, (double) ullTime / iOps, "ns");
+}
+
+void BenchCheckCmd(int n) {
+    /** Variables:                                                                  */
+    const char*        sLines[] = { "Button     23 led 24 long timeout 500 /usr/local/bin/next", "SampleRate   1000",
+                                    "# A comment, which is checked as well", "HoldRepeat  200" };
+    char               sLine[1024], sResult[1024];
+    unsigned long long ullStart;
+    int                i, j, k, iHits = 0;
+    /** Each line is checked against all keys, as in the parser:                    */
+    ullStart = Now();
+    for (i=0; i<n; i++) {
+        for (j=0; j<4; j++) {
+            for (k=0; s_Keys[k]!=0; k++) {
+                strcpy(sLine, sLines[j]);
+                if (CConfigHandler::CheckCmd(sLine, s_Keys[k], sResult)) iHits++;
+            }
+        }
+    }
+    PrintRow("checkcmd/line", n * 4, Now() - ullStart);
+    if (iHits == 0) printf("ERR: No key matched!\n");
+}
+
+bool BenchReadConfig(int n) {
+    /** Variables:                                                                  */
+    char               sBuffer[16384];
+    unsigned long long ullStart;
+    int                i, iLen;
+    /** A configuration with all buttons, as the parser has most to do with it:     */
+    iLen = snprintf(sBuffer, sizeof(sBuffer),
+                    "Executable   /bin/true\nClientOutput /dev/null\nLED          success\nLedBusy      fast\n"
+                    "Input        sim\nSimInput     %s/input\nSampleRate   1000\nDebounce     5\n"
+                    "MaxParallel  4\nQueueSize    256\nOverflow     coalesce\nTimeout      5000\n", s_Dir);
+    for (i=0; i<CONFIG_MAX_BUTTONS-1; i++) {
+        if ((i % 16) < 6) {
+            iLen += snprintf(&sBuffer[iLen], sizeof(sBuffer) - iLen, "Button     %i led %i %s /bin/true %i\n",
+                             i % 16, 20 + (i % 16), (i < 16) ? "press" : "long", i);
+        }else{
+            iLen += snprintf(&sBuffer[iLen], sizeof(sBuffer) - iLen, "Button     %i %s /bin/true %i\n",
+                             i % 16, (i < 16) ? "press" : "long", i);
+        }
+    }
+    WriteFile(s_Config, sBuffer, 0644);
+    ullStart = Now();
+    for (i=0; i<n; i++) {
+        if (! Config.ReadConfig(s_Config)) {
+            printf("ERR: Unable to read the configuration!\n");
+            return false;
+        }
+    }
+    PrintRow("readconfig", n, Now() - ullStart);
+    return true;
+}
+
+void BenchDispatch(int n) {
+    /** Variables:                                                                  */
+    char               sCommand[64], sReply[CTRL_LINE_SIZE];
+    unsigned long long ullStart;
+    int                i;
+    /** A query only formats its reply:                                             */
+    ullStart = Now();
+    for (i=0; i<n; i++) {
+        strcpy(sCommand, "-w");
+        Config.HandleCommand(sCommand, sReply, sizeof(sReply));
+    }
+    PrintRow("dispatch/query", n, Now() - ullStart);
+    /** An LED-command publishes a new snapshot each time:                          */
+    ullStart = Now();
+    for (i=0; i<n; i++) {
+        strcpy(sCommand, (i & 1) ? "-l on" : "-l off");
+        Config.HandleCommand(sCommand, sReply, sizeof(sReply));
+    }
+    PrintRow("dispatch/led", n, Now() - ullStart);
+}
+
+void BenchClient(int n) {
+    /** Variables:                                                                  */
+    struct sockaddr_un Address;
+    struct epoll_event Event;
+    char               sReply[256];
+    unsigned long long ullStart;
+    int                i, iServer, iClient, iEpoll, iFd;
+    /** Serve a private socket without any daemon:                                  */
+    memset(&Address, 0, sizeof(Address));
+    Address.sun_family = AF_LOCAL;
+    snprintf(Address.sun_path, sizeof(Address.sun_path), "%s", s_Socket);
+    iServer = socket(AF_LOCAL, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    iClient = socket(AF_LOCAL, SOCK_STREAM, 0);
+    iEpoll  = epoll_create1(0);
+    if ((bind(iServer, (struct sockaddr*) &Address, sizeof(Address)) != 0) || (listen(iServer, 16) != 0) ||
+        (connect(iClient, (struct sockaddr*) &Address, sizeof(Address)) != 0)) {
+        printf("ERR: Unable to set up the control-socket!\n");
+        return;
+    }
+    Control.Init(iServer, iEpoll, 1, &Config, &Runs, &Metrics);
+    Control.Accept();
+    if (epoll_wait(iEpoll, &Event, 1, 0) < 0) return;
+    send(iClient, "-w\n", 3, 0);
+    if (epoll_wait(iEpoll, &Event, 1, 1000) != 1) {
+        printf("ERR: The command did not arrive!\n");
+        return;
+    }
+    iFd = (int) (Event.data.u64 & 0xFFFFFFFF);
+    Control.HandleEvent(iFd, EPOLLIN);
+    recv(iClient, sReply, sizeof(sReply), 0);
+    /** Each command is sent, dispatched and answered, as with a real client:       */
+    ullStart = Now();
+    for (i=0; i<n; i++) {
+        send(iClient, "-w\n", 3, 0);
+        Control.HandleEvent(iFd, EPOLLIN);
+        recv(iClient, sReply, sizeof(sReply), 0);
+    }
+    PrintRow("client/command", n, Now() - ullStart);
+    close(iClient);
+    Control.Close();
+    close(iServer);
+    close(iEpoll);
+    unlink(s_Socket);
+}
+
+void BenchSpawn(int n) {
+    /** Variables:                                                                  */
+    CSpawner           Spawner;
+    std::vector<unsigned long long> Reaped;
+    unsigned long long ullStart, ullTotal = 0, ullStamps[4] = { 1, 2, 3, 4 };
+    pid_t              pid;
+    int                i, iOutput;
+    /** Spawn /bin/true with and without the stdin of a batch:                      */
+    if (! Spawner.Prepare("/bin/true", "/dev/null")) {
+        printf("ERR: Unable to prepare /bin/true!\n");
+        return;
+    }
+    for (i=0; i<n; i++) {
+        ullStart = Now();
+        pid = Spawner.Spawn(&iOutput, ullStamps, (i & 1) ? 4 : 0, -1);
+        ullTotal += Now() - ullStart;
+        if (pid < 0) {
+            printf("ERR: Unable to spawn /bin/true!\n");
+            return;
+        }
+        waitpid(pid, 0, 0);
+        Reaped.push_back(Now() - ullStart);
+        close(iOutput);
+    }
+    PrintRow("spawn", n, ullTotal);
+    printf("  %-20s %10i %12.1f\n", "spawn->reaped.p50", n, (double) Percentile(Reaped, 0.50));
+    printf("  %-20s %10i %12.1f\n", "spawn->reaped.p99", n, (double) Percentile(Reaped, 0.99));
+    WriteResult(s_Csv, "micro", "spawn->reaped.p50", Percentile(Reaped, 0.50), "ns");
+    WriteResult(s_Csv, "micro", "spawn->reaped.p99", Percentile(Reaped, 0.99), "ns");
+}
+
+/** Main-Function: ******************************************************************/
+
+int main(int argc, char **argv) {
+    /** Variables:                                                                  */
+    int n = DEFAULT_ITERATIONS;
+    int i;
+    
+    /** Parse the arguments:                                                        */
+    for (i=1; i<argc; i++) {
+        if ((strcmp(argv[i], "-n") == 0) && (i+1 < argc)) {
+            n     = atoi(argv[++i]);
+        }else if ((strcmp(argv[i], "-o") == 0) && (i+1 < argc)) {
+            s_Csv = argv[++i];
+        }else{
+            printf("Usage: %s [-n <iterations>] [-o <csv-file>]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (n < SPAWN_DIVISOR) n = SPAWN_DIVISOR;
+    strcpy(s_Dir, "/tmp/buzzerd-micro.XXXXXX");
+    if (mkdtemp(s_Dir) == 0) {
+        printf("ERR: Unable to create a temporary directory!\n");
+        return 1;
+    }
+    snprintf(s_Config, sizeof(s_Config), "%s/buzzerd.conf", s_Dir);
+    snprintf(s_Socket, sizeof(s_Socket), "%s/socket",       s_Dir);
+    
+    /** Run all benchmarks, the configuration is needed by the commands:            */
+    printf("Mean time per operation in ns:\n");
+    printf("  %-20s %10s %12s\n", "", "ops", "ns/op");
+    BenchCheckCmd  (n);
+    if (BenchReadConfig(n / SPAWN_DIVISOR)) {
+        BenchDispatch(n);
+        BenchClient  (n);
+    }
+    BenchSpawn     (n / SPAWN_DIVISOR);
+    unlink(s_Config);
+    rmdir(s_Dir);
+    return 0;
+}
@@ -18,13 +18,18 @@
 
 /** Global Includes: ****************************************************************/
 
+#include <ctype.h>
 #include <stdio.h>
-#include <sys/socket.h>
-#include <sys/un.h>
-#include <arpa/inet.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <time.h>
 
 #include "ConfigHandler.h"
+#include "JobQueue.h"
+#include "Gestures.h"
+#include "LedSequencer.h"
+#include "Journal.h"
 
 /** Local Defines: ******************************************************************/
 
@@ -33,21 +38,188 @@
 /** Public Functions: ***************************************************************/
 
 CConfigHandler::CConfigHandler() {
-    b_Debug       = false;
-    b_Shutdown    = false;
+    b_Shutdown     = false;
+    ul_Wakeups     = 0;
+    ul_IdleWakeups = 0;
+    ub_LedOverride = 0;
+    s_LedOverride[0] = 0;
+    ul_LedChanges  = 0;
+    i_Retired      = 0;
+    s_FileName[0]  = 0;
+    p_Current.store(0);
 }
 
 CConfigHandler::~CConfigHandler() {
+    /** Nobody reads the configuration any more, so all snapshots can go:           */
+    for (int i=0; i<i_Retired; i++) delete p_Retired[i];
+    delete p_Current.load();
+}
+
+bool CConfigHandler::ReadConfig(const char* sFileName) {
+    /** Variables:                                                                  */
+    SConfig* pConfig;
+    /** Keep the absolute path, since the daemon changes its directory later on:    */
+    if (realpath(sFileName, s_FileName) == 0) return false;
+    /** Only publish the snapshot, if the file is complete:                         */
+    pConfig = new SConfig;
+    if (! Parse(s_FileName, pConfig)) {
+        delete pConfig;
+        return false;
+    }
+    return Publish(pConfig);
+}
+
+bool CConfigHandler::Reload() {
+    /** Variables:                                                                  */
+    SConfig* pConfig;
+    /** A broken file leaves the running configuration untouched:                   */
+    pConfig = new SConfig;
+    if (! Parse(s_FileName, pConfig)) {
+        delete pConfig;
+        return false;
+    }
+    if (! Publish(pConfig)) return false;
+    /** The file sets the LED again, like all other options:                        */
+    if (ub_LedOverride != 0) {
+        ub_LedOverride = 0;
+        ul_LedChanges++;
+    }
+    return true;
+}
+
+bool CConfigHandler::Busy() {
+    /** No further snapshot may be published, until an old one is past its grace:   */
+    Collect();
+    return (i_Retired >= CONFIG_RETIRED);
+}
 
+void CConfigHandler::HandleCommand(char* Command, char* sReply, int iSize){
+    /** Variables:                                                                  */
+    SConfig*      pConfig;
+    SLedPattern   Pattern;
+    unsigned char ubLedMode, ubCurrent;
+    const char*   sCurrent;
+    /** Parse the command, which is already terminated:                             */
+    if ((Command[0] == '-') && (Command[1] == 'q')){
+        /** It is an exit-command:                                                  */
+        b_Shutdown = true;
+        snprintf(sReply, iSize, "Received quit.");
+    }else if ((Command[0] == '-') && (Command[1] == 'x')){
+        /** It is a command to replace the executable:                              */
+        if (strlen(Command) < 4) {
+            snprintf(sReply, iSize, "Missing executable!");
+            return;
+        }
+        if (strlen(&Command[3]) >= sizeof(pConfig->Buttons[0].s_Executable)) {
+            snprintf(sReply, iSize, "ERR: Executable too long!");
+            return;
+        }
+        if (strcmp(Get()->Buttons[0].s_Executable, &Command[3]) == 0) {
+            snprintf(sReply, iSize, "Updated executable.");
+            return;
+        }
+        if (Busy()) {
+            snprintf(sReply, iSize, "ERR: Too many changes within a second, try again!");
+            return;
+        }
+        /** The running snapshot is never written, so publish a modified copy:      */
+        pConfig = new SConfig(*Get());
+        strcpy(pConfig->Buttons[0].s_Executable, (&Command[3]));
+        Publish(pConfig);
+        snprintf(sReply, iSize, "Updated executable.");
+    }else if ((Command[0] == '-') && (Command[1] == 'l')){
+        /** It is an LED command, so parse it:                                      */
+        ubLedMode = 0;
+        if (strlen(Command) < 5) {
+            snprintf(sReply, iSize, "Missing LED parameter!");
+        }else if (strcmp ((&Command[3]), (char*) "on")==0) {
+            ubLedMode = LED_MODE_ON;
+            snprintf(sReply, iSize, "Set LED Mode on!");
+        }else if (strcmp((&Command[3]), (char*) "off")==0) {
+            ubLedMode = LED_MODE_OFF;
+            snprintf(sReply, iSize, "Set LED Mode off!");
+        }else if (strcmp((&Command[3]), (char*) "success")==0) {
+            ubLedMode = LED_MODE_SUCCESS;
+            snprintf(sReply, iSize, "Set LED Mode success!");
+        }else if (strcmp((&Command[3]), (char*) "alive")==0) {
+            ubLedMode = LED_MODE_ALIVE;
+            snprintf(sReply, iSize, "Set LED Mode alive!");
+        }else if ((strlen(&Command[3]) < sizeof(s_LedOverride)) && (CLedSequencer::Parse(&Command[3], &Pattern))) {
+            ubLedMode = LED_MODE_PATTERN;
+            snprintf(sReply, iSize, "Set LED Pattern %s!", &Command[3]);
+        }else{
+            snprintf(sReply, iSize, "ERR: Unable to parse LED parameter!");
+        }
+        /** The LED is set on top of the snapshot, which is not copied for it:      */
+        ubCurrent = (ub_LedOverride != 0) ? ub_LedOverride : Get()->ub_LedMode;
+        sCurrent  = (ub_LedOverride != 0) ? s_LedOverride  : Get()->s_LedPattern;
+        if ((ubLedMode != 0) && ((ubLedMode != ubCurrent) ||
+                                 ((ubLedMode == LED_MODE_PATTERN) && (strcmp(&Command[3], sCurrent) != 0)))) {
+            ub_LedOverride = ubLedMode;
+            strcpy(s_LedOverride, (ubLedMode == LED_MODE_PATTERN) ? &Command[3] : "");
+            ul_LedChanges++;
+        }
+    }else if ((Command[0] == '-') && (Command[1] == 'w')){
+        /** It is a request for the wake-up counters of the event-loop:             */
+        snprintf(sReply, iSize, "%lu wake-ups, %lu of them idle.", ul_Wakeups, ul_IdleWakeups);
+    }else if (strcmp(Command, "reload") == 0){
+        /** It is a request to read the configuration-file again:                   */
+        if (Busy()) {
+            snprintf(sReply, iSize, "ERR: Too many changes within a second, try again!");
+        }else if (Reload()) {
+            snprintf(sReply, iSize, "Reloaded %s.", s_FileName);
+        }else{
+            snprintf(sReply, iSize, "ERR: Unable to read %s, keeping the configuration!", s_FileName);
+        }
+    }else{
+        /** It was no valid command at all:                                         */
+        snprintf(sReply, iSize, "ERR: Unable to parse command!");
+    }
 }
 
-bool CConfigHandler::ReadConfig(char* sFileName) {
+/** Private Functions: **************************************************************/
+
+bool CConfigHandler::Parse(const char* sFileName, SConfig* pConfig) {
     /** Variables:                                                                  */
     FILE *fp;
-    char sBuffer[1024], sResult[1024];
+    char sBuffer[1024], sResult[1024], sExecutable[1024];
+    SLedPattern Pattern;
+    unsigned int uiBtnPin = 18;
+    int  iLedPin = 26;
+    unsigned int uiPin;
+    int  i, iPos, iLen, iButtonLed, iGesture, iTimeout;
+    SButton Button;
+    bool bButtons = true;
     bool bExeSet = false;
     bool bLogSet = false;
     bool bLedSet = false;
+    bool bPatterns = true;
+    bool bNetwork = true;
+    /** Start from the defaults, a reload does not inherit runtime changes:         */
+    memset(pConfig, 0, sizeof(SConfig));
+    pConfig->b_Debug       = false;
+    pConfig->ub_ExecMode   = EXEC_MODE_DIRECT;
+    pConfig->i_Workers     = 1;
+    pConfig->i_MaxParallel = 1;
+    pConfig->i_QueueSize   = 256;
+    pConfig->ub_Overflow   = OVERFLOW_BLOCK;
+    pConfig->i_BatchSize   = 1;
+    pConfig->i_KillGrace   = 2000;
+    pConfig->i_MetricsInterval = 10;
+    pConfig->i_SampleRate  = 1000;
+    pConfig->i_RealtimeCpu = -1;
+    pConfig->i_Debounce    = 5;
+    pConfig->i_LongPress   = 800;
+    pConfig->i_DoublePress = 300;
+    pConfig->i_HoldRepeat  = 200;
+    pConfig->i_LedBrightness = 100;
+    pConfig->i_JournalSize   = 4096;
+    pConfig->ub_JournalSync  = JOURNAL_SYNC_BATCH;
+    strcpy(pConfig->s_LedFailure, "off");
+    strcpy(pConfig->s_LedTimeout, "fast");
+    pConfig->ub_InputMode  = INPUT_MODE_EVENT;
+    strcpy(pConfig->s_GpioChip,  "/dev/gpiochip0");
+    strcpy(pConfig->s_SimInput,  "/tmp/BuzzerD.sim");
     /** Try to open the configuration-file:                                         */
     fp = fopen(sFileName,"r");
     if (fp == 0) return false;
@@ -59,85 +231,368 @@ bool CConfigHandler::ReadConfig(char* sFileName) {
         if ((sBuffer[0] == ';') || (sBuffer[0] == '#')) continue;
         /** Check for the executable:                                               */
         if (CheckCmd(sBuffer, (char*) "Executable", sResult)) {
-            strcpy((char*)s_Executable, sResult);
+            strcpy(sExecutable, sResult);
             bExeSet = true;
         }
         /** Check for the client-log:                                               */
         if (CheckCmd(sBuffer, (char*) "ClientOutput", sResult)) {
-            strcpy((char*)s_ClientLog, sResult);
+            strcpy(pConfig->s_ClientLog, sResult);
             bLogSet = true;
         }
         /** Check for the LED command:                                              */
         if (CheckCmd(sBuffer, (char*) "LED", sResult)) {
             if (strcmp(sResult, (char*) "on")==0) {
-                ub_LedMode = LED_MODE_ON;
+                pConfig->ub_LedMode = LED_MODE_ON;
                 bLedSet    = true;
             }else if (strcmp(sResult, (char*) "off")==0) {
-                ub_LedMode = LED_MODE_OFF;
+                pConfig->ub_LedMode = LED_MODE_OFF;
                 bLedSet    = true;
             }else if (strcmp(sResult, (char*) "success")==0) {
-                ub_LedMode = LED_MODE_SUCCESS;
+                pConfig->ub_LedMode = LED_MODE_SUCCESS;
                 bLedSet    = true;
             }else if (strcmp(sResult, (char*) "alive")==0) {
-                ub_LedMode = LED_MODE_ALIVE;
+                pConfig->ub_LedMode = LED_MODE_ALIVE;
                 bLedSet    = true;
+            }else if ((strlen(sResult) < sizeof(pConfig->s_LedPattern)) && (CLedSequencer::Parse(sResult, &Pattern))) {
+                pConfig->ub_LedMode = LED_MODE_PATTERN;
+                strcpy(pConfig->s_LedPattern, sResult);
+                bLedSet    = true;
+            }
+        }
+        /** Check for the patterns of the LEDs while running and after a failure:   */
+        if (CheckCmd(sBuffer, (char*) "LedBusy", sResult)) {
+            if ((strlen(sResult) < sizeof(pConfig->s_LedBusy)) && (CLedSequencer::Parse(sResult, &Pattern))) {
+                strcpy(pConfig->s_LedBusy, sResult);
+            }else{
+                bPatterns = false;
+            }
+        }
+        if (CheckCmd(sBuffer, (char*) "LedFailure", sResult)) {
+            if ((strlen(sResult) < sizeof(pConfig->s_LedFailure)) &&
+                ((strcmp(sResult, "code") == 0) || (CLedSequencer::Parse(sResult, &Pattern)))) {
+                strcpy(pConfig->s_LedFailure, sResult);
+            }else{
+                bPatterns = false;
+            }
+        }
+        if (CheckCmd(sBuffer, (char*) "LedTimeout", sResult)) {
+            if ((strlen(sResult) < sizeof(pConfig->s_LedTimeout)) && (CLedSequencer::Parse(sResult, &Pattern))) {
+                strcpy(pConfig->s_LedTimeout, sResult);
+            }else{
+                bPatterns = false;
+            }
+        }
+        if (CheckCmd(sBuffer, (char*) "LedBrightness", sResult)) {
+            pConfig->i_LedBrightness = atoi(sResult);
+            if (pConfig->i_LedBrightness < 1)   pConfig->i_LedBrightness = 1;
+            if (pConfig->i_LedBrightness > 100) pConfig->i_LedBrightness = 100;
+        }
+        /** Check, how the executable is to be run:                                 */
+        if (CheckCmd(sBuffer, (char*) "ExecMode", sResult)) {
+            if (strcmp(sResult, (char*) "direct")==0) {
+                pConfig->ub_ExecMode = EXEC_MODE_DIRECT;
+            }else if (strcmp(sResult, (char*) "shell")==0) {
+                pConfig->ub_ExecMode = EXEC_MODE_SHELL;
+            }else if (strcmp(sResult, (char*) "persistent")==0) {
+                pConfig->ub_ExecMode = EXEC_MODE_PERSISTENT;
+            }
+        }
+        /** Check for the number of persistent workers:                             */
+        if (CheckCmd(sBuffer, (char*) "Workers", sResult)) {
+            pConfig->i_Workers = atoi(sResult);
+        }
+        /** Check for the limits of the job-queue:                                  */
+        if (CheckCmd(sBuffer, (char*) "MaxParallel", sResult)) {
+            pConfig->i_MaxParallel = atoi(sResult);
+        }
+        if (CheckCmd(sBuffer, (char*) "QueueSize", sResult)) {
+            pConfig->i_QueueSize = atoi(sResult);
+        }
+        if (CheckCmd(sBuffer, (char*) "Overflow", sResult)) {
+            if (strcmp(sResult, (char*) "block")==0) {
+                pConfig->ub_Overflow = OVERFLOW_BLOCK;
+            }else if (strcmp(sResult, (char*) "drop-oldest")==0) {
+                pConfig->ub_Overflow = OVERFLOW_DROP_OLDEST;
+            }else if (strcmp(sResult, (char*) "drop-newest")==0) {
+                pConfig->ub_Overflow = OVERFLOW_DROP_NEWEST;
+            }else if (strcmp(sResult, (char*) "coalesce")==0) {
+                pConfig->ub_Overflow = OVERFLOW_COALESCE;
+            }
+        }
+        /** Check for the batches, which run the waiting presses at once:           */
+        if (CheckCmd(sBuffer, (char*) "BatchSize", sResult)) {
+            pConfig->i_BatchSize = atoi(sResult);
+            if (pConfig->i_BatchSize < 1) pConfig->i_BatchSize = 1;
+            if (pConfig->i_BatchSize > JOB_MAX_BATCH) pConfig->i_BatchSize = JOB_MAX_BATCH;
+        }
+        if (CheckCmd(sBuffer, (char*) "BatchWindow", sResult)) {
+            pConfig->i_BatchWindow = atoi(sResult);
+            if (pConfig->i_BatchWindow < 0) pConfig->i_BatchWindow = 0;
+        }
+        /** Check for the input-mode of the buzzer:                                 */
+        if (CheckCmd(sBuffer, (char*) "Input", sResult)) {
+            if (strcmp(sResult, (char*) "event")==0) {
+                pConfig->ub_InputMode = INPUT_MODE_EVENT;
+            }else if (strcmp(sResult, (char*) "poll")==0) {
+                pConfig->ub_InputMode = INPUT_MODE_POLL;
+            }else if (strcmp(sResult, (char*) "sim")==0) {
+                pConfig->ub_InputMode = INPUT_MODE_SIM;
+            }
+        }
+        /** Check for the pins of the button and LED of the executable (BCM):       */
+        if (CheckCmd(sBuffer, (char*) "ButtonPin", sResult)) {
+            uiBtnPin = atoi(sResult);
+        }else if (CheckCmd(sBuffer, (char*) "LedPin", sResult)) {
+            iLedPin  = atoi(sResult);
+        }else if ((CheckCmd(sBuffer, (char*) "Button", sResult)) && ((sBuffer[6] == ' ') || (sBuffer[6] == '\t'))) {
+            /** "Button <pin> [led <pin>] [<gesture>] [timeout <ms>] <exe>":        */
+            iButtonLed = -1;
+            iGesture   = GESTURE_PRESS;
+            iTimeout   = -1;
+            if (sscanf(sResult, "%u %n", &uiPin, &iPos) < 1) {
+                bButtons = false;
+                continue;
+            }
+            if (strncmp(&sResult[iPos], "led ", 4) == 0) {
+                if (sscanf(&sResult[iPos + 4], "%i %n", &iButtonLed, &iLen) < 1) {
+                    bButtons = false;
+                    continue;
+                }
+                iPos += 4 + iLen;
+            }
+            for (i=0; i<GESTURE_COUNT; i++) {
+                iLen = strlen(CGestures::Name(i));
+                if ((strncmp(&sResult[iPos], CGestures::Name(i), iLen) == 0) && (sResult[iPos + iLen] == ' ')) {
+                    iGesture = i;
+                    iPos    += iLen + 1;
+                    break;
+                }
             }
+            if (strncmp(&sResult[iPos], "timeout ", 8) == 0) {
+                if ((sscanf(&sResult[iPos + 8], "%i %n", &iTimeout, &iLen) < 1) || (iTimeout < 0)) {
+                    bButtons = false;
+                    continue;
+                }
+                iPos += 8 + iLen;
+            }
+            if (! AddButton(pConfig, uiPin, iButtonLed, iGesture, iTimeout, &sResult[iPos])) bButtons = false;
+        }
+        /** Check for the FIFO and record-file of the simulated GPIO:               */
+        if (CheckCmd(sBuffer, (char*) "SimInput", sResult)) {
+            strcpy(pConfig->s_SimInput, sResult);
+        }
+        if (CheckCmd(sBuffer, (char*) "SimRecord", sResult)) {
+            strcpy(pConfig->s_SimRecord, sResult);
+        }
+        /** Check for the trace of the GPIO of any input:                           */
+        if (CheckCmd(sBuffer, (char*) "TraceRecord", sResult)) {
+            strcpy(pConfig->s_TraceRecord, sResult);
+        }
+        /** Check for the GPIO character-device:                                    */
+        if (CheckCmd(sBuffer, (char*) "GpioChip", sResult)) {
+            strcpy(pConfig->s_GpioChip, sResult);
+        }
+        /** Check for the journal of the presses, its size and sync-policy:         */
+        if (CheckCmd(sBuffer, (char*) "JournalSize", sResult)) {
+            pConfig->i_JournalSize = atoi(sResult);
+        }else if (CheckCmd(sBuffer, (char*) "JournalSync", sResult)) {
+            if (strcmp(sResult, (char*) "none")==0) {
+                pConfig->ub_JournalSync = JOURNAL_SYNC_NONE;
+            }else if (strcmp(sResult, (char*) "batch")==0) {
+                pConfig->ub_JournalSync = JOURNAL_SYNC_BATCH;
+            }else if (strcmp(sResult, (char*) "always")==0) {
+                pConfig->ub_JournalSync = JOURNAL_SYNC_ALWAYS;
+            }
+        }else if (CheckCmd(sBuffer, (char*) "Journal", sResult)) {
+            strcpy(pConfig->s_Journal, sResult);
+        }
+        /** Check for the exposition-file of the metrics and its update-interval:   */
+        if (CheckCmd(sBuffer, (char*) "MetricsFile", sResult)) {
+            strcpy(pConfig->s_MetricsFile, sResult);
+        }
+        if (CheckCmd(sBuffer, (char*) "MetricsInterval", sResult)) {
+            pConfig->i_MetricsInterval = atoi(sResult);
+            if (pConfig->i_MetricsInterval < 1) pConfig->i_MetricsInterval = 1;
+        }
+        /** Check for the sampling-rate and the times of the gestures:              */
+        if (CheckCmd(sBuffer, (char*) "SampleRate", sResult)) {
+            pConfig->i_SampleRate = atoi(sResult);
+            if (pConfig->i_SampleRate < 10)   pConfig->i_SampleRate = 10;
+            if (pConfig->i_SampleRate > 5000) pConfig->i_SampleRate = 5000;
+        }
+        /** Check for the real-time input-thread and its CPU:                       */
+        if (CheckCmd(sBuffer, (char*) "RealtimePriority", sResult)) {
+            pConfig->i_RealtimePriority = atoi(sResult);
+            if (pConfig->i_RealtimePriority < 0)  pConfig->i_RealtimePriority = 0;
+            if (pConfig->i_RealtimePriority > 99) pConfig->i_RealtimePriority = 99;
+        }
+        if (CheckCmd(sBuffer, (char*) "RealtimeCpu", sResult)) {
+            pConfig->i_RealtimeCpu = atoi(sResult);
+            if (pConfig->i_RealtimeCpu < -1) pConfig->i_RealtimeCpu = -1;
+        }
+        if (CheckCmd(sBuffer, (char*) "Debounce", sResult)) {
+            pConfig->i_Debounce = atoi(sResult);
+            if (pConfig->i_Debounce < 0) pConfig->i_Debounce = 0;
+        }
+        if (CheckCmd(sBuffer, (char*) "LongPress", sResult)) {
+            pConfig->i_LongPress = atoi(sResult);
+            if (pConfig->i_LongPress < 1) pConfig->i_LongPress = 1;
+        }
+        if (CheckCmd(sBuffer, (char*) "DoublePress", sResult)) {
+            pConfig->i_DoublePress = atoi(sResult);
+            if (pConfig->i_DoublePress < 1) pConfig->i_DoublePress = 1;
+        }
+        if (CheckCmd(sBuffer, (char*) "HoldRepeat", sResult)) {
+            pConfig->i_HoldRepeat = atoi(sResult);
+            if (pConfig->i_HoldRepeat < 1) pConfig->i_HoldRepeat = 1;
+        }
+        /** Check for the timeout of the runs and the limits of their resources:    */
+        if (CheckCmd(sBuffer, (char*) "Timeout", sResult)) {
+            pConfig->i_Timeout = atoi(sResult);
+            if (pConfig->i_Timeout < 0) pConfig->i_Timeout = 0;
+        }
+        if (CheckCmd(sBuffer, (char*) "KillGrace", sResult)) {
+            pConfig->i_KillGrace = atoi(sResult);
+            if (pConfig->i_KillGrace < 1) pConfig->i_KillGrace = 1;
+        }
+        if (CheckCmd(sBuffer, (char*) "LimitCpu", sResult)) {
+            pConfig->i_LimitCpu = atoi(sResult);
+            if (pConfig->i_LimitCpu < 0) pConfig->i_LimitCpu = 0;
+        }
+        if (CheckCmd(sBuffer, (char*) "LimitMemory", sResult)) {
+            pConfig->i_LimitMemory = atoi(sResult);
+            if (pConfig->i_LimitMemory < 0) pConfig->i_LimitMemory = 0;
+        }
+        if ((CheckCmd(sBuffer, (char*) "Cgroup", sResult)) && (strlen(sResult) < sizeof(pConfig->s_Cgroup))) {
+            strcpy(pConfig->s_Cgroup, sResult);
+        }
+        if ((CheckCmd(sBuffer, (char*) "CpuMax", sResult)) && (strlen(sResult) < sizeof(pConfig->s_CpuMax))) {
+            strcpy(pConfig->s_CpuMax, sResult);
+        }
+        if ((CheckCmd(sBuffer, (char*) "MemoryMax", sResult)) && (strlen(sResult) < sizeof(pConfig->s_MemoryMax))) {
+            strcpy(pConfig->s_MemoryMax, sResult);
+        }
+        /** Check for the network, its peers and the key of the packets:            */
+        if ((CheckCmd(sBuffer, (char*) "NetListen", sResult)) && (strlen(sResult) < sizeof(pConfig->s_NetListen))) {
+            strcpy(pConfig->s_NetListen, sResult);
+        }
+        if ((CheckCmd(sBuffer, (char*) "NetGroup", sResult)) && (strlen(sResult) < sizeof(pConfig->s_NetGroup))) {
+            strcpy(pConfig->s_NetGroup, sResult);
+        }
+        if (CheckCmd(sBuffer, (char*) "NetNode", sResult)) {
+            pConfig->ui_NetNode = strtoul(sResult, 0, 10);
+        }
+        if (CheckCmd(sBuffer, (char*) "NetPeer", sResult)) {
+            iLen = strlen(sResult);
+            if ((pConfig->i_Peers >= CONFIG_MAX_PEERS) || (iLen >= (int) sizeof(pConfig->Peers[0].s_Address))) {
+                bNetwork = false;
+            }else{
+                pConfig->Peers[pConfig->i_Peers].b_Tcp = ((iLen > 4) && (strcmp(&sResult[iLen-4], " tcp") == 0));
+                if (pConfig->Peers[pConfig->i_Peers].b_Tcp) sResult[iLen-4] = 0;
+                strcpy(pConfig->Peers[pConfig->i_Peers].s_Address, sResult);
+                pConfig->i_Peers++;
+            }
+        }
+        if (CheckCmd(sBuffer, (char*) "NetKey", sResult)) {
+            /** The key is given as 32 hex-digits:                                  */
+            pConfig->b_NetKey = (strlen(sResult) == 2 * sizeof(pConfig->ub_NetKey));
+            for (i=0; (pConfig->b_NetKey) && (i<(int) sizeof(pConfig->ub_NetKey)); i++) {
+                pConfig->b_NetKey = (sscanf(&sResult[2*i], "%2hhx", &pConfig->ub_NetKey[i]) == 1) &&
+                                    (isxdigit(sResult[2*i]) && isxdigit(sResult[2*i+1]));
+            }
+            if (! pConfig->b_NetKey) bNetwork = false;
         }
         /** Check for a debug-command:                                              */
         if (CheckCmd(sBuffer, "debug", sResult)) {
-            b_Debug = true;
+            pConfig->b_Debug = true;
         }
     }
     fclose(fp);
-    return (bExeSet && bLogSet && bLedSet);
+    /** The executable of the old single-button setup becomes the first button:     */
+    if ((bExeSet) && (! AddButton(pConfig, uiBtnPin, iLedPin, GESTURE_PRESS, -1, sExecutable))) bButtons = false;
+    if ((bExeSet) && (pConfig->i_Buttons > 1)) {
+        Button = pConfig->Buttons[pConfig->i_Buttons - 1];
+        memmove(&pConfig->Buttons[1], &pConfig->Buttons[0], (pConfig->i_Buttons - 1) * sizeof(SButton));
+        pConfig->Buttons[0] = Button;
+    }
+    /** Buttons without their own timeout take the one of all runs:                 */
+    for (i=0; i<pConfig->i_Buttons; i++) {
+        if (pConfig->Buttons[i].i_Timeout < 0) pConfig->Buttons[i].i_Timeout = pConfig->i_Timeout;
+    }
+    return (bButtons && (pConfig->i_Buttons > 0) && bLogSet && bLedSet && bPatterns && bNetwork);
 }
 
-void CConfigHandler::HandleClient(int sockfd){
+bool CConfigHandler::AddButton(SConfig* pConfig, unsigned int uiPin, int iLedPin, int iGesture, int iTimeout,
+                               const char* sExecutable) {
     /** Variables:                                                                  */
-    char    Command[BUFFSIZE];
-    ssize_t RxLen;
-    
-    /** Try to fetch the command:                                                   */    
-    RxLen = recv (sockfd, Command, sizeof(Command)-1, 0);
-    /** If something was received, try to parse it:                                 */
-    if( RxLen > 0) {
-        if ((Command[0] == '-') && (Command[1] == 'q')){
-            /** It is an exit-command:                                              */
-            b_Shutdown = true;
-            SendToSocket(sockfd, "Received quit.");
-        }else if ((Command[0] == '-') && (Command[1] == 'x')){
-            /** It is a command to replace the executable:                          */
-            Command[RxLen] = 0;
-            strcpy((char*)s_Executable, (&Command[3]));
-            SendToSocket(sockfd, "Updated executable.");
-        }else if ((Command[0] == '-') && (Command[1] == 'l')){
-            /** It is an LED command, so parse it:                                  */
-            Command[RxLen] = 0;
-            if (strlen(Command) < 5) {
-                SendToSocket(sockfd, "Missing LED parameter!");
-            }else if (strcmp ((&Command[3]), (char*) "on")==0) {
-                ub_LedMode = LED_MODE_ON;
-                SendToSocket(sockfd, "Set LED Mode on!");
-            }else if (strcmp((&Command[3]), (char*) "off")==0) {
-                ub_LedMode = LED_MODE_OFF;
-                SendToSocket(sockfd, "Set LED Mode off!");
-            }else if (strcmp((&Command[3]), (char*) "success")==0) {
-                ub_LedMode = LED_MODE_SUCCESS;
-                SendToSocket(sockfd, "Set LED Mode success!");
-            }else if (strcmp((&Command[3]), (char*) "alive")==0) {
-                ub_LedMode = LED_MODE_ALIVE;
-                SendToSocket(sockfd, "Set LED Mode alive!");
-            }else{
-                SendToSocket(sockfd, "ERR: Unable to parse LED parameter!");
-            }
-        }else{
-            /** It was no valid command at all:                                     */
-            SendToSocket(sockfd, "ERR: Unable to parse command!");
-        }
+    int      i;
+    SButton* pButton;
+    /** Only the first 64 GPIOs exist:                                              */
+    if ((pConfig->i_Buttons >= CONFIG_MAX_BUTTONS) || (uiPin >= CONFIG_MAX_PIN)) return false;
+    if ((iLedPin < -1) || (iLedPin >= CONFIG_MAX_PIN) || ((unsigned int) iLedPin == uiPin)) return false;
+    if ((sExecutable[0] == 0) || (strlen(sExecutable) >= sizeof(pConfig->Buttons[0].s_Executable))) return false;
+    /** A pin may have one action per gesture and one LED, which is not a button:   */
+    for (i=0; i<pConfig->i_Buttons; i++) {
+        pButton = &pConfig->Buttons[i];
+        if ((pButton->ui_Pin == uiPin) && (pButton->ub_Gesture == iGesture)) return false;
+        if ((unsigned int) pButton->i_LedPin == uiPin) return false;
+        if (iLedPin < 0) continue;
+        if ((unsigned int) iLedPin == pButton->ui_Pin) return false;
+        if ((pButton->ui_Pin == uiPin) && (pButton->i_LedPin >= 0) && (pButton->i_LedPin != iLedPin)) return false;
+        if ((pButton->ui_Pin != uiPin) && (pButton->i_LedPin == iLedPin)) return false;
     }
+    pButton = &pConfig->Buttons[i];
+    pButton->ui_Pin     = uiPin;
+    pButton->i_LedPin   = iLedPin;
+    pButton->ub_Gesture = iGesture;
+    pButton->i_Timeout  = iTimeout;
+    strcpy(pButton->s_Executable, sExecutable);
+    pConfig->i_Buttons++;
+    return true;
 }
 
-/** Private Functions: **************************************************************/
+bool CConfigHandler::Publish(SConfig* pConfig) {
+    /** Variables:                                                                  */
+    const SConfig*     pOld;
+    struct timespec    Now;
+    /** A snapshot is never freed early, so a full ring refuses the new one:        */
+    if (Busy()) {
+        delete pConfig;
+        return false;
+    }
+    /** Only the event-loop publishes, so the generation is simply counted on:      */
+    pOld = p_Current.load(std::memory_order_relaxed);
+    pConfig->ul_Generation = (pOld == 0) ? 1 : pOld->ul_Generation + 1;
+    /** Swap the snapshot, readers either see the old or the new one completely:    */
+    p_Current.store(pConfig, std::memory_order_release);
+    if (pOld == 0) return true;
+    /** The old one is kept for its grace-period, no reader holds it any longer:    */
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    p_Retired  [i_Retired] = pOld;
+    ull_Retired[i_Retired] = (unsigned long long) Now.tv_sec * 1000000000ULL + Now.tv_nsec;
+    i_Retired++;
+    return true;
+}
+
+void CConfigHandler::Collect() {
+    /** Variables:                                                                  */
+    struct timespec    Now;
+    unsigned long long ullNow;
+    int                i, n;
+    /** Free the snapshots, which were retired for longer than the grace-period:    */
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    ullNow = (unsigned long long) Now.tv_sec * 1000000000ULL + Now.tv_nsec;
+    for (i=0, n=0; i<i_Retired; i++) {
+        if (ullNow - ull_Retired[i] >= CONFIG_GRACE_NS) {
+            delete p_Retired[i];
+            continue;
+        }
+        p_Retired  [n] = p_Retired  [i];
+        ull_Retired[n] = ull_Retired[i];
+        n++;
+    }
+    i_Retired = n;
+}
 
 bool CConfigHandler::CheckCmd(char* sInput, const char* sCommand, char* sResult) {
     int n, i;
@@ -162,6 +617,20 @@ bool CConfigHandler::CheckCmd(char* sInput, const char* sCommand, char* sResult)
     return true;
 }
 
-void CConfigHandler::SendToSocket(int sockfd, const char* Message){
-    send(sockfd, Message, strlen(Message), 0);
+/** Helper Functions: ***************************************************************/
+
+int UniquePins(const SConfig* pConfig, unsigned int* puiPins, int* piLeds) {
+    /** Variables:                                                                  */
+    int i, j, n = 0;
+    /** Several gestures share the pin of their button and its LED:                 */
+    for (i=0; i<pConfig->i_Buttons; i++) {
+        for (j=0; (j<n) && (puiPins[j] != pConfig->Buttons[i].ui_Pin); j++);
+        if (j == n) {
+            puiPins[n] = pConfig->Buttons[i].ui_Pin;
+            piLeds [n] = -1;
+            n++;
+        }
+        if (pConfig->Buttons[i].i_LedPin >= 0) piLeds[j] = pConfig->Buttons[i].i_LedPin;
+    }
+    return n;
 }
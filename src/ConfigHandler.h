@@ -16,12 +16,105 @@
 //  along with this program.  If not, see <https://www.gnu.org/licenses/>.
 //
 
+/** Global Includes: ****************************************************************/
+
+#include <atomic>
+
 /** Type-Definitions: ***************************************************************/
 
 #define LED_MODE_ON      1
 #define LED_MODE_OFF     2
 #define LED_MODE_SUCCESS 3
 #define LED_MODE_ALIVE   4
+#define LED_MODE_PATTERN 5
+
+#define INPUT_MODE_EVENT 1
+#define INPUT_MODE_POLL  2
+#define INPUT_MODE_SIM   3
+
+#define EXEC_MODE_DIRECT 1
+#define EXEC_MODE_SHELL  2
+#define EXEC_MODE_PERSISTENT 3
+
+#define CONFIG_MAX_BUTTONS 32
+#define CONFIG_MAX_PIN     64
+#define CONFIG_MAX_PEERS   16
+
+/** A button with its executable and optionally an LED, which shows its result:     */
+
+struct SButton {
+    unsigned int   ui_Pin;
+    int            i_LedPin;                    // -1 without an LED.
+    unsigned char  ub_Gesture;                  // One of GESTURE_*.
+    int            i_Timeout;                   // In ms, 0 lets a run take any time.
+    char           s_Executable[1024];
+};
+
+/** A daemon, to which the presses and results are sent:                            */
+
+struct SPeer {
+    char           s_Address[256];              // <host>:<port>
+    bool           b_Tcp;                       // Via TCP instead of UDP.
+};
+
+/** An immutable snapshot of the configuration, which is replaced as a whole:       */
+
+struct SConfig {
+    unsigned long  ul_Generation;
+    bool           b_Debug;
+    unsigned char  ub_LedMode;
+    int            i_LedBrightness;             // In %, for LEDs, which can be dimmed.
+    unsigned char  ub_InputMode;
+    unsigned char  ub_ExecMode;
+    int            i_Workers;
+    int            i_MaxParallel;
+    int            i_QueueSize;
+    unsigned char  ub_Overflow;
+    int            i_BatchSize;                 // Presses per run, 1 runs each on its own.
+    int            i_BatchWindow;               // In ms, which a batch waits to fill up.
+    int            i_Timeout;                   // In ms, for buttons without their own.
+    int            i_KillGrace;                 // In ms from SIGTERM until SIGKILL.
+    int            i_LimitCpu;                  // In s of CPU-time per run, 0 for none.
+    int            i_LimitMemory;               // In MB of address-space, 0 for none.
+    int            i_MetricsInterval;
+    int            i_JournalSize;               // In records.
+    unsigned char  ub_JournalSync;
+    int            i_SampleRate;                // Polling-rate in Hz.
+    int            i_RealtimePriority;          // SCHED_FIFO of the input-thread, 0 for none.
+    int            i_RealtimeCpu;               // CPU of the input-thread, -1 for any.
+    int            i_Debounce;                  // Times of the gestures in ms.
+    int            i_LongPress;
+    int            i_DoublePress;
+    int            i_HoldRepeat;
+    int            i_Buttons;
+    SButton        Buttons[CONFIG_MAX_BUTTONS];
+    char           s_ClientLog [1024];
+    char           s_GpioChip  [1024];
+    char           s_SimInput  [1024];
+    char           s_SimRecord [1024];
+    char           s_TraceRecord[1024];         // Binary trace of the GPIO, if not empty.
+    char           s_MetricsFile[1024];
+    char           s_Journal   [1024];
+    char           s_Cgroup    [1024];          // Directory of the cgroup of the runs.
+    char           s_CpuMax    [64];            // Written into its cpu.max, if not empty.
+    char           s_MemoryMax [64];            // Written into its memory.max.
+    char           s_LedPattern[256];           // Pattern of LED_MODE_PATTERN.
+    char           s_LedBusy   [256];           // Pattern while a job runs or empty.
+    char           s_LedFailure[256];           // Pattern after a failure, "code" or "off".
+    char           s_LedTimeout[256];           // Pattern after a timeout or kill.
+    char           s_NetListen [64];            // [<address>:]<port> or empty.
+    char           s_NetGroup  [64];            // Multicast-group or empty.
+    unsigned int   ui_NetNode;                  // Id towards the peers, 0 for a random one.
+    bool           b_NetKey;
+    unsigned char  ub_NetKey   [16];            // Key of the MAC of all packets.
+    int            i_Peers;
+    SPeer          Peers[CONFIG_MAX_PEERS];
+};
+
+/** Local Defines: ******************************************************************/
+
+#define CONFIG_RETIRED   16
+#define CONFIG_GRACE_NS  1000000000ULL
 
 /** Class Definition: ***************************************************************/
 
@@ -29,16 +122,36 @@ class CConfigHandler {
 public:
     // Properties:
     bool           b_Shutdown;
-    bool           b_Debug;
-    unsigned char  ub_LedMode;
-    char           s_Executable[1024];
-    char           s_ClientLog [1024];
+    unsigned long  ul_Wakeups;
+    unsigned long  ul_IdleWakeups;
+    unsigned char  ub_LedOverride;              // LED-mode set via -l, 0 for the configured one.
+    char           s_LedOverride[256];          // Its pattern.
+    unsigned long  ul_LedChanges;               // Counted on, whenever the override changes.
     // Methods:
     CConfigHandler();
     ~CConfigHandler();
-    bool ReadConfig  (char* sFileName);
-    void HandleClient(int sockfd);
+    const SConfig* Get() { return p_Current.load(std::memory_order_acquire); }
+    const char*    FileName() { return s_FileName; }
+    bool ReadConfig  (const char* sFileName);
+    bool Reload      ();
+    bool Busy        ();
+    void HandleCommand(char* sCommand, char* sReply, int iSize);
+    static bool CheckCmd(char* sInput, const char* sCommand, char* sResult);
 private:
-    bool CheckCmd    (char* sInput, const char* sCommand, char* sResult);
-    void SendToSocket(int sockfd, const char* Message);
+    // Properties:
+    std::atomic<const SConfig*> p_Current;
+    const SConfig*     p_Retired  [CONFIG_RETIRED];
+    unsigned long long ull_Retired[CONFIG_RETIRED];
+    int                i_Retired;
+    char               s_FileName[4096];
+    // Methods:
+    bool Parse       (const char* sFileName, SConfig* pConfig);
+    bool AddButton   (SConfig* pConfig, unsigned int uiPin, int iLedPin, int iGesture, int iTimeout,
+                      const char* sExecutable);
+    bool Publish     (SConfig* pConfig);
+    void Collect     ();
 };
+
+/** Forward Declarations: ***********************************************************/
+
+int UniquePins(const SConfig* pConfig, unsigned int* puiPins, int* piLeds);
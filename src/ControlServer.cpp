@@ -0,0 +1,378 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+
+/** Global Includes: ****************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <syslog.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+
+#include "ConfigHandler.h"
+#include "ControlServer.h"
+#include "RunLog.h"
+#include "Metrics.h"
+
+/** Public Functions: ***************************************************************/
+
+CControlServer::CControlServer() {
+    int i;
+    i_ServerFd    = -1;
+    i_EpollFd     = -1;
+    ui_EpollTag   = 0;
+    p_Config      = 0;
+    p_Runs        = 0;
+    p_Metrics     = 0;
+    i_Subscribers = 0;
+    for (i=0; i<CTRL_MAX_SLOTS; i++) Clients[i].i_Fd = -1;
+}
+
+CControlServer::~CControlServer() {
+    Close();
+}
+
+void CControlServer::Init(int iServerFd, int iEpollFd, unsigned int uiTag,
+                          CConfigHandler* pConfig, CRunLog* pRuns, CMetrics* pMetrics) {
+    /** The listening socket is accepted on by the event-loop itself:               */
+    i_ServerFd  = iServerFd;
+    i_EpollFd   = iEpollFd;
+    ui_EpollTag = uiTag;
+    p_Config    = pConfig;
+    p_Runs      = pRuns;
+    p_Metrics   = pMetrics;
+}
+
+void CControlServer::Accept() {
+    /** Variables:                                                                  */
+    int iFd;
+    /** Accept all pending connections:                                             */
+    while ((iFd = accept4(i_ServerFd, 0, 0, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        if (Add(iFd, false) == 0) {
+            send(iFd, "ERR: Too many clients!\n", 23, MSG_NOSIGNAL | MSG_DONTWAIT);
+            close(iFd);
+        }
+    }
+}
+
+bool CControlServer::Adopt(int iFd, unsigned long ulJob) {
+    /** Variables:                                                                  */
+    SConnection *pClient;
+    /** The other end of the connection is inherited by the executable of the job:  */
+    pClient = Add(iFd, true);
+    if (pClient == 0) return false;
+    pClient->ul_Job = ulJob;
+    return true;
+}
+
+void CControlServer::Release(unsigned long ulJob) {
+    /** Variables:                                                                  */
+    int i;
+    /** Handle, what the job sent before it exited, and hang up on its children:    */
+    for (i=0; i<CTRL_MAX_SLOTS; i++) {
+        if ((Clients[i].i_Fd < 0) || (Clients[i].ul_Job != ulJob)) continue;
+        HandleEvent(Clients[i].i_Fd, EPOLLIN);
+        if (Clients[i].i_Fd >= 0) Drop(&Clients[i]);
+    }
+}
+
+void CControlServer::HandleEvent(int iFd, unsigned int uiEvents) {
+    /** Variables:                                                                  */
+    int         i;
+    ssize_t     RxLen;
+    char        sNotice[32];
+    SConnection *pClient = 0;
+    /** Find the connection of this descriptor:                                     */
+    for (i=0; i<CTRL_MAX_SLOTS; i++) {
+        if (Clients[i].i_Fd == iFd) pClient = &Clients[i];
+    }
+    if (pClient == 0) return;
+    /** Send, what is still pending:                                                */
+    if (uiEvents & EPOLLOUT) Flush(pClient);
+    if ((pClient->ul_Dropped > 0) && (pClient->i_TxLen == 0)) {
+        /** A subscriber, which caught up, learns about the records it missed:      */
+        snprintf(sNotice, sizeof(sNotice), "drop %lu\n", pClient->ul_Dropped);
+        Append(pClient, sNotice);
+        pClient->ul_Dropped = 0;
+    }
+    /** Read, what fits into the receive-buffer:                                    */
+    if (uiEvents & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+        while (pClient->i_RxLen < CTRL_RX_SIZE) {
+            RxLen = recv(pClient->i_Fd, &pClient->s_Rx[pClient->i_RxLen], CTRL_RX_SIZE - pClient->i_RxLen, 0);
+            if (RxLen > 0) {
+                pClient->i_RxLen += RxLen;
+                continue;
+            }
+            /** The client has closed its side or is gone:                          */
+            if ((RxLen == 0) || ((errno != EAGAIN) && (errno != EINTR))) pClient->b_Closing = true;
+            if ((RxLen < 0) && (errno == EINTR)) continue;
+            break;
+        }
+    }
+    /** Answer the commands and hang up, once everything was sent:                  */
+    Process(pClient);
+    if ((pClient->b_Closing) && (pClient->i_TxLen == 0)) {
+        Drop(pClient);
+        return;
+    }
+    Update(pClient);
+}
+
+int CControlServer::Subscribers() {
+    return i_Subscribers;
+}
+
+void CControlServer::Publish(const char* sRecord) {
+    /** Variables:                                                                  */
+    int         i;
+    char        sNotice[32];
+    SConnection *pClient;
+    /** Pass the record on to each subscriber, which has room for it:               */
+    for (i=0; (i<CTRL_MAX_SLOTS) && (i_Subscribers>0); i++) {
+        pClient = &Clients[i];
+        if ((pClient->i_Fd < 0) || (! pClient->b_Subscribed) || (pClient->b_Closing)) continue;
+        /** Report the records, which were dropped before, first:                   */
+        if (pClient->ul_Dropped > 0) {
+            snprintf(sNotice, sizeof(sNotice), "drop %lu\n", pClient->ul_Dropped);
+            if ((int) (strlen(sNotice) + strlen(sRecord)) > CTRL_TX_SIZE - pClient->i_TxLen) {
+                pClient->ul_Dropped++;
+                continue;
+            }
+            Append(pClient, sNotice);
+            pClient->ul_Dropped = 0;
+        }
+        if (! Append(pClient, sRecord)) {
+            pClient->ul_Dropped++;
+            continue;
+        }
+        Flush(pClient);
+        Update(pClient);
+    }
+}
+
+void CControlServer::Close() {
+    /** Variables:                                                                  */
+    int i;
+    /** Hang up on all clients:                                                     */
+    for (i=0; i<CTRL_MAX_SLOTS; i++) {
+        if (Clients[i].i_Fd >= 0) Drop(&Clients[i]);
+    }
+}
+
+/** Private Functions: **************************************************************/
+
+SConnection* CControlServer::Add(int iFd, bool bJob) {
+    /** Variables:                                                                  */
+    int i, n;
+    struct epoll_event Event;
+    /** Find a free slot for it among the ones of the clients or of the jobs:       */
+    i = (bJob) ? CTRL_MAX_CLIENTS : 0;
+    n = (bJob) ? CTRL_MAX_SLOTS   : CTRL_MAX_CLIENTS;
+    for (; i<n; i++) {
+        if (Clients[i].i_Fd < 0) break;
+    }
+    if (i >= n) return 0;
+    Clients[i].i_Fd          = iFd;
+    Clients[i].ui_Events     = EPOLLIN;
+    Clients[i].b_Closing     = false;
+    Clients[i].b_Discard     = false;
+    Clients[i].b_Subscribed  = false;
+    Clients[i].ul_Dropped    = 0;
+    Clients[i].ul_Job        = 0;
+    Clients[i].i_RunsPending = 0;
+    Clients[i].i_RxLen       = 0;
+    Clients[i].i_TxLen       = 0;
+    /** Let the event-loop wake up on its commands:                                 */
+    memset(&Event, 0, sizeof(Event));
+    Event.events   = EPOLLIN;
+    Event.data.u64 = ((unsigned long long) ui_EpollTag << 32) | (unsigned int) iFd;
+    epoll_ctl(i_EpollFd, EPOLL_CTL_ADD, iFd, &Event);
+    return &Clients[i];
+}
+
+void CControlServer::Process(SConnection* pClient) {
+    /** Variables:                                                                  */
+    char sLine [CTRL_LINE_SIZE];
+    char sReply[CTRL_LINE_SIZE];
+    char sRun  [RUN_LINE_SIZE];
+    const SRun *pRun;
+    char *pEnd;
+    int  iLen;
+    /** Answer each complete line, as long as there is room for the reply:          */
+    while (CTRL_TX_SIZE - pClient->i_TxLen > CTRL_LINE_SIZE) {
+        /** The runs of a history-request are sent first, one by one:               */
+        if (pClient->i_RunsPending > 0) {
+            if (CTRL_TX_SIZE - pClient->i_TxLen <= RUN_LINE_SIZE) break;
+            pRun = p_Runs->Get(pClient->ul_RunsNext);
+            if (pRun != 0) {
+                p_Runs->Format(pRun, sRun, sizeof(sRun) - 1);
+            }else{
+                snprintf(sRun, sizeof(sRun), "run %lu overwritten", pClient->ul_RunsNext);
+            }
+            Append(pClient, sRun);
+            Append(pClient, "\n");
+            pClient->ul_RunsNext++;
+            pClient->i_RunsPending--;
+            continue;
+        }
+        pEnd = (char*) memchr(pClient->s_Rx, '\n', pClient->i_RxLen);
+        if ((pEnd == 0) && (pClient->i_RxLen == CTRL_RX_SIZE)) {
+            /** A line, which does not fit into the buffer, is refused entirely:    */
+            if (! pClient->b_Discard) Append(pClient, "ERR: Command too long!\n");
+            pClient->b_Discard = true;
+            pClient->i_RxLen   = 0;
+            continue;
+        }
+        if (pEnd == 0) {
+            /** A line without end is only taken, if no more can follow:            */
+            if ((! pClient->b_Closing) || (pClient->i_RxLen == 0)) break;
+            pEnd = &pClient->s_Rx[pClient->i_RxLen];
+        }
+        iLen = pEnd - pClient->s_Rx;
+        memcpy(sLine, pClient->s_Rx, iLen);
+        sLine[iLen] = 0;
+        if ((iLen > 0) && (sLine[iLen-1] == '\r')) sLine[iLen-1] = 0;
+        /** Remove the line including its end from the receive-buffer:              */
+        if (iLen < pClient->i_RxLen) iLen++;
+        pClient->i_RxLen -= iLen;
+        memmove(pClient->s_Rx, &pClient->s_Rx[iLen], pClient->i_RxLen);
+        /** The rest of a refused line is skipped:                                  */
+        if (pClient->b_Discard) {
+            pClient->b_Discard = false;
+            continue;
+        }
+        /** Let the configuration-handler answer it:                                */
+        if (sLine[0] == 0) continue;
+        if (pClient->ul_Job != 0) {
+            Report(pClient, sLine);
+            continue;
+        }
+        if (strcmp(sLine, "subscribe") == 0) {
+            /** The events are only sent to those clients, which asked for them:    */
+            if (! pClient->b_Subscribed) i_Subscribers++;
+            pClient->b_Subscribed = true;
+            Append(pClient, "Subscribed.\n");
+            continue;
+        }
+        if ((sLine[0] == '-') && (sLine[1] == 'r') && ((sLine[2] == 0) || (sLine[2] == ' '))) {
+            History(pClient, &sLine[2]);
+            continue;
+        }
+        if ((strcmp(sLine, "-s") == 0) || (strcmp(sLine, "stats") == 0)) {
+            p_Metrics->Summary(sReply, sizeof(sReply));
+        }else{
+            p_Config->HandleCommand(sLine, sReply, sizeof(sReply));
+        }
+        Append(pClient, sReply);
+        Append(pClient, "\n");
+    }
+    Flush(pClient);
+}
+
+void CControlServer::Report(SConnection* pClient, char* sLine) {
+    /** Variables:                                                                  */
+    char sReply[CTRL_LINE_SIZE + 32];
+    /** A job reports on its own run, the replies are dropped:                      */
+    if (strncmp(sLine, "progress ", 9) == 0) {
+        if (i_Subscribers == 0) return;
+        snprintf(sReply, sizeof(sReply), "progress %lu %s\n", pClient->ul_Job, &sLine[9]);
+        Publish(sReply);
+    }else if (strncmp(sLine, "result ", 7) == 0) {
+        p_Runs->SetResult(pClient->ul_Job, atoi(&sLine[7]));
+    }else{
+        p_Config->HandleCommand(sLine, sReply, sizeof(sReply));
+    }
+}
+
+void CControlServer::History(SConnection* pClient, const char* sCount) {
+    /** Variables:                                                                  */
+    char          sReply[32];
+    int           iCount;
+    unsigned long ulCompleted;
+    /** Take the requested number of the last runs, ten by default:                 */
+    iCount = (sCount[0] != 0) ? atoi(sCount) : 10;
+    ulCompleted = p_Runs->Completed();
+    if (iCount < 0) iCount = 0;
+    if (iCount > RUN_HISTORY) iCount = RUN_HISTORY;
+    if ((unsigned long) iCount > ulCompleted) iCount = ulCompleted;
+    pClient->i_RunsPending = iCount;
+    pClient->ul_RunsNext   = ulCompleted - iCount;
+    snprintf(sReply, sizeof(sReply), "%i runs\n", iCount);
+    Append(pClient, sReply);
+}
+
+bool CControlServer::Append(SConnection* pClient, const char* sText) {
+    /** Variables:                                                                  */
+    int iLen;
+    /** Queue the text, if it fits completely:                                      */
+    iLen = strlen(sText);
+    if (iLen > CTRL_TX_SIZE - pClient->i_TxLen) return false;
+    memcpy(&pClient->s_Tx[pClient->i_TxLen], sText, iLen);
+    pClient->i_TxLen += iLen;
+    return true;
+}
+
+void CControlServer::Flush(SConnection* pClient) {
+    /** Variables:                                                                  */
+    ssize_t TxLen;
+    /** Send as much as the socket takes without waiting:                           */
+    while (pClient->i_TxLen > 0) {
+        TxLen = send(pClient->i_Fd, pClient->s_Tx, pClient->i_TxLen, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (TxLen < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN) {
+                /** The client is gone, so nothing more is sent to it:              */
+                pClient->b_Closing = true;
+                pClient->i_TxLen   = 0;
+            }
+            return;
+        }
+        pClient->i_TxLen -= TxLen;
+        memmove(pClient->s_Tx, &pClient->s_Tx[TxLen], pClient->i_TxLen);
+    }
+}
+
+void CControlServer::Update(SConnection* pClient) {
+    /** Variables:                                                                  */
+    struct epoll_event Event;
+    unsigned int       uiEvents = 0;
+    /** Only read, while there is room, and only wait for writing, if it is needed: */
+    if ((! pClient->b_Closing) && (pClient->i_RxLen < CTRL_RX_SIZE)) uiEvents |= EPOLLIN;
+    if (pClient->i_TxLen > 0) uiEvents |= EPOLLOUT;
+    if (uiEvents == pClient->ui_Events) return;
+    memset(&Event, 0, sizeof(Event));
+    Event.events   = uiEvents;
+    Event.data.u64 = ((unsigned long long) ui_EpollTag << 32) | (unsigned int) pClient->i_Fd;
+    epoll_ctl(i_EpollFd, EPOLL_CTL_MOD, pClient->i_Fd, &Event);
+    pClient->ui_Events = uiEvents;
+}
+
+void CControlServer::Drop(SConnection* pClient) {
+    /** Close the connection and free its slot:                                     */
+    epoll_ctl(i_EpollFd, EPOLL_CTL_DEL, pClient->i_Fd, 0);
+    close(pClient->i_Fd);
+    if (pClient->b_Subscribed) i_Subscribers--;
+    pClient->b_Subscribed = false;
+    pClient->i_Fd      = -1;
+    pClient->ui_Events = 0;
+}
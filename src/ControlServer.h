@@ -0,0 +1,113 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+
+/** Notes: *************************************************************************** 
+
+The control-server keeps the connections of the clients open. Each command is a line
+terminated by '\n' and is answered by exactly one line, so a client may send many
+commands at once and reads the replies in the same order. All sockets are non-
+blocking: a client, which does not read its replies, is not served any further until
+it does, but it never delays the handling of the presses.
+
+After the command "subscribe", the connection additionally receives one record per
+event of the daemon (see the README). Records, which do not fit into the send-buffer
+of a slow subscriber, are dropped and reported as "drop <count>", as soon as there is
+room again.
+
+Each job may get a connection of its own, which its executable inherits (see Adopt()).
+Its commands are not answered, so a job never has to read from it, and it may send
+"progress <text>", which is published as "progress <job-id> <text>", and "result
+<code>", which replaces the exit-code of the job. The connection is released, when the
+job finishes, after the commands it sent were handled. The connections of the jobs
+have slots of their own, so neither the clients nor the jobs can take all of them.
+
+The command "-r [<count>]" is answered by a line "<count> runs", followed by one line
+per run of the history (see CRunLog::Format()), the oldest first. The commands "-s" and
+"stats" are answered with all metrics in one line (see CMetrics::Summary()).
+
+*************************************************************************************/
+
+/** Local Defines: ******************************************************************/
+
+#define CTRL_MAX_CLIENTS 64
+#define CTRL_MAX_JOBS    64                     // Control-channels of running jobs.
+#define CTRL_MAX_SLOTS   (CTRL_MAX_CLIENTS + CTRL_MAX_JOBS)
+#define CTRL_RX_SIZE     1024
+#define CTRL_TX_SIZE     4096
+#define CTRL_LINE_SIZE   1024
+
+/** Type-Definitions: ***************************************************************/
+
+struct SConnection {
+    int                i_Fd;
+    unsigned int       ui_Events;
+    bool               b_Closing;
+    bool               b_Discard;
+    bool               b_Subscribed;
+    unsigned long      ul_Dropped;
+    unsigned long      ul_Job;                  // Job, whose executable holds it, or 0.
+    int                i_RunsPending;
+    unsigned long      ul_RunsNext;
+    char               s_Rx[CTRL_RX_SIZE];
+    int                i_RxLen;
+    char               s_Tx[CTRL_TX_SIZE];
+    int                i_TxLen;
+};
+
+/** Class Definition: ***************************************************************/
+
+class CConfigHandler;
+class CRunLog;
+class CMetrics;
+
+class CControlServer {
+public:
+    // Methods:
+    CControlServer();
+    ~CControlServer();
+    void Init       (int iServerFd, int iEpollFd, unsigned int uiTag,
+                     CConfigHandler* pConfig, CRunLog* pRuns, CMetrics* pMetrics);
+    void Accept     ();
+    bool Adopt      (int iFd, unsigned long ulJob);
+    void Release    (unsigned long ulJob);
+    void HandleEvent(int iFd, unsigned int uiEvents);
+    int  Subscribers();
+    void Publish    (const char* sRecord);
+    void Close      ();
+private:
+    // Properties:
+    int                i_ServerFd;
+    int                i_EpollFd;
+    unsigned int       ui_EpollTag;
+    CConfigHandler*    p_Config;
+    CRunLog*           p_Runs;
+    CMetrics*          p_Metrics;
+    int                i_Subscribers;
+    SConnection        Clients[CTRL_MAX_SLOTS]; // The clients first, then the jobs.
+    // Methods:
+    SConnection* Add(int iFd, bool bJob);
+    void Process    (SConnection* pClient);
+    void Report     (SConnection* pClient, char* sLine);
+    void History    (SConnection* pClient, const char* sCount);
+    bool Append     (SConnection* pClient, const char* sText);
+    void Flush      (SConnection* pClient);
+    void Update     (SConnection* pClient);
+    void Drop       (SConnection* pClient);
+};
@@ -0,0 +1,273 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/** Global Includes: ****************************************************************/
+
+#include <string.h>
+
+#include "PressRing.h"
+#include "Gestures.h"
+
+/** Local Defines: ******************************************************************/
+
+#define GS_IDLE          0                      // Released.
+#define GS_DOWN          1                      // Pressed, the gesture is still open.
+#define GS_WAIT          2                      // Released, waiting for a second press.
+#define GS_DONE          3                      // Pressed, the gesture was emitted.
+#define GS_HELD          4                      // Held, repeating.
+
+/** Public Functions: ***************************************************************/
+
+CGestures::CGestures() {
+    p_Ring       = 0;
+    ull_Debounce = 0;
+    ull_Period   = 0;
+    ull_Long     = 0;
+    ull_Double   = 0;
+    ull_Repeat   = 0;
+    i_Samples    = 1;
+    memset(ull_Pins, 0, sizeof(ull_Pins));
+    ul_Bounces.store(0);
+    Reset();
+}
+
+CGestures::~CGestures() {
+
+}
+
+void CGestures::Configure(CPressRing* pRing, unsigned long long* pullPins, unsigned long long ullDebounce,
+                          unsigned long long ullPeriod, unsigned long long ullLong, unsigned long long ullDouble,
+                          unsigned long long ullRepeat) {
+    /** Variables:                                                                  */
+    int i;
+    /** Note, which pins have which gestures, the open gestures are kept:           */
+    p_Ring = pRing;
+    for (i=0; i<GESTURE_COUNT; i++) ull_Pins[i] = pullPins[i];
+    ull_Debounce = ullDebounce;
+    ull_Period   = ullPeriod;
+    ull_Long     = ullLong;
+    ull_Double   = ullDouble;
+    ull_Repeat   = ullRepeat;
+    /** The shift-register covers the debounce-time with samples:                   */
+    i_Samples = (ullPeriod > 0) ? (int) ((ullDebounce + ullPeriod - 1) / ullPeriod) : 1;
+    if (i_Samples < 1)               i_Samples = 1;
+    if (i_Samples > GESTURE_SAMPLES) i_Samples = GESTURE_SAMPLES;
+}
+
+void CGestures::Reset() {
+    /** Forget all pins, e.g. after the GPIO was reopened, the bounces are kept:    */
+    memset(ull_History, 0, sizeof(ull_History));
+    memset(Pins,        0, sizeof(Pins));
+    ull_Raw    = 0;
+    ull_Stable = 0;
+    ull_Timed  = 0;
+}
+
+void CGestures::Sample(unsigned long long ullPressed, unsigned long long ullTimestamp) {
+    /** Variables:                                                                  */
+    unsigned long long ullAll, ullAny, ullStable, ullChanged;
+    unsigned int       uiPin;
+    int                i, iBounces;
+    /** Shift the sample in and find the pins, whose last samples all agree:        */
+    ullAll = ullAny = ullPressed;
+    for (i=i_Samples-1; i>0; i--) {
+        ull_History[i] = ull_History[i-1];
+        ullAll        &= ull_History[i];
+        ullAny        |= ull_History[i];
+    }
+    ull_History[0] = ullPressed;
+    ullStable      = (ull_Stable | ullAll) & ullAny;
+    /** Only a changed line needs any further work:                                 */
+    if ((ullPressed == ull_Raw) && (ullStable == ull_Stable)) return;
+    iBounces = __builtin_popcountll(ullPressed & ~ull_Raw) - __builtin_popcountll(ullStable & ~ull_Stable);
+    if (iBounces != 0) ul_Bounces.fetch_add(iBounces, std::memory_order_relaxed);
+    ull_Raw     = ullPressed;
+    ullChanged  = ullStable ^ ull_Stable;
+    ull_Stable  = ullStable;
+    /** The change happened with the first of the agreeing samples:                 */
+    ullTimestamp -= (i_Samples - 1) * ull_Period;
+    while (ullChanged != 0) {
+        uiPin       = __builtin_ctzll(ullChanged);
+        ullChanged &= ullChanged - 1;
+        if (ullStable & (1ULL << uiPin)) Down(uiPin, ullTimestamp);
+        else                             Up  (uiPin, ullTimestamp);
+    }
+}
+
+void CGestures::Edge(unsigned int uiPin, bool bFalling, unsigned long long ullTimestamp) {
+    /** Variables:                                                                  */
+    unsigned long long ullBit;
+    SGesturePin*       pPin;
+    if (uiPin >= GESTURE_PINS) return;
+    ullBit = 1ULL << uiPin;
+    pPin   = &Pins[uiPin];
+    if (bFalling) {
+        /** A release, which lasted, may not have been expired yet:                 */
+        if ((pPin->ull_Rise != 0) && (ullTimestamp >= pPin->ull_Rise + ull_Debounce)) Expire(ullTimestamp);
+        /** A release, which did not last, and a second falling edge are bounces:   */
+        if ((pPin->ull_Rise != 0) || (ull_Stable & ullBit)) {
+            pPin->ull_Rise = 0;
+            ul_Bounces.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        /** Otherwise the press is accepted right away:                             */
+        ull_Stable |= ullBit;
+        Down(uiPin, ullTimestamp);
+    }else{
+        /** The release is only accepted, if the line stays high:                   */
+        if ((ull_Stable & ullBit) == 0) return;
+        pPin->ull_Rise = ullTimestamp;
+        ull_Timed     |= ullBit;
+    }
+}
+
+void CGestures::Expire(unsigned long long ullNow) {
+    /** Variables:                                                                  */
+    unsigned long long ullTimed, ullBit, ullRise;
+    unsigned int       uiPin;
+    SGesturePin*       pPin;
+    /** Check all pins with a pending release or deadline:                          */
+    ullTimed = ull_Timed;
+    while (ullTimed != 0) {
+        uiPin     = __builtin_ctzll(ullTimed);
+        ullTimed &= ullTimed - 1;
+        ullBit    = 1ULL << uiPin;
+        pPin      = &Pins[uiPin];
+        /** The line stayed high long enough, so it was released with its edge:     */
+        if ((pPin->ull_Rise != 0) && (ullNow >= pPin->ull_Rise + ull_Debounce)) {
+            ullRise        = pPin->ull_Rise;
+            pPin->ull_Rise = 0;
+            ull_Stable    &= ~ullBit;
+            Up(uiPin, ullRise);
+        }
+        if ((pPin->ull_Deadline != 0) && (ullNow >= pPin->ull_Deadline)) {
+            switch (pPin->ub_State) {
+            case GS_DOWN:
+                /** Held long enough, the long-press wins over the repetition:      */
+                Emit(uiPin, (ull_Pins[GESTURE_LONG] & ullBit) ? GESTURE_LONG : GESTURE_REPEAT, pPin->ull_Deadline);
+                if (ull_Pins[GESTURE_REPEAT] & ullBit) {
+                    pPin->ub_State      = GS_HELD;
+                    pPin->ull_Deadline += ull_Repeat;
+                }else{
+                    pPin->ub_State      = GS_DONE;
+                    pPin->ull_Deadline  = 0;
+                }
+                break;
+            case GS_HELD:
+                /** Repeat, but never catch up with a burst after a delay:          */
+                Emit(uiPin, GESTURE_REPEAT, ullNow);
+                pPin->ull_Deadline += ull_Repeat;
+                if (pPin->ull_Deadline <= ullNow) pPin->ull_Deadline = ullNow + ull_Repeat;
+                break;
+            case GS_WAIT:
+                /** No second press followed, so it was a short one:                */
+                Emit(uiPin, GESTURE_PRESS, pPin->ull_Down);
+                pPin->ub_State     = GS_IDLE;
+                pPin->ull_Deadline = 0;
+                break;
+            default:
+                pPin->ull_Deadline = 0;
+                break;
+            }
+        }
+        if ((pPin->ull_Rise == 0) && (pPin->ull_Deadline == 0)) ull_Timed &= ~ullBit;
+    }
+}
+
+unsigned long long CGestures::NextDeadline() {
+    /** Variables:                                                                  */
+    unsigned long long ullTimed, ullNext = 0, ullDue;
+    SGesturePin*       pPin;
+    /** Find the earliest release or deadline of all pins:                          */
+    ullTimed = ull_Timed;
+    while (ullTimed != 0) {
+        pPin      = &Pins[__builtin_ctzll(ullTimed)];
+        ullTimed &= ullTimed - 1;
+        if (pPin->ull_Rise != 0) {
+            ullDue = pPin->ull_Rise + ull_Debounce;
+            if ((ullNext == 0) || (ullDue < ullNext)) ullNext = ullDue;
+        }
+        if ((pPin->ull_Deadline != 0) && ((ullNext == 0) || (pPin->ull_Deadline < ullNext))) {
+            ullNext = pPin->ull_Deadline;
+        }
+    }
+    return ullNext;
+}
+
+const char* CGestures::Name(unsigned char ubGesture) {
+    /** Variables:                                                                  */
+    static const char* sNames[GESTURE_COUNT] = { "press", "long", "double", "repeat" };
+    return (ubGesture < GESTURE_COUNT) ? sNames[ubGesture] : "unknown";
+}
+
+/** Private Functions: **************************************************************/
+
+void CGestures::Down(unsigned int uiPin, unsigned long long ullTimestamp) {
+    /** Variables:                                                                  */
+    unsigned long long ullBit;
+    SGesturePin*       pPin;
+    ullBit = 1ULL << uiPin;
+    pPin   = &Pins[uiPin];
+    /** A press within the double-press time completes a double-press:              */
+    if (pPin->ub_State == GS_WAIT) {
+        Emit(uiPin, GESTURE_DOUBLE, ullTimestamp);
+        pPin->ub_State     = GS_DONE;
+        pPin->ull_Deadline = 0;
+        return;
+    }
+    /** A pin with nothing but short presses needs not wait for anything:           */
+    if (((ull_Pins[GESTURE_LONG] | ull_Pins[GESTURE_DOUBLE] | ull_Pins[GESTURE_REPEAT]) & ullBit) == 0) {
+        Emit(uiPin, GESTURE_PRESS, ullTimestamp);
+        pPin->ub_State = GS_DONE;
+        return;
+    }
+    /** Otherwise wait, whether it becomes a long-press:                            */
+    pPin->ub_State     = GS_DOWN;
+    pPin->ull_Down     = ullTimestamp;
+    pPin->ull_Deadline = 0;
+    if ((ull_Pins[GESTURE_LONG] | ull_Pins[GESTURE_REPEAT]) & ullBit) {
+        pPin->ull_Deadline = ullTimestamp + ull_Long;
+        ull_Timed         |= ullBit;
+    }
+}
+
+void CGestures::Up(unsigned int uiPin, unsigned long long ullTimestamp) {
+    /** Variables:                                                                  */
+    unsigned long long ullBit;
+    SGesturePin*       pPin;
+    ullBit = 1ULL << uiPin;
+    pPin   = &Pins[uiPin];
+    /** A short press may still become a double-press:                              */
+    if (pPin->ub_State == GS_DOWN) {
+        if (ull_Pins[GESTURE_DOUBLE] & ullBit) {
+            pPin->ub_State     = GS_WAIT;
+            pPin->ull_Deadline = ullTimestamp + ull_Double;
+            ull_Timed         |= ullBit;
+            return;
+        }
+        Emit(uiPin, GESTURE_PRESS, pPin->ull_Down);
+    }
+    pPin->ub_State     = GS_IDLE;
+    pPin->ull_Deadline = 0;
+}
+
+void CGestures::Emit(unsigned int uiPin, unsigned char ubGesture, unsigned long long ullTimestamp) {
+    /** Pass the gesture on to the main-loop:                                       */
+    if (p_Ring != 0) p_Ring->Push(ullTimestamp, uiPin, ubGesture);
+}
@@ -0,0 +1,103 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/** Notes: *************************************************************************** 
+
+Debounce and gesture-engine of the buttons. It is fed either with the sampled levels
+of all pins (polling) or with the edges of single pins (edge-events) and pushes the
+recognized gestures into the press-ring:
+
+  press   a short press, on the press itself, if the pin has no other gestures
+  long    the button has been held for the long-press time
+  double  a second press followed within the double-press time
+  repeat  repeated every hold-repeat time, while the button stays held
+
+The samples pass a shift-register filter, which is bit-sliced over all 64 pins: a
+pin changes its state, once its last n samples agree. Thus each sample costs a few
+logical operations, however many pins there are. Edges are accepted on the press
+right away, the release only after the line stayed high for the debounce-time. All
+timestamps are CLOCK_MONOTONIC in ns, all timeouts are handled by Expire() at the
+time returned by NextDeadline().
+
+*************************************************************************************/
+
+/** Global Includes: ****************************************************************/
+
+#include <atomic>
+
+/** Local Defines: ******************************************************************/
+
+#define GESTURE_PRESS    0
+#define GESTURE_LONG     1
+#define GESTURE_DOUBLE   2
+#define GESTURE_REPEAT   3
+#define GESTURE_COUNT    4
+
+#define GESTURE_PINS     64
+#define GESTURE_SAMPLES  16                     // Longest shift-register.
+
+/** Type-Definitions: ***************************************************************/
+
+struct SGesturePin {
+    unsigned char      ub_State;
+    unsigned long long ull_Down;                // First press of the gesture.
+    unsigned long long ull_Deadline;            // Next timeout of the gesture or 0.
+    unsigned long long ull_Rise;                // Pending release (edges only) or 0.
+};
+
+/** Class Definition: ***************************************************************/
+
+class CPressRing;
+
+class CGestures {
+public:
+    // Properties:
+    std::atomic<unsigned long> ul_Bounces;      // Also read, while the input-thread runs.
+    // Methods:
+    CGestures();
+    ~CGestures();
+    void Configure (CPressRing* pRing, unsigned long long* pullPins, unsigned long long ullDebounce,
+                    unsigned long long ullPeriod, unsigned long long ullLong, unsigned long long ullDouble,
+                    unsigned long long ullRepeat);
+    void Reset     ();
+    void Sample    (unsigned long long ullPressed, unsigned long long ullTimestamp);
+    void Edge      (unsigned int uiPin, bool bFalling, unsigned long long ullTimestamp);
+    void Expire    (unsigned long long ullNow);
+    unsigned long long NextDeadline();
+    static const char* Name(unsigned char ubGesture);
+private:
+    // Properties:
+    CPressRing*        p_Ring;
+    unsigned long long ull_Pins[GESTURE_COUNT];  // Pins, which have an action per gesture.
+    unsigned long long ull_Debounce;
+    unsigned long long ull_Period;
+    unsigned long long ull_Long;
+    unsigned long long ull_Double;
+    unsigned long long ull_Repeat;
+    int                i_Samples;
+    unsigned long long ull_History[GESTURE_SAMPLES];
+    unsigned long long ull_Raw;
+    unsigned long long ull_Stable;
+    unsigned long long ull_Timed;               // Pins with a deadline or pending release.
+    SGesturePin        Pins[GESTURE_PINS];
+    // Methods:
+    void Down      (unsigned int uiPin, unsigned long long ullTimestamp);
+    void Up        (unsigned int uiPin, unsigned long long ullTimestamp);
+    void Emit      (unsigned int uiPin, unsigned char ubGesture, unsigned long long ullTimestamp);
+};
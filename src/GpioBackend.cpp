@@ -0,0 +1,89 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/** Global Includes: ****************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <syslog.h>
+
+#include "ConfigHandler.h"
+#include "GpioBackend.h"
+
+/** Forward Declarations: ***********************************************************/
+
+CGpioBackend* OpenGpioBackend(const SConfig* pConfig, const unsigned int* puiButtons, const int* piLeds, int n);
+
+/** Public Functions: ***************************************************************/
+
+CGpioBackend* CreateGpioBackend(const SConfig* pConfig) {
+    /** Variables:                                                                  */
+    CGpioBackend* pGpio;
+    CGpioTrace*   pTrace;
+    unsigned int  uiButtons[CONFIG_MAX_BUTTONS];
+    int           iLeds    [CONFIG_MAX_BUTTONS];
+    int           n;
+    /** All backends get each button-pin and its LED once, in the same order:       */
+    n = UniquePins(pConfig, uiButtons, iLeds);
+    pGpio = OpenGpioBackend(pConfig, uiButtons, iLeds, n);
+    if ((pGpio == 0) || (pConfig->s_TraceRecord[0] == 0)) return pGpio;
+    /** Record its input and the LEDs, the trace owns the backend from now on:      */
+    pTrace = new CGpioTrace(pConfig->s_TraceRecord, pGpio);
+    if (pTrace->Init(uiButtons, iLeds, n)) {
+        syslog(LOG_NOTICE | LOG_DAEMON, "Recording the GPIO to %s.", pConfig->s_TraceRecord);
+        return pTrace;
+    }
+    syslog(LOG_ERR | LOG_DAEMON, "FAILURE OPENING THE TRACE %s!", pConfig->s_TraceRecord);
+    delete pTrace;
+    return 0;
+}
+
+/** Helper Functions: ***************************************************************/
+
+CGpioBackend* OpenGpioBackend(const SConfig* pConfig, const unsigned int* puiButtons, const int* piLeds, int n) {
+    /** Variables:                                                                  */
+    CGpioBackend* pGpio;
+    /** The simulation never falls back to the hardware:                            */
+    if (pConfig->ub_InputMode == INPUT_MODE_SIM) {
+        pGpio = new CGpioSim(pConfig->s_SimInput, pConfig->s_SimRecord);
+        if (pGpio->Init(puiButtons, piLeds, n)) {
+            syslog(LOG_NOTICE | LOG_DAEMON, "Using simulated GPIO on %s.", pConfig->s_SimInput);
+            return pGpio;
+        }
+        delete pGpio;
+        return 0;
+    }
+    /** Prefer the edge-events of the GPIO character-device over polling:           */
+    if (pConfig->ub_InputMode == INPUT_MODE_EVENT) {
+        pGpio = new CGpioChip(pConfig->s_GpioChip);
+        if (pGpio->Init(puiButtons, piLeds, n)) {
+            syslog(LOG_NOTICE | LOG_DAEMON, "Using edge-events of %s.", pConfig->s_GpioChip);
+            return pGpio;
+        }
+        delete pGpio;
+        syslog(LOG_WARNING | LOG_DAEMON, "FAILURE REQUESTING EDGE-EVENTS, FALLING BACK TO POLLING!");
+    }
+#ifndef NO_BCM2835
+    /** Use the bcm2835 library for polling:                                        */
+    pGpio = new CGpioBcm();
+    if (pGpio->Init(puiButtons, piLeds, n)) return pGpio;
+    delete pGpio;
+#endif
+    return 0;
+}
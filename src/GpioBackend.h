@@ -0,0 +1,191 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/** Type-Definitions: ***************************************************************/
+
+#define GPIO_MARK_FORK   'F'
+#define GPIO_MARK_EXIT   'X'
+#define GPIO_MAX_LINES   64
+
+#define TRACE_START      'B'                    // Header of a recording, e.g. after a reload.
+#define TRACE_SAMPLE     'S'
+#define TRACE_EDGE       'E'
+#define TRACE_LED        'L'
+#define TRACE_MARK       'M'
+#define TRACE_EDGES      1                      // Flag of a recording of edge-events.
+
+struct STraceRecord {
+    unsigned char      ub_Type;                 // One of TRACE_*.
+    unsigned long long ull_Timestamp;           // CLOCK_MONOTONIC in ns, kept monotonic.
+    unsigned long long ull_Level;               // Buttons of a sample, realtime of a start.
+    unsigned long long ull_Before;              // Buttons of the samples before.
+    unsigned long      ul_Run;                  // Number of samples before with these.
+    unsigned int       ui_Index;                // Pin of an edge or button of an LED.
+    int                i_Value;                 // Falling edge, LED-level, mark or flags.
+    char               c_Mark;
+};
+
+/** Class Definition: ***************************************************************/
+
+// All timestamps of ReadEvent() are CLOCK_MONOTONIC in ns. This holds for the
+// edge-events of the GPIO character-device since Linux 5.7. ReadButtons() returns
+// the pressed buttons as bitmask of their pins, WriteLed() takes the index of the
+// button, whose LED is to be set. DimLed() sets its brightness in %, if CanDim().
+
+struct SConfig;
+
+class CGpioBackend {
+public:
+    // Methods:
+    virtual ~CGpioBackend() {};
+    virtual bool Init      (const unsigned int* puiButtons, const int* piLeds, int nButtons) = 0;
+    virtual void Close     () = 0;
+    virtual unsigned long long ReadButtons() = 0;
+    virtual void WriteLed  (int iButton, bool bOn) = 0;
+    virtual bool CanDim    (int iButton) { return false; };
+    virtual void DimLed    (int iButton, int iLevel) {};
+    virtual int  GetFd     () { return -1; };
+    virtual bool ReadEvent (unsigned long long* pTimestamp, bool* pFalling, unsigned int* puiPin) { return false; };
+    virtual void Mark      (char cEvent, int iValue) {};
+};
+
+/** Edge-events of the button and LED via the GPIO character-device:                */
+
+class CGpioChip : public CGpioBackend {
+public:
+    // Methods:
+    CGpioChip(const char* sDevice);
+    ~CGpioChip();
+    bool Init      (const unsigned int* puiButtons, const int* piLeds, int nButtons);
+    void Close     ();
+    unsigned long long ReadButtons();
+    void WriteLed  (int iButton, bool bOn);
+    int  GetFd     ();
+    bool ReadEvent (unsigned long long* pTimestamp, bool* pFalling, unsigned int* puiPin);
+private:
+    // Properties:
+    char         s_Device[1024];
+    int          i_ChipFd;
+    int          i_EventFd;
+    int          i_LedFd;
+    int          i_Buttons;
+    unsigned int ui_Pins   [GPIO_MAX_LINES];
+    int          i_LedLines[GPIO_MAX_LINES];    // Line of each LED in its request.
+};
+
+/** Polling of the button and LED via the bcm2835 library:                          */
+
+class CGpioBcm : public CGpioBackend {
+public:
+    // Methods:
+    CGpioBcm();
+    ~CGpioBcm();
+    bool Init      (const unsigned int* puiButtons, const int* piLeds, int nButtons);
+    void Close     ();
+    unsigned long long ReadButtons();
+    void WriteLed  (int iButton, bool bOn);
+    bool CanDim    (int iButton);
+    void DimLed    (int iButton, int iLevel);
+private:
+    // Properties:
+    bool               b_Open;
+    unsigned long long ull_Mask;
+    int                i_LedPins[GPIO_MAX_LINES];
+    int                i_Pwm    [GPIO_MAX_LINES]; // PWM-channel of the LED or -1.
+};
+
+/** Simulated button fed through a FIFO, LED-writes recorded to a file:             */
+
+class CGpioSim : public CGpioBackend {
+public:
+    // Methods:
+    CGpioSim(const char* sFifo, const char* sRecord);
+    ~CGpioSim();
+    bool Init      (const unsigned int* puiButtons, const int* piLeds, int nButtons);
+    void Close     ();
+    unsigned long long ReadButtons();
+    void WriteLed  (int iButton, bool bOn);
+    bool CanDim    (int iButton);
+    void DimLed    (int iButton, int iLevel);
+    int  GetFd     ();
+    bool ReadEvent (unsigned long long* pTimestamp, bool* pFalling, unsigned int* puiPin);
+    void Mark      (char cEvent, int iValue);
+private:
+    // Properties:
+    char          s_Fifo  [1024];
+    char          s_Record[1024];
+    int           i_FifoFd;
+    int           i_RecordFd;
+    unsigned int  ui_FirstPin;
+    int           i_LedPins[GPIO_MAX_LINES];
+    volatile unsigned long long ull_Pressed;
+    char          s_Buffer[512];
+    int           i_BufLen;
+    // Methods:
+    void Record    (char cEvent, int iValue, int iPin);
+};
+
+/** Trace of the samples, edges and LED-writes of another backend or its replay:    */
+
+class CGpioTrace : public CGpioBackend {
+public:
+    // Properties:
+    unsigned long long ull_Clock;               // Virtual time of a replay.
+    // Methods:
+    CGpioTrace(const char* sFile, CGpioBackend* pGpio);
+    ~CGpioTrace();
+    bool Init      (const unsigned int* puiButtons, const int* piLeds, int nButtons);
+    void Close     ();
+    unsigned long long ReadButtons();
+    void WriteLed  (int iButton, bool bOn);
+    bool CanDim    (int iButton);
+    void DimLed    (int iButton, int iLevel);
+    int  GetFd     ();
+    bool ReadEvent (unsigned long long* pTimestamp, bool* pFalling, unsigned int* puiPin);
+    void Mark      (char cEvent, int iValue);
+    bool Next      (STraceRecord* pRecord);
+    void Report    (const char* sFormat, ...);
+private:
+    // Properties:
+    char               s_File[1024];
+    CGpioBackend*      p_Gpio;                  // Recorded backend, 0 for a replay.
+    int                i_Fd;
+    bool               b_Replay;
+    int                i_Leds;
+    unsigned long long ull_Dim;                 // LEDs, which the backend can dim.
+    unsigned long long ull_Level;               // Buttons of the last sample.
+    unsigned long      ul_Run;                  // Samples since the last change.
+    unsigned long long ull_Input;               // Time of the last sample or edge.
+    unsigned long long ull_Output;              // Time of the last LED-write or mark.
+    unsigned long long ull_Base;                // Start of the first recording.
+    unsigned long long ull_Offset;              // Shift of later recordings of a replay.
+    unsigned char      ub_Buffer[4096];         // Read-ahead of a replay.
+    int                i_BufPos;
+    int                i_BufLen;
+    // Methods:
+    void Start     ();
+    void Sample    (unsigned long long ullLevel, unsigned long long ullTimestamp);
+    void Write     (const unsigned char* pData, int iLength);
+    bool Byte      (unsigned char* pubValue);
+    bool Varint    (unsigned long long* pullValue);
+};
+
+/** Forward Declarations: ***********************************************************/
+
+CGpioBackend* CreateGpioBackend(const SConfig* pConfig);
@@ -0,0 +1,116 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/** Global Includes: ****************************************************************/
+
+#include <bcm2835.h>
+
+#include "GpioBackend.h"
+
+/** Local Defines: ******************************************************************/
+
+#define BCM_PWM_RANGE    1024                   // About 1.2 kHz at 1.2 MHz.
+
+/** Public Functions: ***************************************************************/
+
+CGpioBcm::CGpioBcm() {
+    b_Open   = false;
+    ull_Mask = 0;
+    for (int i=0; i<GPIO_MAX_LINES; i++) i_LedPins[i] = i_Pwm[i] = -1;
+}
+
+CGpioBcm::~CGpioBcm() {
+    Close();
+}
+
+bool CGpioBcm::Init(const unsigned int* puiButtons, const int* piLeds, int nButtons) {
+    /** Variables:                                                                  */
+    int  i, iChannel;
+    bool bUsed[2] = { false, false };
+    /** Setup BCM hardware-library:                                                 */
+    if ((nButtons < 1) || (nButtons > GPIO_MAX_LINES)) return false;
+    if (!bcm2835_init()) return false;
+    b_Open   = true;
+    ull_Mask = 0;
+    bcm2835_gpio_set_pad(BCM2835_PAD_GROUP_GPIO_0_27,BCM2835_PAD_DRIVE_16mA);
+    for (i=0; i<nButtons; i++) {
+        /** Prepare the LED pin, the first one on each PWM-channel can be dimmed:   */
+        i_LedPins[i] = piLeds[i];
+        i_Pwm    [i] = -1;
+        iChannel = ((piLeds[i] == 12) || (piLeds[i] == 18)) ? 0 : ((piLeds[i] == 13) || (piLeds[i] == 19)) ? 1 : -1;
+        if ((iChannel >= 0) && (! bUsed[iChannel])) {
+            if (! bUsed[0] && ! bUsed[1]) bcm2835_pwm_set_clock(BCM2835_PWM_CLOCK_DIVIDER_16);
+            bUsed[iChannel] = true;
+            i_Pwm[i]        = iChannel;
+            bcm2835_gpio_fsel(piLeds[i], (piLeds[i] < 14) ? BCM2835_GPIO_FSEL_ALT0 : BCM2835_GPIO_FSEL_ALT5);
+            bcm2835_pwm_set_mode (iChannel, 1, 1);
+            bcm2835_pwm_set_range(iChannel, BCM_PWM_RANGE);
+            bcm2835_pwm_set_data (iChannel, 0);
+        }else if (piLeds[i] >= 0) {
+            bcm2835_gpio_fsel(piLeds[i], BCM2835_GPIO_FSEL_OUTP);
+        }
+        /** Prepare the button pin:                                                 */
+        bcm2835_gpio_fsel(puiButtons[i], BCM2835_GPIO_FSEL_INPT);
+        bcm2835_gpio_set_pud(puiButtons[i], BCM2835_GPIO_PUD_UP);
+        ull_Mask |= 1ULL << puiButtons[i];
+    }
+    for (; i<GPIO_MAX_LINES; i++) i_LedPins[i] = i_Pwm[i] = -1;
+    return true;
+}
+
+void CGpioBcm::Close() {
+    if (! b_Open) return;
+    /** Hand the PWM-pins back as outputs:                                          */
+    for (int i=0; i<GPIO_MAX_LINES; i++) {
+        if (i_Pwm[i] < 0) continue;
+        bcm2835_pwm_set_mode(i_Pwm[i], 1, 0);
+        bcm2835_gpio_fsel(i_LedPins[i], BCM2835_GPIO_FSEL_OUTP);
+        bcm2835_gpio_write(i_LedPins[i], LOW);
+        i_Pwm[i] = -1;
+    }
+    bcm2835_close();
+    b_Open = false;
+}
+
+unsigned long long CGpioBcm::ReadButtons() {
+    /** Variables:                                                                  */
+    unsigned long long ullLevels;
+    /** One read of the level-register covers a bank, the buttons are active low:   */
+    ullLevels = bcm2835_peri_read(bcm2835_gpio + BCM2835_GPLEV0 / 4);
+    if ((ull_Mask >> 32) != 0) {
+        ullLevels |= (unsigned long long) bcm2835_peri_read(bcm2835_gpio + BCM2835_GPLEV1 / 4) << 32;
+    }
+    return (~ullLevels) & ull_Mask;
+}
+
+void CGpioBcm::WriteLed(int iButton, bool bOn) {
+    if ((iButton < 0) || (iButton >= GPIO_MAX_LINES) || (i_LedPins[iButton] < 0)) return;
+    if (i_Pwm[iButton] >= 0) bcm2835_pwm_set_data(i_Pwm[iButton], bOn ? BCM_PWM_RANGE : 0);
+    else                     bcm2835_gpio_write(i_LedPins[iButton], bOn ? HIGH : LOW);
+}
+
+bool CGpioBcm::CanDim(int iButton) {
+    return ((iButton >= 0) && (iButton < GPIO_MAX_LINES) && (i_Pwm[iButton] >= 0));
+}
+
+void CGpioBcm::DimLed(int iButton, int iLevel) {
+    /** The eye sees the brightness roughly squared, so the duty-cycle follows it:  */
+    if (! CanDim(iButton)) return;
+    bcm2835_pwm_set_data(i_Pwm[iButton], iLevel * iLevel * BCM_PWM_RANGE / 10000);
+}
@@ -0,0 +1,147 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/** Global Includes: ****************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+
+#include "GpioBackend.h"
+
+/** Public Functions: ***************************************************************/
+
+CGpioChip::CGpioChip(const char* sDevice) {
+    strncpy(s_Device, sDevice, sizeof(s_Device) - 1);
+    s_Device[sizeof(s_Device) - 1] = 0;
+    i_ChipFd  = -1;
+    i_EventFd = -1;
+    i_LedFd   = -1;
+    i_Buttons = 0;
+}
+
+CGpioChip::~CGpioChip() {
+    Close();
+}
+
+bool CGpioChip::Init(const unsigned int* puiButtons, const int* piLeds, int nButtons) {
+    /** Variables:                                                                  */
+    struct gpio_v2_line_request Request;
+    int    i, nLeds;
+    /** Open the GPIO character device:                                             */
+    Close();
+    if ((nButtons < 1) || (nButtons > GPIO_MAX_LINES)) return false;
+    i_ChipFd = open(s_Device, O_RDONLY | O_CLOEXEC);
+    if (i_ChipFd < 0) return false;
+    /** Request both edges of all buttons in one go, with the pull-ups enabled:     */
+    memset(&Request, 0, sizeof(Request));
+    for (i=0; i<nButtons; i++) {
+        Request.offsets[i] = puiButtons[i];
+        ui_Pins[i]         = puiButtons[i];
+    }
+    Request.num_lines    = nButtons;
+    Request.config.flags = GPIO_V2_LINE_FLAG_INPUT       | GPIO_V2_LINE_FLAG_BIAS_PULL_UP |
+                           GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING;
+    strncpy(Request.consumer, "buzzerd", sizeof(Request.consumer) - 1);
+    if (ioctl(i_ChipFd, GPIO_V2_GET_LINE_IOCTL, &Request) < 0) {
+        Close();
+        return false;
+    }
+    i_EventFd = Request.fd;
+    i_Buttons = nButtons;
+    /** The main-loop polls the event-handle, so it must never block:               */
+    fcntl(i_EventFd, F_SETFL, fcntl(i_EventFd, F_GETFL) | O_NONBLOCK);
+    fcntl(i_EventFd, F_SETFD, FD_CLOEXEC);
+    /** Request all LEDs as outputs in another request, which are initially off:    */
+    memset(&Request, 0, sizeof(Request));
+    nLeds = 0;
+    for (i=0; i<nButtons; i++) {
+        i_LedLines[i] = -1;
+        if (piLeds[i] < 0) continue;
+        Request.offsets[nLeds] = piLeds[i];
+        i_LedLines[i]          = nLeds++;
+    }
+    if (nLeds == 0) return true;
+    Request.num_lines    = nLeds;
+    Request.config.flags = GPIO_V2_LINE_FLAG_OUTPUT;
+    strncpy(Request.consumer, "buzzerd", sizeof(Request.consumer) - 1);
+    if (ioctl(i_ChipFd, GPIO_V2_GET_LINE_IOCTL, &Request) < 0) {
+        Close();
+        return false;
+    }
+    i_LedFd = Request.fd;
+    fcntl(i_LedFd, F_SETFD, FD_CLOEXEC);
+    return true;
+}
+
+void CGpioChip::Close() {
+    if (i_LedFd   >= 0) close(i_LedFd);
+    if (i_EventFd >= 0) close(i_EventFd);
+    if (i_ChipFd  >= 0) close(i_ChipFd);
+    i_LedFd   = -1;
+    i_EventFd = -1;
+    i_ChipFd  = -1;
+    i_Buttons = 0;
+}
+
+unsigned long long CGpioChip::ReadButtons() {
+    /** Variables:                                                                  */
+    struct gpio_v2_line_values Values;
+    unsigned long long ullPressed = 0;
+    int    i;
+    /** Read the levels of all buttons with one call, they are active low:          */
+    if (i_EventFd < 0) return 0;
+    Values.mask = (i_Buttons < 64) ? ((1ULL << i_Buttons) - 1) : ~0ULL;
+    Values.bits = 0;
+    if (ioctl(i_EventFd, GPIO_V2_LINE_GET_VALUES_IOCTL, &Values) < 0) return 0;
+    for (i=0; i<i_Buttons; i++) {
+        if ((Values.bits & (1ULL << i)) == 0) ullPressed |= 1ULL << ui_Pins[i];
+    }
+    return ullPressed;
+}
+
+void CGpioChip::WriteLed(int iButton, bool bOn) {
+    /** Variables:                                                                  */
+    struct gpio_v2_line_values Values;
+    /** Set the level of the LED-line of this button, if it has one:                */
+    if ((i_LedFd < 0) || (iButton < 0) || (iButton >= i_Buttons) || (i_LedLines[iButton] < 0)) return;
+    Values.mask = 1ULL << i_LedLines[iButton];
+    Values.bits = bOn ? Values.mask : 0;
+    ioctl(i_LedFd, GPIO_V2_LINE_SET_VALUES_IOCTL, &Values);
+}
+
+int CGpioChip::GetFd() {
+    return i_EventFd;
+}
+
+bool CGpioChip::ReadEvent(unsigned long long* pTimestamp, bool* pFalling, unsigned int* puiPin) {
+    /** Variables:                                                                  */
+    struct gpio_v2_line_event Event;
+    /** Fetch the next queued edge of any button, if there is one:                  */
+    if (i_EventFd < 0) return false;
+    if (read(i_EventFd, &Event, sizeof(Event)) != sizeof(Event)) return false;
+    /** Return the kernel-timestamp in nanoseconds, the direction and the pin:      */
+    *pTimestamp = Event.timestamp_ns;
+    *pFalling   = (Event.id == GPIO_V2_LINE_EVENT_FALLING_EDGE);
+    *puiPin     = Event.offset;
+    return true;
+}
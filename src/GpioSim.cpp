@@ -0,0 +1,207 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/** Notes: *************************************************************************** 
+
+The FIFO accepts one edge per line, optionally followed by its timestamp in
+nanoseconds (CLOCK_REALTIME) and the pin of the button, e.g. "press", "release
+1600000000000000000" or "press 0 23". Without a pin, the first button is meant and
+a timestamp of 0 means now. The record-file receives one line per LED-write and
+marker, e.g. "L <ns> 1 <pin>", "D <ns> <%> <pin>" for a dimmed LED, "F <ns> 0" for
+a fork and "X <ns> <code>" for an exited executable.
+
+*************************************************************************************/
+
+/** Global Includes: ****************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "GpioBackend.h"
+
+/** Public Functions: ***************************************************************/
+
+CGpioSim::CGpioSim(const char* sFifo, const char* sRecord) {
+    strncpy(s_Fifo,   sFifo,   sizeof(s_Fifo)   - 1);
+    strncpy(s_Record, sRecord, sizeof(s_Record) - 1);
+    s_Fifo  [sizeof(s_Fifo)   - 1] = 0;
+    s_Record[sizeof(s_Record) - 1] = 0;
+    i_FifoFd   = -1;
+    i_RecordFd = -1;
+    ui_FirstPin = 0;
+    ull_Pressed = 0;
+    i_BufLen   = 0;
+    for (int i=0; i<GPIO_MAX_LINES; i++) i_LedPins[i] = -1;
+}
+
+CGpioSim::~CGpioSim() {
+    Close();
+}
+
+bool CGpioSim::Init(const unsigned int* puiButtons, const int* piLeds, int nButtons) {
+    /** Variables:                                                                  */
+    int i;
+    /** Note the pins, the LEDs are recorded with theirs:                           */
+    Close();
+    if ((nButtons < 1) || (nButtons > GPIO_MAX_LINES)) return false;
+    ui_FirstPin = puiButtons[0];
+    for (i=0; i<GPIO_MAX_LINES; i++) i_LedPins[i] = (i < nButtons) ? piLeds[i] : -1;
+    /** Create the FIFO, unless it is already there:                                */
+    if ((mkfifo(s_Fifo, 0666) != 0) && (errno != EEXIST)) return false;
+    /** Open it for reading and writing, so it never reports EOF to the poll:       */
+    i_FifoFd = open(s_Fifo, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (i_FifoFd < 0) return false;
+    /** Open the record-file, if there is any:                                      */
+    if (s_Record[0] != 0) {
+        i_RecordFd = open(s_Record, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0666);
+        if (i_RecordFd < 0) {
+            Close();
+            return false;
+        }
+    }
+    return true;
+}
+
+void CGpioSim::Close() {
+    if (i_FifoFd   >= 0) close(i_FifoFd);
+    if (i_RecordFd >= 0) close(i_RecordFd);
+    i_FifoFd   = -1;
+    i_RecordFd = -1;
+    i_BufLen   = 0;
+}
+
+unsigned long long CGpioSim::ReadButtons() {
+    return ull_Pressed;
+}
+
+void CGpioSim::WriteLed(int iButton, bool bOn) {
+    if ((iButton < 0) || (iButton >= GPIO_MAX_LINES) || (i_LedPins[iButton] < 0)) return;
+    Record('L', bOn ? 1 : 0, i_LedPins[iButton]);
+}
+
+bool CGpioSim::CanDim(int iButton) {
+    return ((iButton >= 0) && (iButton < GPIO_MAX_LINES) && (i_LedPins[iButton] >= 0));
+}
+
+void CGpioSim::DimLed(int iButton, int iLevel) {
+    if (! CanDim(iButton)) return;
+    Record('D', iLevel, i_LedPins[iButton]);
+}
+
+int CGpioSim::GetFd() {
+    return i_FifoFd;
+}
+
+bool CGpioSim::ReadEvent(unsigned long long* pTimestamp, bool* pFalling, unsigned int* puiPin) {
+    /** Variables:                                                                  */
+    char*           pEnd;
+    char*           pArg;
+    unsigned long long ullStamp;
+    int             iLen;
+    bool            bEdge;
+    ssize_t         RxLen;
+    struct timespec Now, Mono;
+    while (true) {
+        /** Look for a complete line in the buffer, or fetch more input:            */
+        pEnd = (char*) memchr(s_Buffer, '\n', i_BufLen);
+        if (pEnd == 0) {
+            if (i_BufLen == (int) sizeof(s_Buffer)) i_BufLen = 0;
+            RxLen = read(i_FifoFd, &s_Buffer[i_BufLen], sizeof(s_Buffer) - i_BufLen);
+            if (RxLen <= 0) return false;
+            i_BufLen += RxLen;
+            continue;
+        }
+        /** Parse the line and remove it from the buffer:                           */
+        *pEnd = 0;
+        iLen  = (pEnd - s_Buffer) + 1;
+        pArg  = strchr(s_Buffer, ' ');
+        clock_gettime(CLOCK_REALTIME,  &Now);
+        clock_gettime(CLOCK_MONOTONIC, &Mono);
+        *pTimestamp = (unsigned long long) Mono.tv_sec * 1000000000ULL + Mono.tv_nsec;
+        /** A given timestamp is moved from CLOCK_REALTIME to CLOCK_MONOTONIC:      */
+        *puiPin = ui_FirstPin;
+        if (pArg != 0) {
+            ullStamp = strtoull(pArg + 1, &pArg, 10);
+            if (ullStamp != 0) {
+                *pTimestamp -= ((unsigned long long) Now.tv_sec * 1000000000ULL + Now.tv_nsec) - ullStamp;
+            }
+            if (*pArg == ' ') *puiPin = strtoul(pArg + 1, 0, 10);
+        }
+        bEdge = true;
+        if (strncmp(s_Buffer, "press", 5) == 0) {
+            *pFalling = true;
+        }else if (strncmp(s_Buffer, "release", 7) == 0) {
+            *pFalling = false;
+        }else{
+            bEdge     = false;
+        }
+        memmove(s_Buffer, &s_Buffer[iLen], i_BufLen - iLen);
+        i_BufLen -= iLen;
+        /** Skip lines, which are no edge:                                          */
+        if ((! bEdge) || (*puiPin >= GPIO_MAX_LINES)) continue;
+        if (*pFalling) ull_Pressed = ull_Pressed |  (1ULL << *puiPin);
+        else           ull_Pressed = ull_Pressed & ~(1ULL << *puiPin);
+        return true;
+    }
+}
+
+void CGpioSim::Mark(char cEvent, int iValue) {
+    Record(cEvent, iValue, -1);
+}
+
+/** Private Functions: **************************************************************/
+
+void CGpioSim::Record(char cEvent, int iValue, int iPin) {
+    /** Variables:                                                                  */
+    char            sLine[48];
+    char            sDigits[24];
+    int             i, n;
+    unsigned long long ullValue;
+    struct timespec Now;
+    /** Called by the event-loop for each LED-write and run, one write() per line:  */
+    if (i_RecordFd < 0) return;
+    clock_gettime(CLOCK_REALTIME, &Now);
+    ullValue = (unsigned long long) Now.tv_sec * 1000000000ULL + Now.tv_nsec;
+    n = 0;
+    sLine[n++] = cEvent;
+    sLine[n++] = ' ';
+    i = 0;
+    do { sDigits[i++] = '0' + (ullValue % 10); ullValue /= 10; } while (ullValue > 0);
+    while (i > 0) sLine[n++] = sDigits[--i];
+    sLine[n++] = ' ';
+    if (iValue < 0) {
+        sLine[n++] = '-';
+        iValue     = -iValue;
+    }
+    do { sDigits[i++] = '0' + (iValue % 10); iValue /= 10; } while (iValue > 0);
+    while (i > 0) sLine[n++] = sDigits[--i];
+    if (iPin >= 0) {
+        sLine[n++] = ' ';
+        do { sDigits[i++] = '0' + (iPin % 10); iPin /= 10; } while (iPin > 0);
+        while (i > 0) sLine[n++] = sDigits[--i];
+    }
+    sLine[n++] = '\n';
+    write(i_RecordFd, sLine, n);
+}
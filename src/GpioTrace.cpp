@@ -0,0 +1,367 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+
+/** Notes: *************************************************************************** 
+
+A trace records the input of another backend and the LED-writes, so the presses of
+a unit in the field can be replayed offline. The file is binary and compact: each
+recording starts with "BZT1", its flags (edges or samples), the number of LEDs, the
+LEDs, which can be dimmed, and its start in CLOCK_REALTIME and CLOCK_MONOTONIC. The
+records then follow as a byte for their type and LEB128-varints:
+
+  S <dt> <run> <xor>           buttons changed by xor after run equal samples
+  E <dt> <pin> <falling>       edge-event of a pin
+  L <dt> <led> <level>         LED-write in %
+  M <dt> <event> <value>       fork or exit of a job
+
+The samples are run-length encoded, a sample equal to the previous one only counts
+its run, so the input-thread writes nothing but the changes. The time-deltas are
+zig-zag encoded and taken separately for the input (samples and edges) and the
+output (LEDs and marks), which are written by different threads. Without a backend
+the trace is replayed instead: Next() returns its records in turn, the LED-writes of
+the sequencer are printed with the virtual time ull_Clock.
+
+*************************************************************************************/
+
+/** Global Includes: ****************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "GpioBackend.h"
+
+/** Local Functions: ****************************************************************/
+
+static unsigned long long Now(clockid_t Clock) {
+    struct timespec Time;
+    clock_gettime(Clock, &Time);
+    return (unsigned long long) Time.tv_sec * 1000000000ULL + Time.tv_nsec;
+}
+
+static int Put(unsigned char* pData, unsigned long long ullValue) {
+    /** Variables:                                                                  */
+    int n = 0;
+    /** Seven bits per byte, the highest one marks a further byte:                  */
+    while (ullValue >= 0x80) {
+        pData[n++] = (unsigned char) (ullValue | 0x80);
+        ullValue >>= 7;
+    }
+    pData[n++] = (unsigned char) ullValue;
+    return n;
+}
+
+static unsigned long long Zigzag(long long llValue) {
+    return ((unsigned long long) llValue << 1) ^ (unsigned long long) (llValue >> 63);
+}
+
+static long long Unzigzag(unsigned long long ullValue) {
+    return (long long) (ullValue >> 1) ^ -(long long) (ullValue & 1);
+}
+
+/** Public Functions: ***************************************************************/
+
+CGpioTrace::CGpioTrace(const char* sFile, CGpioBackend* pGpio) {
+    strncpy(s_File, sFile, sizeof(s_File) - 1);
+    s_File[sizeof(s_File) - 1] = 0;
+    p_Gpio     = pGpio;
+    b_Replay   = (pGpio == 0);
+    i_Fd       = -1;
+    i_Leds     = 0;
+    ull_Dim    = 0;
+    ull_Level  = 0;
+    ul_Run     = 0;
+    ull_Input  = 0;
+    ull_Output = 0;
+    ull_Base   = 0;
+    ull_Offset = 0;
+    ull_Clock  = 0;
+    i_BufPos   = 0;
+    i_BufLen   = 0;
+}
+
+CGpioTrace::~CGpioTrace() {
+    Close();
+    if (p_Gpio != 0) delete p_Gpio;
+}
+
+bool CGpioTrace::Init(const unsigned int* puiButtons, const int* piLeds, int nButtons) {
+    /** Variables:                                                                  */
+    int i;
+    if (i_Fd >= 0) close(i_Fd);
+    i_Fd = -1;
+    /** A replay only reads the trace, its pins are the ones of the recording:      */
+    if (b_Replay) {
+        i_Fd = open(s_File, O_RDONLY | O_CLOEXEC);
+        return (i_Fd >= 0);
+    }
+    /** The recorded backend is initialized already, each start is appended:        */
+    if ((nButtons < 1) || (nButtons > GPIO_MAX_LINES)) return false;
+    i_Fd = open(s_File, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0666);
+    if (i_Fd < 0) return false;
+    i_Leds  = nButtons;
+    ull_Dim = 0;
+    for (i=0; i<nButtons; i++) {
+        if (p_Gpio->CanDim(i)) ull_Dim |= 1ULL << i;
+    }
+    Start();
+    return true;
+}
+
+void CGpioTrace::Close() {
+    /** The last samples are only written with the next change, so now:             */
+    if ((! b_Replay) && (i_Fd >= 0) && (ul_Run > 0)) {
+        ul_Run--;
+        Sample(ull_Level, Now(CLOCK_MONOTONIC));
+    }
+    if (i_Fd >= 0) close(i_Fd);
+    i_Fd     = -1;
+    i_BufPos = 0;
+    i_BufLen = 0;
+    if (p_Gpio != 0) p_Gpio->Close();
+}
+
+unsigned long long CGpioTrace::ReadButtons() {
+    /** Variables:                                                                  */
+    unsigned long long ullLevel;
+    if (b_Replay) return ull_Level;
+    /** Only a change is written, the samples before are just counted:              */
+    ullLevel = p_Gpio->ReadButtons();
+    if (i_Fd < 0) return ullLevel;
+    if (ullLevel == ull_Level) {
+        ul_Run++;
+    }else{
+        Sample(ullLevel, Now(CLOCK_MONOTONIC));
+    }
+    return ullLevel;
+}
+
+void CGpioTrace::WriteLed(int iButton, bool bOn) {
+    DimLed(iButton, bOn ? 100 : 0);
+}
+
+bool CGpioTrace::CanDim(int iButton) {
+    if (b_Replay) return ((iButton >= 0) && (iButton < GPIO_MAX_LINES) && (ull_Dim & (1ULL << iButton)));
+    return p_Gpio->CanDim(iButton);
+}
+
+void CGpioTrace::DimLed(int iButton, int iLevel) {
+    /** Variables:                                                                  */
+    unsigned char      ubData[32];
+    unsigned long long ullNow;
+    int                n;
+    if (b_Replay) {
+        Report("led %i %i\n", iButton, iLevel);
+        return;
+    }
+    /** Full levels are switched, as the sequencer would have done it:              */
+    if      (iLevel >= 100) p_Gpio->WriteLed(iButton, true );
+    else if (iLevel <= 0  ) p_Gpio->WriteLed(iButton, false);
+    else                    p_Gpio->DimLed  (iButton, iLevel);
+    if ((i_Fd < 0) || (iButton < 0)) return;
+    ullNow     = Now(CLOCK_MONOTONIC);
+    ubData[0]  = TRACE_LED;
+    n          = 1 + Put(&ubData[1], Zigzag((long long) (ullNow - ull_Output)));
+    n         += Put(&ubData[n], iButton);
+    ubData[n++] = (unsigned char) iLevel;
+    ull_Output = ullNow;
+    Write(ubData, n);
+}
+
+int CGpioTrace::GetFd() {
+    return (b_Replay) ? -1 : p_Gpio->GetFd();
+}
+
+bool CGpioTrace::ReadEvent(unsigned long long* pTimestamp, bool* pFalling, unsigned int* puiPin) {
+    /** Variables:                                                                  */
+    unsigned char ubData[32];
+    int           n;
+    if ((b_Replay) || (! p_Gpio->ReadEvent(pTimestamp, pFalling, puiPin))) return false;
+    if (i_Fd < 0) return true;
+    /** Each edge is written with the timestamp of the kernel:                      */
+    ubData[0]   = TRACE_EDGE;
+    n           = 1 + Put(&ubData[1], Zigzag((long long) (*pTimestamp - ull_Input)));
+    n          += Put(&ubData[n], *puiPin);
+    ubData[n++] = (*pFalling) ? 1 : 0;
+    ull_Input   = *pTimestamp;
+    Write(ubData, n);
+    return true;
+}
+
+void CGpioTrace::Mark(char cEvent, int iValue) {
+    /** Variables:                                                                  */
+    unsigned char      ubData[32];
+    unsigned long long ullNow;
+    int                n;
+    if (b_Replay) return;
+    p_Gpio->Mark(cEvent, iValue);
+    if (i_Fd < 0) return;
+    ullNow      = Now(CLOCK_MONOTONIC);
+    ubData[0]   = TRACE_MARK;
+    n           = 1 + Put(&ubData[1], Zigzag((long long) (ullNow - ull_Output)));
+    ubData[n++] = (unsigned char) cEvent;
+    n          += Put(&ubData[n], Zigzag(iValue));
+    ull_Output  = ullNow;
+    Write(ubData, n);
+}
+
+bool CGpioTrace::Next(STraceRecord* pRecord) {
+    /** Variables:                                                                  */
+    unsigned char      ubType, ubByte;
+    unsigned char      ubMagic[3];
+    unsigned long long ullFlags, ullLeds, ullDelta, ullValue;
+    if ((! b_Replay) || (! Byte(&ubType))) return false;
+    memset(pRecord, 0, sizeof(STraceRecord));
+    pRecord->ub_Type = ubType;
+    /** Nothing but the start of a recording may come first:                        */
+    if ((ubType != TRACE_START) && (ull_Base == 0)) return false;
+    switch (ubType) {
+    case TRACE_START:
+        if ((! Byte(&ubMagic[0])) || (! Byte(&ubMagic[1])) || (! Byte(&ubMagic[2])) ||
+            (memcmp(ubMagic, "ZT1", 3) != 0)) return false;
+        if ((! Varint(&ullFlags)) || (! Varint(&ullLeds)) || (! Varint(&ull_Dim)) ||
+            (! Varint(&pRecord->ull_Level)) || (! Varint(&ullValue))) return false;
+        /** A later recording, e.g. after a reboot, never goes back in time:        */
+        if (ull_Base == 0) ull_Base = ullValue;
+        if (ullValue + ull_Offset < ull_Clock) ull_Offset = ull_Clock - ullValue;
+        ull_Input  = ull_Output = ullValue + ull_Offset;
+        ull_Level  = 0;
+        i_Leds     = (int) ullLeds;
+        pRecord->ull_Timestamp = ull_Input;
+        pRecord->ui_Index      = i_Leds;
+        pRecord->i_Value       = (int) ullFlags;
+        return true;
+    case TRACE_SAMPLE:
+        if ((! Varint(&ullDelta)) || (! Varint(&ullValue)) || (! Varint(&pRecord->ull_Level))) return false;
+        ull_Input += Unzigzag(ullDelta);
+        pRecord->ull_Timestamp = ull_Input;
+        pRecord->ull_Before    = ull_Level;
+        pRecord->ul_Run        = ullValue;
+        pRecord->ull_Level    ^= ull_Level;
+        ull_Level              = pRecord->ull_Level;
+        return true;
+    case TRACE_EDGE:
+        if ((! Varint(&ullDelta)) || (! Varint(&ullValue)) || (! Byte(&ubByte))) return false;
+        ull_Input += Unzigzag(ullDelta);
+        pRecord->ull_Timestamp = ull_Input;
+        pRecord->ui_Index      = (unsigned int) ullValue;
+        pRecord->i_Value       = ubByte;
+        return true;
+    case TRACE_LED:
+        if ((! Varint(&ullDelta)) || (! Varint(&ullValue)) || (! Byte(&ubByte))) return false;
+        ull_Output += Unzigzag(ullDelta);
+        pRecord->ull_Timestamp = ull_Output;
+        pRecord->ui_Index      = (unsigned int) ullValue;
+        pRecord->i_Value       = ubByte;
+        return true;
+    case TRACE_MARK:
+        if ((! Varint(&ullDelta)) || (! Byte(&ubByte)) || (! Varint(&ullValue))) return false;
+        ull_Output += Unzigzag(ullDelta);
+        pRecord->ull_Timestamp = ull_Output;
+        pRecord->c_Mark        = (char) ubByte;
+        pRecord->i_Value       = (int) Unzigzag(ullValue);
+        return true;
+    }
+    /** Anything else is a damaged trace, which ends here:                          */
+    return false;
+}
+
+void CGpioTrace::Report(const char* sFormat, ...) {
+    /** Variables:                                                                  */
+    unsigned long long ullTime;
+    va_list            Arguments;
+    /** Each line starts with the time since the first recording in s:              */
+    ullTime = (ull_Clock > ull_Base) ? (ull_Clock - ull_Base) / 1000ULL : 0;
+    printf("%llu.%06llu ", ullTime / 1000000ULL, ullTime % 1000000ULL);
+    va_start(Arguments, sFormat);
+    vprintf(sFormat, Arguments);
+    va_end(Arguments);
+}
+
+/** Private Functions: **************************************************************/
+
+void CGpioTrace::Start() {
+    /** Variables:                                                                  */
+    unsigned char ubData[64];
+    int           n;
+    /** The deltas of both directions start with the recording:                     */
+    ull_Level  = 0;
+    ul_Run     = 0;
+    ull_Input  = Now(CLOCK_MONOTONIC);
+    ull_Output = ull_Input;
+    memcpy(ubData, "BZT1", 4);
+    n  = 4;
+    n += Put(&ubData[n], (p_Gpio->GetFd() >= 0) ? TRACE_EDGES : 0);
+    n += Put(&ubData[n], i_Leds);
+    n += Put(&ubData[n], ull_Dim);
+    n += Put(&ubData[n], Now(CLOCK_REALTIME));
+    n += Put(&ubData[n], ull_Input);
+    Write(ubData, n);
+}
+
+void CGpioTrace::Sample(unsigned long long ullLevel, unsigned long long ullTimestamp) {
+    /** Variables:                                                                  */
+    unsigned char ubData[40];
+    int           n;
+    /** The run of the previous level and the pins, which changed:                  */
+    ubData[0]  = TRACE_SAMPLE;
+    n          = 1 + Put(&ubData[1], Zigzag((long long) (ullTimestamp - ull_Input)));
+    n         += Put(&ubData[n], ul_Run);
+    n         += Put(&ubData[n], ullLevel ^ ull_Level);
+    ull_Level  = ullLevel;
+    ul_Run     = 0;
+    ull_Input  = ullTimestamp;
+    Write(ubData, n);
+}
+
+void CGpioTrace::Write(const unsigned char* pData, int iLength) {
+    /** A record is written at once, so those of both threads never interleave:     */
+    write(i_Fd, pData, iLength);
+}
+
+bool CGpioTrace::Byte(unsigned char* pubValue) {
+    /** Variables:                                                                  */
+    ssize_t RxLen;
+    /** Refill the read-ahead, once it is used up:                                  */
+    if (i_BufPos >= i_BufLen) {
+        RxLen = read(i_Fd, ub_Buffer, sizeof(ub_Buffer));
+        if (RxLen <= 0) return false;
+        i_BufPos = 0;
+        i_BufLen = (int) RxLen;
+    }
+    *pubValue = ub_Buffer[i_BufPos++];
+    return true;
+}
+
+bool CGpioTrace::Varint(unsigned long long* pullValue) {
+    /** Variables:                                                                  */
+    unsigned char ubByte;
+    int           iShift;
+    *pullValue = 0;
+    for (iShift=0; iShift<64; iShift+=7) {
+        if (! Byte(&ubByte)) return false;
+        *pullValue |= (unsigned long long) (ubByte & 0x7F) << iShift;
+        if ((ubByte & 0x80) == 0) return true;
+    }
+    return false;
+}
@@ -0,0 +1,202 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+
+/** Global Includes: ****************************************************************/
+
+#include <string.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+
+#include "GpioBackend.h"
+#include "PressRing.h"
+#include "Gestures.h"
+#include "InputThread.h"
+
+/** Local Functions: ****************************************************************/
+
+static unsigned long long Now() {
+    struct timespec Time;
+    clock_gettime(CLOCK_MONOTONIC, &Time);
+    return (unsigned long long) Time.tv_sec * 1000000000ULL + Time.tv_nsec;
+}
+
+/** Public Functions: ***************************************************************/
+
+CInputThread::CInputThread() {
+    b_Running  = false;
+    b_Realtime = false;
+    b_Locked   = false;
+    b_Stop.store(false);
+    i_WakeFd   = -1;
+    i_NotifyFd = -1;
+    p_Gpio     = 0;
+    p_Gestures = 0;
+    p_Ring     = 0;
+    ull_Period = 0;
+}
+
+CInputThread::~CInputThread() {
+    Stop();
+    if (i_WakeFd   >= 0) close(i_WakeFd);
+    if (i_NotifyFd >= 0) close(i_NotifyFd);
+}
+
+bool CInputThread::Init() {
+    /** The descriptors are kept, while the thread is restarted with other pins:    */
+    if (i_WakeFd   < 0) i_WakeFd   = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (i_NotifyFd < 0) i_NotifyFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    return ((i_WakeFd >= 0) && (i_NotifyFd >= 0));
+}
+
+bool CInputThread::Start(CGpioBackend* pGpio, CGestures* pGestures, CPressRing* pRing, unsigned long long ullPeriod,
+                         int iPriority, int iCpu) {
+    /** Variables:                                                                  */
+    pthread_attr_t     Attributes;
+    struct sched_param Param;
+    cpu_set_t          Cpus;
+    int                iResult;
+    if ((b_Running) || (! Init())) return false;
+    p_Gpio     = pGpio;
+    p_Gestures = pGestures;
+    p_Ring     = pRing;
+    ull_Period = ullPeriod;
+    b_Stop.store(false);
+    /** Lock all pages of the daemon once, the later ones, like the stack, as well: */
+    if (! b_Locked) b_Locked = (mlockall(MCL_CURRENT | MCL_FUTURE) == 0);
+    /** Create the thread with its priority and CPU, else as a normal one:          */
+    pthread_attr_init(&Attributes);
+    pthread_attr_setstacksize(&Attributes, INPUT_STACK_SIZE);
+    if (iCpu >= 0) {
+        CPU_ZERO(&Cpus);
+        CPU_SET(iCpu, &Cpus);
+        pthread_attr_setaffinity_np(&Attributes, sizeof(Cpus), &Cpus);
+    }
+    iResult    = -1;
+    b_Realtime = false;
+    if (iPriority > 0) {
+        pthread_attr_setinheritsched(&Attributes, PTHREAD_EXPLICIT_SCHED);
+        pthread_attr_setschedpolicy(&Attributes, SCHED_FIFO);
+        memset(&Param, 0, sizeof(Param));
+        Param.sched_priority = iPriority;
+        pthread_attr_setschedparam(&Attributes, &Param);
+        iResult    = pthread_create(&Thread, &Attributes, Run, this);
+        b_Realtime = (iResult == 0);
+    }
+    if (iResult != 0) {
+        /** Without the right for SCHED_FIFO, it still keeps the input apart:       */
+        pthread_attr_setinheritsched(&Attributes, PTHREAD_INHERIT_SCHED);
+        iResult = pthread_create(&Thread, &Attributes, Run, this);
+    }
+    pthread_attr_destroy(&Attributes);
+    b_Running = (iResult == 0);
+    return b_Running;
+}
+
+void CInputThread::Stop() {
+    /** Variables:                                                                  */
+    unsigned long long ullOne = 1;
+    /** Wake the thread and wait, until it is gone:                                 */
+    if (! b_Running) return;
+    b_Stop.store(true);
+    if (write(i_WakeFd, &ullOne, sizeof(ullOne)) != sizeof(ullOne)) {};
+    pthread_join(Thread, 0);
+    if (read(i_WakeFd, &ullOne, sizeof(ullOne)) < 0) {};
+    Drain();
+    b_Running = false;
+}
+
+void CInputThread::Unlock() {
+    /** Without a real-time thread, the pages of the daemon may be swapped again:   */
+    if ((! b_Locked) || (b_Running)) return;
+    munlockall();
+    b_Locked = false;
+}
+
+void CInputThread::Drain() {
+    /** Variables:                                                                  */
+    unsigned long long ullCount;
+    /** Only resets the eventfd, the gestures are taken from the press-ring:        */
+    if (i_NotifyFd < 0) return;
+    if (read(i_NotifyFd, &ullCount, sizeof(ullCount)) < 0) {};
+}
+
+/** Private Functions: **************************************************************/
+
+void* CInputThread::Run(void* pThis) {
+    ((CInputThread*) pThis)->Loop();
+    return 0;
+}
+
+void CInputThread::Loop() {
+    /** Variables:                                                                  */
+    struct pollfd      Fds[2];
+    struct timespec    Timeout;
+    unsigned long long ullNow, ullDue, ullDeadline, ullNext = 0, ullValue = 1;
+    unsigned long long ullTimestamp;
+    unsigned int       uiPin, uiPushed;
+    bool               bFalling;
+    int                nFds;
+    /** The timers of this thread expire exactly, not up to 50 us later:            */
+    prctl(PR_SET_TIMERSLACK, 1);
+    Fds[0].fd     = i_WakeFd;
+    Fds[0].events = POLLIN;
+    Fds[1].fd     = p_Gpio->GetFd();
+    Fds[1].events = POLLIN;
+    nFds = (ull_Period == 0) ? 2 : 1;
+    if (ull_Period > 0) ullNext = Now() + ull_Period;
+    while (! b_Stop.load(std::memory_order_relaxed)) {
+        /** Sleep until the next sample, the next open gesture or an edge:          */
+        ullDue      = ullNext;
+        ullDeadline = p_Gestures->NextDeadline();
+        if ((ullDeadline != 0) && ((ullDue == 0) || (ullDeadline < ullDue))) ullDue = ullDeadline;
+        ullNow = Now();
+        if (ullDue > ullNow) {
+            Timeout.tv_sec  = (ullDue - ullNow) / 1000000000ULL;
+            Timeout.tv_nsec = (ullDue - ullNow) % 1000000000ULL;
+        }else{
+            Timeout.tv_sec  = 0;
+            Timeout.tv_nsec = 0;
+        }
+        if (ppoll(Fds, nFds, (ullDue != 0) ? &Timeout : 0, 0) < 0) continue;
+        if (Fds[0].revents != 0) continue;
+        /** Feed the gesture-engine and wake the main-loop for the new gestures:    */
+        ullNow   = Now();
+        uiPushed = p_Ring->Pushed();
+        if ((nFds > 1) && (Fds[1].revents != 0)) {
+            while (p_Gpio->ReadEvent(&ullTimestamp, &bFalling, &uiPin)) p_Gestures->Edge(uiPin, bFalling, ullTimestamp);
+        }
+        if ((ull_Period > 0) && (ullNow >= ullNext)) {
+            p_Gestures->Sample(p_Gpio->ReadButtons(), ullNow);
+            /** Keep the grid of the samples, but skip those, which are long over:  */
+            ullNext += ull_Period;
+            if (ullNext <= ullNow) ullNext = ullNow + ull_Period;
+        }
+        ullDeadline = p_Gestures->NextDeadline();
+        if ((ullDeadline != 0) && (ullDeadline <= ullNow)) p_Gestures->Expire(ullNow);
+        if (p_Ring->Pushed() != uiPushed) {
+            if (write(i_NotifyFd, &ullValue, sizeof(ullValue)) != sizeof(ullValue)) {};
+        }
+    }
+}
@@ -0,0 +1,82 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/** Notes: *************************************************************************** 
+
+Optional real-time input. A dedicated thread reads the edges of the buttons or
+samples them at a fixed rate, feeds the gesture-engine and pushes the gestures into
+the press-ring, so the input is neither delayed by spawning, syslog or clients nor
+by the other load of the board. The thread may run with SCHED_FIFO and be pinned to
+one CPU. Its small stack is locked and pre-faulted together with the rest of the
+daemon, so it never waits for a page-fault. The memory is locked on the first start
+and stays locked across restarts, until the daemon unlocks it without the thread. The main-loop is woken via an eventfd,
+whenever a gesture was pushed.
+
+While the thread runs, it is the only one, which uses the GPIO-input and the
+gesture-engine. The main-loop stops it, before it changes either of them.
+
+*************************************************************************************/
+
+/** Global Includes: ****************************************************************/
+
+#include <atomic>
+#include <pthread.h>
+
+/** Local Defines: ******************************************************************/
+
+#define INPUT_STACK_SIZE (256 * 1024)
+
+/** Class Definition: ***************************************************************/
+
+class CGpioBackend;
+class CGestures;
+class CPressRing;
+
+class CInputThread {
+public:
+    // Methods:
+    CInputThread();
+    ~CInputThread();
+    bool Init    ();
+    bool Start   (CGpioBackend* pGpio, CGestures* pGestures, CPressRing* pRing, unsigned long long ullPeriod,
+                  int iPriority, int iCpu);
+    void Stop    ();
+    void Unlock  ();
+    bool Running () { return b_Running; };
+    bool Realtime() { return b_Realtime; };
+    bool Locked  () { return b_Locked; };
+    int  GetFd   () { return i_NotifyFd; };
+    void Drain   ();
+private:
+    // Properties:
+    pthread_t          Thread;
+    bool               b_Running;
+    bool               b_Realtime;              // Got SCHED_FIFO.
+    bool               b_Locked;                // Got all pages locked.
+    std::atomic<bool>  b_Stop;
+    int                i_WakeFd;                // Stops the thread.
+    int                i_NotifyFd;              // Wakes the main-loop.
+    CGpioBackend*      p_Gpio;
+    CGestures*         p_Gestures;
+    CPressRing*        p_Ring;
+    unsigned long long ull_Period;              // Sampling-period in ns, 0 for edges.
+    // Methods:
+    static void* Run (void* pThis);
+    void Loop    ();
+};
@@ -0,0 +1,337 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/** Global Includes: ****************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "JobQueue.h"
+
+/** Static Members: *****************************************************************/
+
+unsigned long CJobQueue::ul_NextId = 0;
+
+/** Public Functions: ***************************************************************/
+
+CJobQueue::CJobQueue() {
+    p_Queue       = 0;
+    i_Capacity    = 0;
+    i_Head        = 0;
+    i_Count       = 0;
+    p_Held        = 0;
+    i_HeldHead    = 0;
+    i_HeldCount   = 0;
+    i_MaxParallel = 1;
+    i_Running     = 0;
+    ub_Policy     = OVERFLOW_BLOCK;
+    i_BatchSize   = 1;
+    ull_BatchWindow = 0;
+    ul_Dropped    = 0;
+    ul_Coalesced  = 0;
+    ul_Held       = 0;
+    memset(Slots,    0, sizeof(Slots));
+    memset(i_Stamps, 0, sizeof(i_Stamps));
+    memset(&LastJob, 0, sizeof(LastJob));
+}
+
+CJobQueue::~CJobQueue() {
+    delete[] p_Queue;
+    delete[] p_Held;
+}
+
+bool CJobQueue::Init(int iCapacity, int iMaxParallel, unsigned char ubPolicy) {
+    /** The queue is allocated once, so pushing a press never allocates:            */
+    if ((iCapacity < 1) || (iMaxParallel < 1) || (iMaxParallel > JOB_MAX_PARALLEL)) return false;
+    delete[] p_Queue;
+    delete[] p_Held;
+    p_Queue       = new SJob[iCapacity];
+    p_Held        = new SJob[iCapacity];
+    i_Capacity    = iCapacity;
+    i_Head        = 0;
+    i_Count       = 0;
+    i_HeldHead    = 0;
+    i_HeldCount   = 0;
+    ul_Held       = 0;
+    i_MaxParallel = iMaxParallel;
+    ub_Policy     = ubPolicy;
+    return true;
+}
+
+bool CJobQueue::Reconfigure(int iCapacity, int iMaxParallel, unsigned char ubPolicy) {
+    /** Variables:                                                                  */
+    SJob* pQueue;
+    SJob* pHeld;
+    int   i, n, iHeld;
+    if ((iCapacity < 1) || (iMaxParallel < 1) || (iMaxParallel > JOB_MAX_PARALLEL)) return false;
+    /** Move the waiting jobs into a ring of the new size, oldest first:            */
+    if (iCapacity != i_Capacity) {
+        pQueue = new SJob[iCapacity];
+        n = (i_Count < iCapacity) ? i_Count : iCapacity;
+        for (i=0; i<n; i++) pQueue[i] = p_Queue[(i_Head + i) % i_Capacity];
+        /** The newest jobs, which do not fit, are dropped with all their presses:  */
+        for (i=n; i<i_Count; i++) ul_Dropped += p_Queue[(i_Head + i) % i_Capacity].i_Presses;
+        /** The held presses are never dropped, the newest ones merge instead:      */
+        pHeld = new SJob[iCapacity];
+        iHeld = (i_HeldCount < iCapacity) ? i_HeldCount : iCapacity;
+        for (i=0; i<iHeld; i++) pHeld[i] = p_Held[(i_HeldHead + i) % i_Capacity];
+        for (i=iHeld; i<i_HeldCount; i++) pHeld[iHeld - 1].i_Presses += p_Held[(i_HeldHead + i) % i_Capacity].i_Presses;
+        delete[] p_Queue;
+        delete[] p_Held;
+        p_Queue     = pQueue;
+        p_Held      = pHeld;
+        i_Capacity  = iCapacity;
+        i_Head      = 0;
+        i_Count     = n;
+        i_HeldHead  = 0;
+        i_HeldCount = iHeld;
+    }
+    /** Running jobs keep their slots, fewer ones are just started from now on:     */
+    i_MaxParallel = iMaxParallel;
+    ub_Policy     = ubPolicy;
+    return true;
+}
+
+bool CJobQueue::SetBatch(int iSize, unsigned long long ullWindow) {
+    /** A size of 1 starts each job on its own, as without batching:                */
+    if ((iSize < 1) || (iSize > JOB_MAX_BATCH)) return false;
+    i_BatchSize     = iSize;
+    ull_BatchWindow = ullWindow;
+    return true;
+}
+
+void CJobQueue::Clear() {
+    /** Variables:                                                                  */
+    int i;
+    /** Drop all waiting jobs with their presses, the running ones finish as usual: */
+    for (i=0; i<i_Count; i++) ul_Dropped += p_Queue[(i_Head + i) % i_Capacity].i_Presses;
+    ul_Dropped += ul_Held;
+    i_Head      = 0;
+    i_Count     = 0;
+    i_HeldHead  = 0;
+    i_HeldCount = 0;
+    ul_Held     = 0;
+}
+
+void CJobQueue::Push(unsigned long long ullTimestamp) {
+    /** If there is room, simply append the press as a new job:                     */
+    if (i_Count < i_Capacity) {
+        Append(ullTimestamp, 1);
+        return;
+    }
+    /** Otherwise apply the overflow-policy:                                        */
+    switch (ub_Policy) {
+    case OVERFLOW_DROP_OLDEST:
+        /** A coalesced job takes all of its presses along:                         */
+        ul_Dropped += p_Queue[i_Head].i_Presses;
+        i_Head = (i_Head + 1) % i_Capacity;
+        i_Count--;
+        Append(ullTimestamp, 1);
+        break;
+    case OVERFLOW_DROP_NEWEST:
+        ul_Dropped++;
+        break;
+    case OVERFLOW_COALESCE:
+        p_Queue[(i_Head + i_Count - 1) % i_Capacity].i_Presses++;
+        ul_Coalesced++;
+        break;
+    default:
+        /** Block: hold the press back with its timestamp, until there is room:     */
+        Hold(ullTimestamp, 1);
+        break;
+    }
+}
+
+SJob* CJobQueue::Start(unsigned long long ullTimestamp) {
+    /** Variables:                                                                  */
+    int   i;
+    SJob* pJob = 0;
+    int   iTaken = 1;
+    /** Check, if a job is waiting and may run in parallel to the others:           */
+    if ((i_Count == 0) || (i_Running >= i_MaxParallel)) return 0;
+    if (Waiting(ullTimestamp)) return 0;
+    for (i=0; (i<JOB_MAX_PARALLEL) && (pJob == 0); i++) {
+        if (! Slots[i].b_Running) pJob = &Slots[i];
+    }
+    if (pJob == 0) return 0;
+    /** Move the oldest job into the free slot:                                     */
+    *pJob = p_Queue[i_Head];
+    i_Stamps[pJob - Slots] = 0;
+    Take(pJob - Slots);
+    /** A batch takes the following jobs as well, as long as their presses fit:     */
+    while ((i_Count > 0) && (pJob->i_Presses + p_Queue[i_Head].i_Presses <= i_BatchSize)) {
+        pJob->i_Presses += p_Queue[i_Head].i_Presses;
+        Take(pJob - Slots);
+        iTaken++;
+    }
+    pJob->b_Running    = true;
+    pJob->ull_Started  = ullTimestamp;
+    pJob->ull_Deadline = 0;
+    pJob->ub_Stage     = JOB_STAGE_RUNNING;
+    pJob->pid          = -1;
+    i_Running++;
+    /** Admit held back presses into the room, which just became free:              */
+    for (i=0; (i<iTaken) && (i_HeldCount > 0); i++) {
+        Append(p_Held[i_HeldHead].ull_Enqueued, p_Held[i_HeldHead].i_Presses);
+        ul_Held    -= p_Held[i_HeldHead].i_Presses;
+        i_HeldHead  = (i_HeldHead + 1) % i_Capacity;
+        i_HeldCount--;
+    }
+    return pJob;
+}
+
+SJob* CJobQueue::FindPid(pid_t pid) {
+    /** Variables:                                                                  */
+    int i;
+    for (i=0; i<JOB_MAX_PARALLEL; i++) {
+        if ((Slots[i].b_Running) && (Slots[i].pid == pid)) return &Slots[i];
+    }
+    return 0;
+}
+
+SJob* CJobQueue::FindId(unsigned long ulId) {
+    /** Variables:                                                                  */
+    int i;
+    for (i=0; i<JOB_MAX_PARALLEL; i++) {
+        if ((Slots[i].b_Running) && (Slots[i].ul_Id == ulId)) return &Slots[i];
+    }
+    return 0;
+}
+
+void CJobQueue::Finish(SJob* pJob, int iExitCode, unsigned long long ullTimestamp) {
+    /** Note the result and free the slot:                                          */
+    if ((pJob == 0) || (! pJob->b_Running)) return;
+    pJob->i_ExitCode   = iExitCode;
+    pJob->ull_Finished = ullTimestamp;
+    pJob->b_Running    = false;
+    LastJob            = *pJob;
+    i_Running--;
+}
+
+int CJobQueue::Queued() {
+    return i_Count;
+}
+
+int CJobQueue::Held() {
+    return (int) ul_Held;
+}
+
+int CJobQueue::Running() {
+    return i_Running;
+}
+
+int CJobQueue::Presses() {
+    /** Variables:                                                                  */
+    int i, n;
+    /** Count the presses of all waiting, held back and running jobs:               */
+    n = (int) ul_Held;
+    for (i=0; i<i_Count; i++) n += p_Queue[(i_Head + i) % i_Capacity].i_Presses;
+    for (i=0; i<JOB_MAX_PARALLEL; i++) {
+        if (Slots[i].b_Running) n += Slots[i].i_Presses;
+    }
+    return n;
+}
+
+int CJobQueue::Stamps(const SJob* pJob, const unsigned long long** ppStamps) {
+    /** The timestamps of the presses, which a running job took, oldest first:      */
+    if ((pJob < Slots) || (pJob >= &Slots[JOB_MAX_PARALLEL])) return 0;
+    *ppStamps = ull_Stamps[pJob - Slots];
+    return i_Stamps[pJob - Slots];
+}
+
+unsigned long long CJobQueue::NextBatch(unsigned long long ullTimestamp) {
+    /** A batch, which is not full yet, is due at the end of its window:            */
+    if ((i_Running >= i_MaxParallel) || (! Waiting(ullTimestamp))) return 0;
+    return p_Queue[i_Head].ull_Enqueued + ull_BatchWindow;
+}
+
+SJob* CJobQueue::Overdue(unsigned long long ullTimestamp) {
+    /** Variables:                                                                  */
+    int i;
+    /** Find a running job, whose timeout or grace-time is over:                    */
+    for (i=0; i<JOB_MAX_PARALLEL; i++) {
+        if ((Slots[i].b_Running) && (Slots[i].ull_Deadline != 0) && (Slots[i].ull_Deadline <= ullTimestamp)) {
+            return &Slots[i];
+        }
+    }
+    return 0;
+}
+
+unsigned long long CJobQueue::NextDeadline() {
+    /** Variables:                                                                  */
+    unsigned long long ullNext = 0;
+    int i;
+    /** The earliest timeout or grace-time of the running jobs, 0 for none:         */
+    for (i=0; i<JOB_MAX_PARALLEL; i++) {
+        if ((! Slots[i].b_Running) || (Slots[i].ull_Deadline == 0)) continue;
+        if ((ullNext == 0) || (Slots[i].ull_Deadline < ullNext)) ullNext = Slots[i].ull_Deadline;
+    }
+    return ullNext;
+}
+
+/** Private Functions: **************************************************************/
+
+void CJobQueue::Append(unsigned long long ullTimestamp, int iPresses) {
+    /** Variables:                                                                  */
+    SJob* pJob;
+    /** Fill the next free entry of the ring:                                       */
+    pJob = &p_Queue[(i_Head + i_Count) % i_Capacity];
+    memset(pJob, 0, sizeof(SJob));
+    pJob->ul_Id        = ++ul_NextId;
+    pJob->ull_Enqueued = ullTimestamp;
+    pJob->i_Presses    = iPresses;
+    pJob->pid          = -1;
+    i_Count++;
+}
+
+void CJobQueue::Hold(unsigned long long ullTimestamp, int iPresses) {
+    /** A held press keeps its timestamp, a full ring merges it into the newest:    */
+    if (i_HeldCount < i_Capacity) {
+        p_Held[(i_HeldHead + i_HeldCount) % i_Capacity].ull_Enqueued = ullTimestamp;
+        p_Held[(i_HeldHead + i_HeldCount) % i_Capacity].i_Presses    = iPresses;
+        i_HeldCount++;
+    }else{
+        p_Held[(i_HeldHead + i_HeldCount - 1) % i_Capacity].i_Presses += iPresses;
+    }
+    ul_Held += iPresses;
+}
+
+void CJobQueue::Take(int iSlot) {
+    /** Variables:                                                                  */
+    SJob* pJob = &p_Queue[i_Head];
+    int   i;
+    /** Note a timestamp for each press of the oldest job and remove it:            */
+    for (i=0; (i<pJob->i_Presses) && (i_Stamps[iSlot] < JOB_MAX_BATCH); i++) {
+        ull_Stamps[iSlot][i_Stamps[iSlot]++] = pJob->ull_Enqueued;
+    }
+    i_Head = (i_Head + 1) % i_Capacity;
+    i_Count--;
+}
+
+bool CJobQueue::Waiting(unsigned long long ullTimestamp) {
+    /** Variables:                                                                  */
+    int i, n;
+    /** Without batching or once its window is over, the oldest job starts:         */
+    if ((i_BatchSize < 2) || (i_Count == 0)) return false;
+    if (ullTimestamp >= p_Queue[i_Head].ull_Enqueued + ull_BatchWindow) return false;
+    /** Otherwise the batch waits, until it is full:                                */
+    n = (int) ul_Held;
+    for (i=0; (i<i_Count) && (n<i_BatchSize); i++) n += p_Queue[(i_Head + i) % i_Capacity].i_Presses;
+    return (n < i_BatchSize);
+}
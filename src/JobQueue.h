@@ -0,0 +1,111 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/** Global Includes: ****************************************************************/
+
+#include <sys/types.h>
+
+/** Local Defines: ******************************************************************/
+
+#define JOB_MAX_PARALLEL     64
+#define JOB_MAX_BATCH        64                 // Presses, which one run may take.
+
+#define OVERFLOW_BLOCK       1
+#define OVERFLOW_DROP_OLDEST 2
+#define OVERFLOW_DROP_NEWEST 3
+#define OVERFLOW_COALESCE    4
+
+#define JOB_REPLAYED         0                  // Timestamp of a press replayed from the journal.
+
+#define JOB_EXIT_FAILED      -1                 // Not started or ended by a signal.
+#define JOB_EXIT_TIMEOUT     -2                 // Terminated after its timeout.
+#define JOB_EXIT_KILLED      -3                 // Killed, as it ignored SIGTERM or a limit.
+
+#define JOB_STAGE_RUNNING    0
+#define JOB_STAGE_TERMINATED 1                  // SIGTERM was sent after the timeout.
+#define JOB_STAGE_KILLED     2                  // SIGKILL was sent after the grace-time.
+
+/** Type-Definitions: ***************************************************************/
+
+struct SJob {
+    unsigned long      ul_Id;
+    unsigned long long ull_Enqueued;
+    unsigned long long ull_Started;
+    unsigned long long ull_Finished;
+    unsigned long long ull_Deadline;            // 0 without a timeout.
+    pid_t              pid;
+    int                i_Presses;
+    int                i_ExitCode;
+    bool               b_Running;
+    unsigned char      ub_Stage;                // One of JOB_STAGE_*.
+};
+
+/** Class Definition: ***************************************************************/
+
+class CJobQueue {
+public:
+    // Properties:
+    unsigned long      ul_Dropped;              // Presses, a dropped job counts all of its own.
+    unsigned long      ul_Coalesced;
+    unsigned long      ul_Held;
+    SJob               LastJob;
+    // Methods:
+    CJobQueue();
+    ~CJobQueue();
+    bool  Init    (int iCapacity, int iMaxParallel, unsigned char ubPolicy);
+    bool  Reconfigure(int iCapacity, int iMaxParallel, unsigned char ubPolicy);
+    bool  SetBatch(int iSize, unsigned long long ullWindow);
+    void  Clear   ();
+    void  Push    (unsigned long long ullTimestamp);
+    SJob* Start   (unsigned long long ullTimestamp);
+    SJob* FindPid (pid_t pid);
+    SJob* FindId  (unsigned long ulId);
+    void  Finish  (SJob* pJob, int iExitCode, unsigned long long ullTimestamp);
+    int   Queued  ();
+    int   Held    ();
+    int   Running ();
+    int   Presses ();
+    int   Stamps  (const SJob* pJob, const unsigned long long** ppStamps);
+    unsigned long long NextBatch(unsigned long long ullTimestamp);
+    SJob* Overdue (unsigned long long ullTimestamp);
+    unsigned long long NextDeadline();
+private:
+    // Properties:
+    SJob*              p_Queue;
+    int                i_Capacity;
+    int                i_Head;
+    int                i_Count;
+    SJob*              p_Held;                  // Presses held back with their timestamps.
+    int                i_HeldHead;
+    int                i_HeldCount;
+    int                i_MaxParallel;
+    int                i_Running;
+    unsigned char      ub_Policy;
+    int                i_BatchSize;
+    unsigned long long ull_BatchWindow;         // In ns, 0 takes the presses waiting.
+    static unsigned long ul_NextId;             // Shared, so ids are unique in all queues.
+    SJob               Slots[JOB_MAX_PARALLEL];
+    unsigned long long ull_Stamps[JOB_MAX_PARALLEL][JOB_MAX_BATCH];
+    int                i_Stamps  [JOB_MAX_PARALLEL];
+    // Methods:
+    void  Append  (unsigned long long ullTimestamp, int iPresses);
+    void  Hold    (unsigned long long ullTimestamp, int iPresses);
+    void  Take    (int iSlot);
+    bool  Waiting (unsigned long long ullTimestamp);
+};
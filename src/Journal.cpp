@@ -0,0 +1,252 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/** Global Includes: ****************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "Journal.h"
+
+/** Local Defines: ******************************************************************/
+
+#define JOURNAL_MIN_RECORDS 1024                // Room for all keys after compaction.
+
+/** Public Functions: ***************************************************************/
+
+CJournal::CJournal() {
+    s_File[0] = 0;
+    i_Fd      = -1;
+    p_Records = 0;
+    i_Records = 0;
+    i_Next    = 0;
+    i_Synced  = 0;
+    ui_Seq    = 0;
+    ub_Sync   = JOURNAL_SYNC_BATCH;
+    memset(i_Pending, 0, sizeof(i_Pending));
+}
+
+CJournal::~CJournal() {
+    Close();
+}
+
+bool CJournal::Open(const char* sFile, int iRecords, unsigned char ubSync, bool bReplay) {
+    /** Another file starts with the pending presses of this one, unless replayed:  */
+    Close();
+    if (strlen(sFile) + 5 > sizeof(s_File)) return false;
+    strcpy(s_File, sFile);
+    i_Records = (iRecords > JOURNAL_MIN_RECORDS) ? iRecords : JOURNAL_MIN_RECORDS;
+    ub_Sync   = ubSync;
+    if (bReplay) {
+        memset(i_Pending, 0, sizeof(i_Pending));
+        Load();
+    }
+    return Compact();
+}
+
+void CJournal::Close() {
+    /** Make the last records durable, the pending presses are kept:                */
+    if (p_Records == 0) return;
+    if (ub_Sync != JOURNAL_SYNC_NONE) Sync();
+    munmap(p_Records, i_Records * sizeof(SJournalRecord));
+    close(i_Fd);
+    p_Records = 0;
+    i_Fd      = -1;
+}
+
+void CJournal::Press(unsigned int uiPin, unsigned char ubGesture, int iPresses) {
+    /** Note the accepted presses, before they are queued:                          */
+    if ((p_Records == 0) || (uiPin >= JOURNAL_PINS) || (ubGesture >= JOURNAL_GESTURES) || (iPresses < 1)) return;
+    i_Pending[uiPin][ubGesture] += iPresses;
+    Append(JOURNAL_PRESS, uiPin, ubGesture, 0, 0, iPresses);
+}
+
+void CJournal::Finish(unsigned int uiPin, unsigned char ubGesture, unsigned long ulId, int iPresses, int iExitCode) {
+    /** The presses of a finished job are done, whatever its result:                */
+    if ((p_Records == 0) || (uiPin >= JOURNAL_PINS) || (ubGesture >= JOURNAL_GESTURES)) return;
+    i_Pending[uiPin][ubGesture] -= (iPresses < i_Pending[uiPin][ubGesture]) ? iPresses : i_Pending[uiPin][ubGesture];
+    Append(JOURNAL_FINISH, uiPin, ubGesture, ulId, iExitCode, iPresses);
+}
+
+void CJournal::Drop(unsigned int uiPin, unsigned char ubGesture, int iPresses) {
+    /** Dropped presses will never be run, so they must not be replayed:            */
+    if ((p_Records == 0) || (uiPin >= JOURNAL_PINS) || (ubGesture >= JOURNAL_GESTURES) || (iPresses < 1)) return;
+    i_Pending[uiPin][ubGesture] -= (iPresses < i_Pending[uiPin][ubGesture]) ? iPresses : i_Pending[uiPin][ubGesture];
+    Append(JOURNAL_DROP, uiPin, ubGesture, 0, 0, iPresses);
+}
+
+bool CJournal::Service() {
+    /** Sync the records of this iteration and compact a file, which is half full:  */
+    if (p_Records == 0) return true;
+    if (ub_Sync == JOURNAL_SYNC_BATCH) Sync();
+    if (i_Next >= i_Records / 2) return Compact();
+    return true;
+}
+
+int CJournal::Pending(unsigned int uiPin, unsigned char ubGesture) {
+    if ((uiPin >= JOURNAL_PINS) || (ubGesture >= JOURNAL_GESTURES)) return 0;
+    return i_Pending[uiPin][ubGesture];
+}
+
+/** Private Functions: **************************************************************/
+
+void CJournal::Append(unsigned char ubType, unsigned int uiPin, unsigned char ubGesture, unsigned long ulId,
+                      int iValue, int iPresses) {
+    /** Variables:                                                                  */
+    SJournalRecord* pRecord;
+    struct timespec Now;
+    /** A full file is compacted right away, which should hardly ever happen:       */
+    if ((i_Next >= i_Records) && (! Compact())) return;
+    if (i_Next >= i_Records) return;
+    clock_gettime(CLOCK_REALTIME, &Now);
+    pRecord = &p_Records[i_Next++];
+    pRecord->ui_Seq        = ui_Seq++;
+    pRecord->ub_Type       = ubType;
+    pRecord->ub_Gesture    = ubGesture;
+    pRecord->uw_Pin        = uiPin;
+    pRecord->ull_Timestamp = (unsigned long long) Now.tv_sec * 1000000000ULL + Now.tv_nsec;
+    pRecord->ui_Id         = ulId;
+    pRecord->i_Value       = iValue;
+    pRecord->i_Presses     = iPresses;
+    pRecord->ui_Check      = Checksum(pRecord);
+    if (ub_Sync == JOURNAL_SYNC_ALWAYS) Sync();
+}
+
+void CJournal::Load() {
+    /** Variables:                                                                  */
+    SJournalRecord Records[128];
+    SJournalRecord* pRecord;
+    int            i, n, iFd, *pPending;
+    bool           bFirst = true;
+    /** A missing file has nothing to replay:                                       */
+    iFd = open(s_File, O_RDONLY | O_CLOEXEC);
+    if (iFd < 0) return;
+    /** Sum up the records up to the first torn or stale one:                       */
+    while ((n = read(iFd, Records, sizeof(Records)) / sizeof(SJournalRecord)) > 0) {
+        for (i=0; i<n; i++) {
+            pRecord = &Records[i];
+            if ((pRecord->ui_Check != Checksum(pRecord)) || ((! bFirst) && (pRecord->ui_Seq != ui_Seq))) {
+                close(iFd);
+                return;
+            }
+            bFirst = false;
+            ui_Seq = pRecord->ui_Seq + 1;
+            if ((pRecord->uw_Pin >= JOURNAL_PINS) || (pRecord->ub_Gesture >= JOURNAL_GESTURES)) continue;
+            pPending = &i_Pending[pRecord->uw_Pin][pRecord->ub_Gesture];
+            if (pRecord->ub_Type == JOURNAL_PRESS) *pPending += pRecord->i_Presses;
+            else                                   *pPending -= (pRecord->i_Presses < *pPending) ? pRecord->i_Presses : *pPending;
+        }
+    }
+    close(iFd);
+}
+
+bool CJournal::Compact() {
+    /** Variables:                                                                  */
+    char            sTemp[1024 + 4];
+    char            sDirectory[1024];
+    SJournalRecord* pRecords;
+    int             iFd, iDirFd, iNext;
+    unsigned int    uiPin, uiGesture;
+    char*           p;
+    size_t          uSize;
+    /** Write the pending presses into a fresh file, a record per pin and gesture:  */
+    uSize = i_Records * sizeof(SJournalRecord);
+    snprintf(sTemp, sizeof(sTemp), "%s.tmp", s_File);
+    iFd = open(sTemp, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (iFd < 0) return false;
+    if (ftruncate(iFd, uSize) != 0) {
+        close(iFd);
+        return false;
+    }
+    pRecords = (SJournalRecord*) mmap(0, uSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, iFd, 0);
+    if (pRecords == MAP_FAILED) {
+        close(iFd);
+        return false;
+    }
+    iNext = 0;
+    for (uiPin=0; uiPin<JOURNAL_PINS; uiPin++) {
+        for (uiGesture=0; uiGesture<JOURNAL_GESTURES; uiGesture++) {
+            if (i_Pending[uiPin][uiGesture] < 1) continue;
+            pRecords[iNext].ui_Seq        = ui_Seq++;
+            pRecords[iNext].ub_Type       = JOURNAL_PRESS;
+            pRecords[iNext].ub_Gesture    = uiGesture;
+            pRecords[iNext].uw_Pin        = uiPin;
+            pRecords[iNext].ull_Timestamp = 0;
+            pRecords[iNext].ui_Id         = 0;
+            pRecords[iNext].i_Value       = 0;
+            pRecords[iNext].i_Presses     = i_Pending[uiPin][uiGesture];
+            pRecords[iNext].ui_Check      = Checksum(&pRecords[iNext]);
+            iNext++;
+        }
+    }
+    /** The new file replaces the old one only, once it is complete on the disk:    */
+    if ((msync(pRecords, uSize, MS_SYNC) != 0) || (rename(sTemp, s_File) != 0)) {
+        munmap(pRecords, uSize);
+        close(iFd);
+        unlink(sTemp);
+        return false;
+    }
+    strcpy(sDirectory, s_File);
+    p = strrchr(sDirectory, '/');
+    if (p == 0)                strcpy(sDirectory, ".");
+    else if (p == sDirectory)  strcpy(sDirectory, "/");
+    else                       *p = 0;
+    iDirFd = open(sDirectory, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (iDirFd >= 0) {
+        fsync(iDirFd);
+        close(iDirFd);
+    }
+    /** Continue appending to the new file:                                         */
+    if (p_Records != 0) {
+        munmap(p_Records, uSize);
+        close(i_Fd);
+    }
+    p_Records = pRecords;
+    i_Fd      = iFd;
+    i_Next    = iNext;
+    i_Synced  = iNext;
+    return true;
+}
+
+void CJournal::Sync() {
+    /** Variables:                                                                  */
+    size_t uStart, uEnd, uPage;
+    /** Sync the pages of all records, which were appended since the last sync:     */
+    if (i_Synced >= i_Next) return;
+    uPage  = sysconf(_SC_PAGESIZE);
+    uStart = (i_Synced * sizeof(SJournalRecord)) & ~(uPage - 1);
+    uEnd   = i_Next * sizeof(SJournalRecord);
+    msync((char*) p_Records + uStart, uEnd - uStart, MS_SYNC);
+    i_Synced = i_Next;
+}
+
+unsigned int CJournal::Checksum(const SJournalRecord* pRecord) {
+    /** Variables:                                                                  */
+    const unsigned char* p = (const unsigned char*) pRecord;
+    unsigned int         uiHash = 2166136261U;
+    size_t               i;
+    /** FNV-1a over all fields but the checksum, which never matches zeros:         */
+    for (i=0; i<offsetof(SJournalRecord, ui_Check); i++) uiHash = (uiHash ^ p[i]) * 16777619U;
+    return uiHash;
+}
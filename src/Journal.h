@@ -0,0 +1,102 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+
+/** Notes: *************************************************************************** 
+
+Crash-safe journal of the presses and the finished jobs. The file is an array of
+fixed-size records, which is mapped into memory, so appending a record is a plain
+copy into the page-cache. Each record carries a sequence-number and a checksum, so
+reading it back stops at the first torn or stale record. The records are made
+durable according to the sync-policy:
+
+  none     the kernel writes them back, which survives a crash of the daemon only
+  batch    all records of an iteration of the main-loop are synced at its end
+  always   each record is synced, before the daemon goes on
+
+The journal keeps the number of pending presses per pin and gesture, i.e. accepted
+presses, which were neither finished nor dropped. Opening a journal reads them back,
+so the daemon can replay them. The file is compacted into a fresh one with nothing
+but the pending presses, whenever it is half full, so it never grows.
+
+*************************************************************************************/
+
+/** Global Includes: ****************************************************************/
+
+/** Local Defines: ******************************************************************/
+
+#define JOURNAL_SYNC_NONE   1
+#define JOURNAL_SYNC_BATCH  2
+#define JOURNAL_SYNC_ALWAYS 3
+
+#define JOURNAL_PRESS    1
+#define JOURNAL_FINISH   2
+#define JOURNAL_DROP     3
+
+#define JOURNAL_PINS     64
+#define JOURNAL_GESTURES 4                      // Same as GESTURE_COUNT.
+
+/** Type-Definitions: ***************************************************************/
+
+struct SJournalRecord {
+    unsigned int       ui_Seq;
+    unsigned char      ub_Type;
+    unsigned char      ub_Gesture;
+    unsigned short     uw_Pin;
+    unsigned long long ull_Timestamp;           // CLOCK_REALTIME in ns.
+    unsigned int       ui_Id;                   // Job-id of a finished job.
+    int                i_Value;                 // Exit-code or number of dropped presses.
+    int                i_Presses;               // Presses of a finished job.
+    unsigned int       ui_Check;                // Checksum of all fields above.
+};
+
+/** Class Definition: ***************************************************************/
+
+class CJournal {
+public:
+    // Methods:
+    CJournal();
+    ~CJournal();
+    bool Open      (const char* sFile, int iRecords, unsigned char ubSync, bool bReplay);
+    void Close     ();
+    bool IsOpen    () { return (p_Records != 0); };
+    void Press     (unsigned int uiPin, unsigned char ubGesture, int iPresses);
+    void Finish    (unsigned int uiPin, unsigned char ubGesture, unsigned long ulId, int iPresses, int iExitCode);
+    void Drop      (unsigned int uiPin, unsigned char ubGesture, int iPresses);
+    bool Service   ();
+    int  Pending   (unsigned int uiPin, unsigned char ubGesture);
+private:
+    // Properties:
+    char               s_File[1024];
+    int                i_Fd;
+    SJournalRecord*    p_Records;
+    int                i_Records;
+    int                i_Next;
+    int                i_Synced;                // First record, which is not synced yet.
+    unsigned int       ui_Seq;
+    unsigned char      ub_Sync;
+    int                i_Pending[JOURNAL_PINS][JOURNAL_GESTURES];
+    // Methods:
+    void Append    (unsigned char ubType, unsigned int uiPin, unsigned char ubGesture, unsigned long ulId,
+                    int iValue, int iPresses);
+    void Load      ();
+    bool Compact   ();
+    void Sync      ();
+    static unsigned int Checksum(const SJournalRecord* pRecord);
+};
@@ -0,0 +1,207 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/** Global Includes: ****************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "GpioBackend.h"
+#include "LedSequencer.h"
+
+/** Public Functions: ***************************************************************/
+
+CLedSequencer::CLedSequencer() {
+    p_Gpio       = 0;
+    i_Leds       = 0;
+    i_Brightness = 100;
+    memset(Leds, 0, sizeof(Leds));
+}
+
+CLedSequencer::~CLedSequencer() {
+
+}
+
+void CLedSequencer::Attach(CGpioBackend* pGpio, int nLeds) {
+    /** Variables:                                                                  */
+    int i;
+    /** The LEDs of a new backend show nothing, until they get their patterns:      */
+    p_Gpio = pGpio;
+    i_Leds = (nLeds < LED_MAX_LEDS) ? nLeds : LED_MAX_LEDS;
+    memset(Leds, 0, sizeof(Leds));
+    for (i=0; i<i_Leds; i++) {
+        Leds[i].i_Level = -1;
+        Leds[i].b_Dim   = p_Gpio->CanDim(i);
+    }
+}
+
+void CLedSequencer::SetBrightness(int iBrightness) {
+    /** Variables:                                                                  */
+    int i, iLevel;
+    /** Rewrite the LEDs, which can be dimmed, with their current level:            */
+    if (iBrightness == i_Brightness) return;
+    i_Brightness = iBrightness;
+    for (i=0; i<i_Leds; i++) {
+        if ((! Leds[i].b_Dim) || (Leds[i].i_Level < 0)) continue;
+        iLevel          = Leds[i].i_Level;
+        Leds[i].i_Level = -1;
+        Write(i, iLevel);
+    }
+}
+
+bool CLedSequencer::Play(int iLed, const SLedPattern* pPattern, unsigned long long ullNow) {
+    /** Variables:                                                                  */
+    SLedState* pLed;
+    /** The pattern, which is already playing, keeps its rhythm:                    */
+    if ((iLed < 0) || (iLed >= i_Leds) || (pPattern->i_Steps < 1)) return false;
+    pLed = &Leds[iLed];
+    if ((pLed->Pattern.i_Steps == pPattern->i_Steps) &&
+        (memcmp(pLed->Pattern.Steps, pPattern->Steps, pPattern->i_Steps * sizeof(SLedStep)) == 0)) return false;
+    pLed->Pattern = *pPattern;
+    Enter(iLed, 0, ullNow);
+    return true;
+}
+
+void CLedSequencer::Advance(unsigned long long ullNow) {
+    /** Variables:                                                                  */
+    SLedState*         pLed;
+    const SLedStep*    pStep;
+    unsigned long long ullEnd;
+    int                i, iLevel;
+    /** Perform all transitions, which are due:                                     */
+    for (i=0; i<i_Leds; i++) {
+        pLed = &Leds[i];
+        while ((pLed->ull_Next != 0) && (ullNow >= pLed->ull_Next)) {
+            pStep  = &pLed->Pattern.Steps[pLed->i_Step];
+            ullEnd = pLed->ull_Start + pStep->ui_Duration * 1000000ULL;
+            /** A fade continues in small steps until its end:                      */
+            if (ullNow < ullEnd) {
+                iLevel = pLed->i_From + ((int) pStep->ub_Level - pLed->i_From) *
+                         (long long) (ullNow - pLed->ull_Start) / (long long) (ullEnd - pLed->ull_Start);
+                Write(i, iLevel);
+                pLed->ull_Next = (ullNow + LED_FADE_NS < ullEnd) ? ullNow + LED_FADE_NS : ullEnd;
+                continue;
+            }
+            /** The next step starts at the end of this one, unless it was missed:  */
+            Enter(i, (pLed->i_Step + 1) % pLed->Pattern.i_Steps, (ullNow - ullEnd < LED_FADE_NS) ? ullEnd : ullNow);
+        }
+    }
+}
+
+unsigned long long CLedSequencer::NextDeadline() {
+    /** Variables:                                                                  */
+    unsigned long long ullNext = 0;
+    int                i;
+    /** Find the earliest transition of all LEDs:                                   */
+    for (i=0; i<i_Leds; i++) {
+        if ((Leds[i].ull_Next != 0) && ((ullNext == 0) || (Leds[i].ull_Next < ullNext))) ullNext = Leds[i].ull_Next;
+    }
+    return ullNext;
+}
+
+bool CLedSequencer::Parse(const char* sPattern, SLedPattern* pPattern) {
+    /** Variables:                                                                  */
+    char          sSteps[256];
+    const char*   p;
+    char*         pEnd;
+    long          lLevel, lDuration;
+    bool          bFade;
+    int           i, n;
+    /** Expand the named patterns into their steps:                                 */
+    while ((*sPattern == ' ') || (*sPattern == '\t')) sPattern++;
+    if      (strcmp(sPattern, "on"       ) == 0) sPattern = "100:0";
+    else if (strcmp(sPattern, "off"      ) == 0) sPattern = "0:0";
+    else if (strcmp(sPattern, "blink"    ) == 0) sPattern = "100:500,0:500";
+    else if (strcmp(sPattern, "alive"    ) == 0) sPattern = "100:500,0:500";
+    else if (strcmp(sPattern, "fast"     ) == 0) sPattern = "100:100,0:100";
+    else if (strcmp(sPattern, "heartbeat") == 0) sPattern = "100:80,0:120,100:80,0:720";
+    else if (strcmp(sPattern, "breathe"  ) == 0) sPattern = "100~1500,0~1500";
+    else if ((strncmp(sPattern, "error", 5) == 0) && (sPattern[5] >= '1') && (sPattern[5] <= '9') && (sPattern[6] == 0)) {
+        n = sPattern[5] - '0';
+        sSteps[0] = 0;
+        for (i=1; i<n; i++) strcat(sSteps, "100:200,0:300,");
+        strcat(sSteps, "100:200,0:1500");
+        sPattern = sSteps;
+    }
+    /** Parse the steps:                                                            */
+    pPattern->i_Steps = 0;
+    p = sPattern;
+    while (*p != 0) {
+        lLevel = strtol(p, &pEnd, 10);
+        if ((pEnd == p) || ((*pEnd != ':') && (*pEnd != '~'))) return false;
+        bFade = (*pEnd == '~');
+        p = pEnd + 1;
+        lDuration = strtol(p, &pEnd, 10);
+        if ((pEnd == p) || (lLevel < 0) || (lLevel > 100) || (lDuration < 0) || (lDuration > 3600000)) return false;
+        if (pPattern->i_Steps >= LED_MAX_STEPS) return false;
+        pPattern->Steps[pPattern->i_Steps].ub_Level    = lLevel;
+        pPattern->Steps[pPattern->i_Steps].b_Fade      = bFade;
+        pPattern->Steps[pPattern->i_Steps].ui_Duration = lDuration;
+        pPattern->i_Steps++;
+        p = pEnd;
+        while ((*p == ' ') || (*p == '\t')) p++;
+        if (*p == ',') p++;
+        while ((*p == ' ') || (*p == '\t')) p++;
+    }
+    /** A pattern, which repeats, has to take some time:                            */
+    if (pPattern->i_Steps < 1) return false;
+    for (i=0, lDuration=0; i<pPattern->i_Steps; i++) lDuration += pPattern->Steps[i].ui_Duration;
+    return (pPattern->i_Steps == 1) || (lDuration > 0);
+}
+
+/** Private Functions: **************************************************************/
+
+void CLedSequencer::Enter(int iLed, int iStep, unsigned long long ullStart) {
+    /** Variables:                                                                  */
+    SLedState*      pLed;
+    const SLedStep* pStep;
+    pLed  = &Leds[iLed];
+    pStep = &pLed->Pattern.Steps[iStep];
+    pLed->i_Step    = iStep;
+    pLed->ull_Start = ullStart;
+    pLed->i_From    = (pLed->i_Level >= 0) ? pLed->i_Level : 0;
+    /** A single step is kept for ever, a fade is written in small steps:           */
+    if (pLed->Pattern.i_Steps == 1) {
+        Write(iLed, pStep->ub_Level);
+        pLed->ull_Next = 0;
+    }else if ((pStep->b_Fade) && (pLed->b_Dim) && (pStep->ui_Duration > 0)) {
+        pLed->ull_Next = ullStart + ((pStep->ui_Duration * 1000000ULL < LED_FADE_NS) ?
+                                     pStep->ui_Duration * 1000000ULL : LED_FADE_NS);
+    }else{
+        Write(iLed, pStep->ub_Level);
+        pLed->ull_Next = ullStart + pStep->ui_Duration * 1000000ULL;
+    }
+}
+
+void CLedSequencer::Write(int iLed, int iLevel) {
+    /** Variables:                                                                  */
+    SLedState* pLed;
+    int        iScaled;
+    pLed = &Leds[iLed];
+    /** An LED, which cannot be dimmed, only changes at half the level:             */
+    if (! pLed->b_Dim) iLevel = (iLevel >= 50) ? 100 : 0;
+    if (iLevel == pLed->i_Level) return;
+    pLed->i_Level = iLevel;
+    /** Full levels are switched, all others are dimmed:                            */
+    iScaled = iLevel * i_Brightness / 100;
+    if      (! pLed->b_Dim)                      p_Gpio->WriteLed(iLed, iLevel == 100);
+    else if ((iScaled == 0) || (iScaled == 100)) p_Gpio->WriteLed(iLed, iScaled == 100);
+    else                                         p_Gpio->DimLed  (iLed, iScaled);
+}
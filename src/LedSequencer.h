@@ -0,0 +1,92 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+
+/** Notes: *************************************************************************** 
+
+Sequencer of the LEDs. Each LED plays a pattern, which is a list of timed steps:
+
+  <level>:<ms>   switch to the level (0-100 %) and keep it for the time
+  <level>~<ms>   fade from the previous level to this one within the time
+
+The steps are separated by commas and the pattern repeats, unless it has a single
+step. Instead of the steps, one of the named patterns may be given: on, off, blink,
+alive, fast, heartbeat, breathe or error<n> (n = 1..9 blinks and a pause). The LEDs
+are only written on a transition and the main-loop only wakes up at the time
+returned by NextDeadline(). Fades and brightness need an LED, which the backend
+can dim, all others are switched at half the level and fade in one step.
+
+*************************************************************************************/
+
+/** Global Includes: ****************************************************************/
+
+/** Local Defines: ******************************************************************/
+
+#define LED_MAX_STEPS    32
+#define LED_MAX_LEDS     32
+#define LED_FADE_NS      20000000ULL            // Interval of the fading-steps.
+
+/** Type-Definitions: ***************************************************************/
+
+struct SLedStep {
+    unsigned char      ub_Level;                // Brightness in %.
+    bool               b_Fade;                  // Ramp from the previous level.
+    unsigned int       ui_Duration;             // In ms.
+};
+
+struct SLedPattern {
+    int                i_Steps;
+    SLedStep           Steps[LED_MAX_STEPS];
+};
+
+struct SLedState {
+    SLedPattern        Pattern;
+    int                i_Step;
+    int                i_From;                  // Level at the start of a fade.
+    int                i_Level;                 // Level last written or -1.
+    bool               b_Dim;
+    unsigned long long ull_Start;               // Start of the step.
+    unsigned long long ull_Next;                // Next transition or 0.
+};
+
+/** Class Definition: ***************************************************************/
+
+class CGpioBackend;
+
+class CLedSequencer {
+public:
+    // Methods:
+    CLedSequencer();
+    ~CLedSequencer();
+    void Attach    (CGpioBackend* pGpio, int nLeds);
+    void SetBrightness(int iBrightness);
+    bool Play      (int iLed, const SLedPattern* pPattern, unsigned long long ullNow);
+    void Advance   (unsigned long long ullNow);
+    unsigned long long NextDeadline();
+    static bool Parse(const char* sPattern, SLedPattern* pPattern);
+private:
+    // Properties:
+    CGpioBackend*      p_Gpio;
+    int                i_Leds;
+    int                i_Brightness;
+    SLedState          Leds[LED_MAX_LEDS];
+    // Methods:
+    void Enter     (int iLed, int iStep, unsigned long long ullStart);
+    void Write     (int iLed, int iLevel);
+};
@@ -0,0 +1,137 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+
+/** Global Includes: ****************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Metrics.h"
+
+/** Local Variables: ****************************************************************/
+
+static const char* CounterNames[MET_COUNTERS] = {
+    "presses", "bounces", "overruns", "jobs_started", "jobs_failed",
+    "presses_dropped", "presses_coalesced", "commands", "wakeups", "idle_wakeups",
+    "jobs_timed_out", "jobs_killed", "net_sent", "net_received", "net_lost", "net_rejected"
+};
+
+static const char* GaugeNames[MET_GAUGES] = {
+    "jobs_queued", "jobs_running", "startup_us", "presses_held"
+};
+
+static const char* HistogramNames[MET_HISTOGRAMS] = {
+    "press_to_spawn", "queue_wait", "run_duration", "command", "loop_iteration", "net_delay"
+};
+
+/** Public Functions: ***************************************************************/
+
+CMetrics::CMetrics() {
+    int i, j;
+    for (i=0; i<MET_COUNTERS; i++) Counters[i].store(0);
+    for (i=0; i<MET_GAUGES;   i++) Gauges[i].store(0);
+    for (i=0; i<MET_HISTOGRAMS; i++) {
+        for (j=0; j<=HIST_BUCKETS; j++) Histograms[i].Buckets[j].store(0);
+        Histograms[i].ul_Count.store(0);
+        Histograms[i].ull_SumNs.store(0);
+    }
+}
+
+int CMetrics::Summary(char* sReply, int iSize) {
+    /** Variables:                                                                  */
+    int i, n = 0;
+    /** Put all values into one line, the latencies as p50/p99 in us:               */
+    for (i=0; (i<MET_COUNTERS) && (n<iSize); i++) {
+        n += snprintf(&sReply[n], iSize - n, "%s=%lu ", CounterNames[i],
+                      Counters[i].load(std::memory_order_relaxed));
+    }
+    for (i=0; (i<MET_GAUGES) && (n<iSize); i++) {
+        n += snprintf(&sReply[n], iSize - n, "%s=%li ", GaugeNames[i],
+                      Gauges[i].load(std::memory_order_relaxed));
+    }
+    for (i=0; (i<MET_HISTOGRAMS) && (n<iSize); i++) {
+        n += snprintf(&sReply[n], iSize - n, "%s_us=%llu/%llu ", HistogramNames[i],
+                      Percentile(i, 50), Percentile(i, 99));
+    }
+    if (n > iSize - 1) n = iSize - 1;
+    if ((n > 0) && (sReply[n-1] == ' ')) n--;
+    sReply[n] = 0;
+    return n;
+}
+
+bool CMetrics::WriteFile(const char* sFileName) {
+    /** Variables:                                                                  */
+    char               sTemp[1100];
+    FILE               *fp;
+    int                i, j;
+    unsigned long      ulCumulated;
+    unsigned long long ullBound;
+    /** Write into a temporary file, which then replaces the old one at once:       */
+    if (snprintf(sTemp, sizeof(sTemp), "%s.tmp", sFileName) >= (int) sizeof(sTemp)) return false;
+    fp = fopen(sTemp, "w");
+    if (fp == 0) return false;
+    for (i=0; i<MET_COUNTERS; i++) {
+        fprintf(fp, "# TYPE buzzerd_%s_total counter\nbuzzerd_%s_total %lu\n", CounterNames[i],
+                CounterNames[i], Counters[i].load(std::memory_order_relaxed));
+    }
+    for (i=0; i<MET_GAUGES; i++) {
+        fprintf(fp, "# TYPE buzzerd_%s gauge\nbuzzerd_%s %li\n", GaugeNames[i],
+                GaugeNames[i], Gauges[i].load(std::memory_order_relaxed));
+    }
+    for (i=0; i<MET_HISTOGRAMS; i++) {
+        fprintf(fp, "# TYPE buzzerd_%s_seconds histogram\n", HistogramNames[i]);
+        ulCumulated = 0;
+        for (j=0; j<HIST_BUCKETS; j++) {
+            ullBound     = 1ULL << j;
+            ulCumulated += Histograms[i].Buckets[j].load(std::memory_order_relaxed);
+            fprintf(fp, "buzzerd_%s_seconds_bucket{le=\"%llu.%06llu\"} %lu\n", HistogramNames[i],
+                    ullBound / 1000000ULL, ullBound % 1000000ULL, ulCumulated);
+        }
+        fprintf(fp, "buzzerd_%s_seconds_bucket{le=\"+Inf\"} %lu\n", HistogramNames[i],
+                Histograms[i].ul_Count.load(std::memory_order_relaxed));
+        fprintf(fp, "buzzerd_%s_seconds_sum %.9f\n", HistogramNames[i],
+                Histograms[i].ull_SumNs.load(std::memory_order_relaxed) / 1e9);
+        fprintf(fp, "buzzerd_%s_seconds_count %lu\n", HistogramNames[i],
+                Histograms[i].ul_Count.load(std::memory_order_relaxed));
+    }
+    if (fclose(fp) != 0) {
+        unlink(sTemp);
+        return false;
+    }
+    return (rename(sTemp, sFileName) == 0);
+}
+
+/** Private Functions: **************************************************************/
+
+unsigned long long CMetrics::Percentile(int iHistogram, int iPercent) {
+    /** Variables:                                                                  */
+    unsigned long ulCount, ulRank, ulCumulated = 0;
+    int           i;
+    /** Report the upper bound of the bucket, which contains the percentile:        */
+    ulCount = Histograms[iHistogram].ul_Count.load(std::memory_order_relaxed);
+    if (ulCount == 0) return 0;
+    ulRank = (ulCount * iPercent + 99) / 100;
+    for (i=0; i<HIST_BUCKETS; i++) {
+        ulCumulated += Histograms[iHistogram].Buckets[i].load(std::memory_order_relaxed);
+        if (ulCumulated >= ulRank) return 1ULL << i;
+    }
+    return 1ULL << HIST_BUCKETS;
+}
@@ -0,0 +1,123 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+
+/** Notes: *************************************************************************** 
+
+Counters, gauges and histograms of the daemon. All of them are fixed-size arrays of
+atomics, which are updated with relaxed operations only, so recording a value on the
+hot path neither locks nor allocates. The histograms use power-of-two buckets in us:
+bucket i counts the values up to 2^i us, the last one all larger values.
+
+*************************************************************************************/
+
+/** Global Includes: ****************************************************************/
+
+#include <atomic>
+
+/** Local Defines: ******************************************************************/
+
+#define MET_PRESSES      0                      // Accepted presses.
+#define MET_BOUNCES      1                      // Debounce-rejects.
+#define MET_OVERRUNS     2                      // Presses lost in the input-ring.
+#define MET_STARTED      3                      // Started jobs.
+#define MET_FAILED       4                      // Finished jobs with exit-code != 0.
+#define MET_DROPPED      5                      // Presses dropped by the job-queue.
+#define MET_COALESCED    6                      // Presses coalesced by the job-queue.
+#define MET_COMMANDS     7                      // Client-events handled.
+#define MET_WAKEUPS      8                      // Wake-ups of the main-loop.
+#define MET_IDLE_WAKEUPS 9                      // Wake-ups for timers only.
+#define MET_TIMEOUTS     10                     // Jobs terminated after their timeout.
+#define MET_KILLED       11                     // Jobs killed after SIGTERM or by a limit.
+#define MET_NET_SENT     12                     // Records sent to the peers.
+#define MET_NET_RECEIVED 13                     // Records accepted from the peers.
+#define MET_NET_LOST     14                     // Packets of the peers missing in their seq.
+#define MET_NET_REJECTED 15                     // Packets malformed, forged or replayed.
+#define MET_COUNTERS     16
+
+#define GAUGE_QUEUED     0                      // Jobs waiting in the queue.
+#define GAUGE_RUNNING    1                      // Jobs running right now.
+#define GAUGE_STARTUP    2                      // us from the start until being ready.
+#define GAUGE_HELD       3                      // Presses held back by a full queue.
+#define MET_GAUGES       4
+
+#define HIST_SPAWN       0                      // Press until the job was spawned.
+#define HIST_WAIT        1                      // Press until the job was started.
+#define HIST_RUN         2                      // Start until the job finished.
+#define HIST_COMMAND     3                      // Handling of a client-event.
+#define HIST_LOOP        4                      // One iteration of the main-loop.
+#define HIST_NET         5                      // Press on a peer until it arrived here.
+#define MET_HISTOGRAMS   6
+
+#define HIST_BUCKETS     25                     // Up to 2^24 us (16.8 s) and above.
+
+/** Type-Definitions: ***************************************************************/
+
+struct SHistogram {
+    std::atomic<unsigned long>      Buckets[HIST_BUCKETS + 1];
+    std::atomic<unsigned long>      ul_Count;
+    std::atomic<unsigned long long> ull_SumNs;
+};
+
+/** Class Definition: ***************************************************************/
+
+class CMetrics {
+public:
+    // Methods:
+    CMetrics();
+    
+    void Count(int iCounter, unsigned long ulAmount = 1) {
+        Counters[iCounter].fetch_add(ulAmount, std::memory_order_relaxed);
+    };
+    
+    void Set(int iCounter, unsigned long ulValue) {
+        Counters[iCounter].store(ulValue, std::memory_order_relaxed);
+    };
+    
+    unsigned long Get(int iCounter) {
+        return Counters[iCounter].load(std::memory_order_relaxed);
+    };
+    
+    void Gauge(int iGauge, long lValue) {
+        Gauges[iGauge].store(lValue, std::memory_order_relaxed);
+    };
+    
+    void Record(int iHistogram, unsigned long long ullNs) {
+        unsigned long long ullUs = ullNs / 1000ULL;
+        int                iBucket;
+        /** A negative difference of two timestamps counts as zero:                 */
+        if ((long long) ullNs < 0) ullNs = ullUs = 0;
+        /** The bucket is the number of bits needed for the value in us:            */
+        iBucket = (ullUs <= 1) ? 0 : 64 - __builtin_clzll(ullUs - 1);
+        if (iBucket > HIST_BUCKETS) iBucket = HIST_BUCKETS;
+        Histograms[iHistogram].Buckets[iBucket].fetch_add(1, std::memory_order_relaxed);
+        Histograms[iHistogram].ul_Count.fetch_add(1, std::memory_order_relaxed);
+        Histograms[iHistogram].ull_SumNs.fetch_add(ullNs, std::memory_order_relaxed);
+    };
+    
+    int  Summary   (char* sReply, int iSize);
+    bool WriteFile (const char* sFileName);
+private:
+    // Properties:
+    std::atomic<unsigned long> Counters[MET_COUNTERS];
+    std::atomic<long>          Gauges  [MET_GAUGES];
+    SHistogram                 Histograms[MET_HISTOGRAMS];
+    // Methods:
+    unsigned long long Percentile(int iHistogram, int iPercent);
+};
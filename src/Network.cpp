@@ -0,0 +1,584 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/** Global Includes: ****************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <syslog.h>
+#include <netdb.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/random.h>
+
+#include "ConfigHandler.h"
+#include "Network.h"
+
+/** Local Defines: ******************************************************************/
+
+#define NET_RX_BATCH     8                      // Datagrams per recvmmsg().
+
+/** Local Functions: ****************************************************************/
+
+static unsigned long long Now(clockid_t Clock) {
+    struct timespec Time;
+    clock_gettime(Clock, &Time);
+    return (unsigned long long) Time.tv_sec * 1000000000ULL + Time.tv_nsec;
+}
+
+static void Put(unsigned char* pData, unsigned long long ullValue, int iBytes) {
+    for (int i=iBytes-1; i>=0; i--, ullValue >>= 8) pData[i] = (unsigned char) ullValue;
+}
+
+static unsigned long long Get(const unsigned char* pData, int iBytes) {
+    unsigned long long ullValue = 0;
+    for (int i=0; i<iBytes; i++) ullValue = (ullValue << 8) | pData[i];
+    return ullValue;
+}
+
+static bool Resolve(const char* sAddress, int iType, struct sockaddr_in* pAddress) {
+    /** Variables:                                                                  */
+    char            sHost[256];
+    const char*     sPort;
+    struct addrinfo Hints, *pResult;
+    /** Split <host>:<port>, a port alone means any address:                        */
+    sPort = strrchr(sAddress, ':');
+    if (sPort == 0) {
+        sHost[0] = 0;
+        sPort    = sAddress;
+    }else{
+        if (sPort - sAddress >= (int) sizeof(sHost)) return false;
+        memcpy(sHost, sAddress, sPort - sAddress);
+        sHost[sPort - sAddress] = 0;
+        sPort++;
+    }
+    memset(&Hints, 0, sizeof(Hints));
+    Hints.ai_family   = AF_INET;
+    Hints.ai_socktype = iType;
+    Hints.ai_flags    = AI_PASSIVE | AI_NUMERICSERV;
+    if (getaddrinfo((sHost[0] != 0) ? sHost : 0, sPort, &Hints, &pResult) != 0) return false;
+    memcpy(pAddress, pResult->ai_addr, sizeof(*pAddress));
+    freeaddrinfo(pResult);
+    return true;
+}
+
+static unsigned long long Rotate(unsigned long long ullValue, int iBits) {
+    return (ullValue << iBits) | (ullValue >> (64 - iBits));
+}
+
+static void SipRound(unsigned long long* v) {
+    v[0] += v[1]; v[1] = Rotate(v[1], 13); v[1] ^= v[0]; v[0] = Rotate(v[0], 32);
+    v[2] += v[3]; v[3] = Rotate(v[3], 16); v[3] ^= v[2];
+    v[0] += v[3]; v[3] = Rotate(v[3], 21); v[3] ^= v[0];
+    v[2] += v[1]; v[1] = Rotate(v[1], 17); v[1] ^= v[2]; v[2] = Rotate(v[2], 32);
+}
+
+static unsigned long long SipHash(const unsigned long long* pKey, const unsigned char* pData, int iLen) {
+    /** Variables:                                                                  */
+    unsigned long long v[4], m;
+    int                i, j, iBlocks = iLen / 8;
+    v[0] = pKey[0] ^ 0x736f6d6570736575ULL;
+    v[1] = pKey[1] ^ 0x646f72616e646f6dULL;
+    v[2] = pKey[0] ^ 0x6c7967656e657261ULL;
+    v[3] = pKey[1] ^ 0x7465646279746573ULL;
+    /** Two rounds per little-endian word, the last one padded with the length:     */
+    for (i=0; i<=iBlocks; i++) {
+        m = (i < iBlocks) ? 0 : (unsigned long long) (iLen & 0xFF) << 56;
+        for (j=0; j<((i < iBlocks) ? 8 : iLen % 8); j++) m |= (unsigned long long) pData[i*8+j] << (8*j);
+        v[3] ^= m;
+        SipRound(v);
+        SipRound(v);
+        v[0] ^= m;
+    }
+    /** Four rounds of finalization:                                                */
+    v[2] ^= 0xFF;
+    for (i=0; i<4; i++) SipRound(v);
+    return v[0] ^ v[1] ^ v[2] ^ v[3];
+}
+
+/** Public Functions: ***************************************************************/
+
+CNetwork::CNetwork() {
+    int i;
+    ul_Sent     = 0;
+    ul_Received = 0;
+    ul_Lost     = 0;
+    ul_Rejected = 0;
+    i_EpollFd   = -1;
+    ui_EpollTag = 0;
+    i_UdpFd     = -1;
+    i_TcpFd     = -1;
+    b_Key       = false;
+    ull_Key[0]  = ull_Key[1] = 0;
+    ui_Node     = 0;
+    ull_Boot    = 0;
+    ui_Seq      = 0;
+    i_Peers     = 0;
+    i_Nodes     = 0;
+    i_Records   = 0;
+    for (i=0; i<NET_MAX_INCOMING; i++) Incoming[i].i_Fd = -1;
+}
+
+CNetwork::~CNetwork() {
+    Close();
+}
+
+bool CNetwork::Open(const SConfig* pConfig, int iEpollFd, unsigned int uiTag) {
+    /** Variables:                                                                  */
+    int                i, iOn = 1;
+    struct sockaddr_in Listen;
+    struct ip_mreq     Group;
+    SNetPeer*          pPeer;
+    Close();
+    i_EpollFd   = iEpollFd;
+    ui_EpollTag = uiTag;
+    if ((pConfig->s_NetListen[0] == 0) && (pConfig->i_Peers == 0)) return true;
+    /** Node, boot and seq survive a reload, so the peers accept the packets:       */
+    if (ull_Boot == 0) ull_Boot = Now(CLOCK_REALTIME);
+    if (pConfig->ui_NetNode != 0) ui_Node = pConfig->ui_NetNode;
+    while (ui_Node == 0) {
+        if (getrandom(&ui_Node, sizeof(ui_Node), 0) != sizeof(ui_Node)) ui_Node = (unsigned int) (ull_Boot ^ getpid());
+    }
+    /** The key is read like the one of the reference-implementation of SipHash:    */
+    b_Key = pConfig->b_NetKey;
+    ull_Key[0] = ull_Key[1] = 0;
+    for (i=0; i<16; i++) ull_Key[i/8] |= (unsigned long long) pConfig->ub_NetKey[i] << (8*(i%8));
+    /** All datagrams are sent and received via a single socket:                    */
+    i_UdpFd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (i_UdpFd < 0) {
+        syslog(LOG_ERR | LOG_DAEMON, "FAILURE CREATING THE NETWORK-SOCKET!");
+        return false;
+    }
+    if (pConfig->s_NetListen[0] != 0) {
+        if (! Resolve(pConfig->s_NetListen, SOCK_DGRAM, &Listen)) {
+            syslog(LOG_ERR | LOG_DAEMON, "FAILURE RESOLVING THE NETWORK-ADDRESS %s!", pConfig->s_NetListen);
+            Close();
+            return false;
+        }
+        /** Several daemons on one host may share the port of a multicast-group:    */
+        setsockopt(i_UdpFd, SOL_SOCKET, SO_REUSEADDR, &iOn, sizeof(iOn));
+        if (bind(i_UdpFd, (struct sockaddr*) &Listen, sizeof(Listen)) != 0) {
+            syslog(LOG_ERR | LOG_DAEMON, "FAILURE BINDING THE NETWORK-SOCKET TO %s!", pConfig->s_NetListen);
+            Close();
+            return false;
+        }
+        /** A group is joined and sent to like a peer on the port listened on:      */
+        if (pConfig->s_NetGroup[0] != 0) {
+            memset(&Group, 0, sizeof(Group));
+            Group.imr_interface.s_addr = Listen.sin_addr.s_addr;
+            if ((inet_pton(AF_INET, pConfig->s_NetGroup, &Group.imr_multiaddr) != 1) ||
+                (setsockopt(i_UdpFd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &Group, sizeof(Group)) != 0)) {
+                syslog(LOG_ERR | LOG_DAEMON, "FAILURE JOINING THE MULTICAST-GROUP %s!", pConfig->s_NetGroup);
+                Close();
+                return false;
+            }
+            setsockopt(i_UdpFd, IPPROTO_IP, IP_MULTICAST_LOOP, &iOn, sizeof(iOn));
+            if (Listen.sin_addr.s_addr != INADDR_ANY) {
+                setsockopt(i_UdpFd, IPPROTO_IP, IP_MULTICAST_IF, &Listen.sin_addr, sizeof(Listen.sin_addr));
+            }
+            pPeer = &Peers[i_Peers++];
+            pPeer->Address          = Listen;
+            pPeer->Address.sin_addr = Group.imr_multiaddr;
+            pPeer->b_Tcp            = false;
+            pPeer->i_Fd             = -1;
+        }
+        /** Peers, which cannot use UDP, connect via TCP, but only with a key:      */
+        if (b_Key) {
+            i_TcpFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (i_TcpFd >= 0) setsockopt(i_TcpFd, SOL_SOCKET, SO_REUSEADDR, &iOn, sizeof(iOn));
+            if ((i_TcpFd < 0) || (bind(i_TcpFd, (struct sockaddr*) &Listen, sizeof(Listen)) != 0) ||
+                (listen(i_TcpFd, NET_MAX_INCOMING) != 0)) {
+                syslog(LOG_ERR | LOG_DAEMON, "FAILURE LISTENING FOR TCP-PEERS ON %s!", pConfig->s_NetListen);
+                Close();
+                return false;
+            }
+            Watch(i_TcpFd, EPOLLIN, true);
+        }
+        Watch(i_UdpFd, EPOLLIN, true);
+    }
+    /** Resolve the peers once, a name, which changes, needs a reload:              */
+    for (i=0; (i<pConfig->i_Peers) && (i_Peers<NET_MAX_PEERS); i++) {
+        if ((pConfig->Peers[i].b_Tcp) && (! b_Key)) {
+            syslog(LOG_WARNING | LOG_DAEMON, "FAILURE SENDING TO %s VIA TCP WITHOUT A KEY!", pConfig->Peers[i].s_Address);
+            continue;
+        }
+        pPeer = &Peers[i_Peers];
+        pPeer->b_Tcp       = pConfig->Peers[i].b_Tcp;
+        pPeer->i_Fd        = -1;
+        pPeer->b_Connected = false;
+        pPeer->ull_Retry   = 0;
+        pPeer->i_TxLen     = 0;
+        if ((strchr(pConfig->Peers[i].s_Address, ':') == 0) ||
+            (! Resolve(pConfig->Peers[i].s_Address, (pPeer->b_Tcp) ? SOCK_STREAM : SOCK_DGRAM, &pPeer->Address))) {
+            syslog(LOG_WARNING | LOG_DAEMON, "FAILURE RESOLVING THE PEER %s!", pConfig->Peers[i].s_Address);
+            continue;
+        }
+        i_Peers++;
+    }
+    return true;
+}
+
+void CNetwork::Close() {
+    int i;
+    /** Closing the descriptors removes them from the event-loop as well:           */
+    for (i=0; i<i_Peers; i++) {
+        if (Peers[i].i_Fd >= 0) close(Peers[i].i_Fd);
+    }
+    for (i=0; i<NET_MAX_INCOMING; i++) {
+        if (Incoming[i].i_Fd >= 0) close(Incoming[i].i_Fd);
+        Incoming[i].i_Fd = -1;
+    }
+    if (i_TcpFd >= 0) close(i_TcpFd);
+    if (i_UdpFd >= 0) close(i_UdpFd);
+    i_TcpFd   = -1;
+    i_UdpFd   = -1;
+    i_Peers   = 0;
+    i_Records = 0;
+}
+
+void CNetwork::Press(unsigned short uwPin, unsigned char ubGesture, unsigned long long ullTimestamp) {
+    /** The peers compare the press with their own clock, so it is in realtime:     */
+    if (! Active()) return;
+    Add(NET_KIND_PRESS, uwPin, ubGesture, ullTimestamp + Now(CLOCK_REALTIME) - Now(CLOCK_MONOTONIC), 0);
+}
+
+void CNetwork::Result(unsigned short uwPin, unsigned char ubGesture, int iCode) {
+    if (! Active()) return;
+    Add(NET_KIND_RESULT, uwPin, ubGesture, Now(CLOCK_REALTIME), iCode);
+}
+
+void CNetwork::Flush() {
+    /** Variables:                                                                  */
+    unsigned char      sPacket[NET_PACKET_SIZE];
+    struct mmsghdr     Messages[NET_MAX_PEERS];
+    struct iovec       Vector;
+    unsigned long long ullNow = 0;
+    int                i, n, iLen;
+    /** Connect the TCP-peers again, which were lost:                               */
+    for (i=0; i<i_Peers; i++) {
+        if ((! Peers[i].b_Tcp) || (Peers[i].i_Fd >= 0)) continue;
+        if (ullNow == 0) ullNow = Now(CLOCK_MONOTONIC);
+        if (ullNow >= Peers[i].ull_Retry) Connect(&Peers[i]);
+    }
+    if (i_Records == 0) return;
+    iLen = Encode(sPacket);
+    /** One datagram for all UDP-peers with a single system-call:                   */
+    Vector.iov_base = sPacket;
+    Vector.iov_len  = iLen;
+    memset(Messages, 0, sizeof(Messages));
+    for (i=n=0; i<i_Peers; i++) {
+        if (Peers[i].b_Tcp) {
+            /** A peer, which does not keep up, loses the packet, like via UDP:     */
+            if ((Peers[i].i_Fd < 0) || (Peers[i].i_TxLen + 2 + iLen > NET_TX_SIZE)) continue;
+            Put(&Peers[i].s_Tx[Peers[i].i_TxLen], iLen, 2);
+            memcpy(&Peers[i].s_Tx[Peers[i].i_TxLen + 2], sPacket, iLen);
+            Peers[i].i_TxLen += 2 + iLen;
+            Send(&Peers[i]);
+        }else{
+            Messages[n].msg_hdr.msg_name    = &Peers[i].Address;
+            Messages[n].msg_hdr.msg_namelen = sizeof(Peers[i].Address);
+            Messages[n].msg_hdr.msg_iov     = &Vector;
+            Messages[n].msg_hdr.msg_iovlen  = 1;
+            n++;
+        }
+    }
+    if ((n > 0) && (i_UdpFd >= 0)) sendmmsg(i_UdpFd, Messages, n, MSG_DONTWAIT);
+    ul_Sent  += i_Records;
+    i_Records = 0;
+}
+
+int CNetwork::HandleEvent(int iFd, unsigned int uiEvents, SNetRecord* pRecords, int iMax) {
+    /** Variables:                                                                  */
+    unsigned char  sBuffers[NET_RX_BATCH][NET_PACKET_SIZE];
+    struct mmsghdr Messages[NET_RX_BATCH];
+    struct iovec   Vectors [NET_RX_BATCH];
+    int            i, j, k, n = 0, iReceived, iLen, iError, iDecoded;
+    socklen_t      Size;
+    SNetPeer*      pPeer = 0;
+    SNetIncoming*  pIncoming = 0;
+    ssize_t        RxLen;
+    /** Datagrams are received in batches, as long as their records fit:            */
+    if (iFd == i_UdpFd) {
+        for (i=0; i<NET_RX_BATCH; i++) {
+            Vectors[i].iov_base = sBuffers[i];
+            Vectors[i].iov_len  = NET_PACKET_SIZE;
+        }
+        do {
+            memset(Messages, 0, sizeof(Messages));
+            for (i=0; i<NET_RX_BATCH; i++) {
+                Messages[i].msg_hdr.msg_iov    = &Vectors[i];
+                Messages[i].msg_hdr.msg_iovlen = 1;
+            }
+            j = (iMax - n) / NET_MAX_RECORDS;
+            iReceived = recvmmsg(i_UdpFd, Messages, (j < NET_RX_BATCH) ? j : NET_RX_BATCH, MSG_DONTWAIT, 0);
+            for (i=0; i<iReceived; i++) {
+                /** A truncated datagram was larger than any valid packet:          */
+                if (Messages[i].msg_hdr.msg_flags & MSG_TRUNC) {
+                    ul_Rejected++;
+                    continue;
+                }
+                iDecoded = Decode(sBuffers[i], Messages[i].msg_len, &pRecords[n], iMax - n);
+                if (iDecoded > 0) n += iDecoded;
+            }
+        } while ((iReceived > 0) && ((iMax - n) / NET_MAX_RECORDS >= NET_RX_BATCH));
+        return n;
+    }
+    /** Peers connect via TCP, if they cannot send datagrams:                       */
+    if (iFd == i_TcpFd) {
+        while ((j = accept4(i_TcpFd, 0, 0, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+            for (i=0; i<NET_MAX_INCOMING; i++) {
+                if (Incoming[i].i_Fd < 0) break;
+            }
+            /** All slots taken: the oldest one, which never proved itself, goes:   */
+            if (i >= NET_MAX_INCOMING) {
+                for (k=0; k<NET_MAX_INCOMING; k++) {
+                    if ((! Incoming[k].b_Valid) &&
+                        ((i >= NET_MAX_INCOMING) || (Incoming[k].ull_Accepted < Incoming[i].ull_Accepted))) i = k;
+                }
+                if (i >= NET_MAX_INCOMING) {
+                    close(j);
+                    continue;
+                }
+                close(Incoming[i].i_Fd);
+            }
+            Incoming[i].i_Fd         = j;
+            Incoming[i].i_RxLen      = 0;
+            Incoming[i].b_Valid      = false;
+            Incoming[i].ull_Accepted = Now(CLOCK_MONOTONIC);
+            Watch(j, EPOLLIN, true);
+        }
+        return 0;
+    }
+    for (i=0; i<i_Peers; i++) {
+        if ((Peers[i].b_Tcp) && (Peers[i].i_Fd == iFd)) pPeer = &Peers[i];
+    }
+    for (i=0; i<NET_MAX_INCOMING; i++) {
+        if (Incoming[i].i_Fd == iFd) pIncoming = &Incoming[i];
+    }
+    /** A connection to a peer was established, takes more or was lost:             */
+    if (pPeer != 0) {
+        if ((! pPeer->b_Connected) && (uiEvents & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+            Size = sizeof(iError);
+            if ((getsockopt(iFd, SOL_SOCKET, SO_ERROR, &iError, &Size) != 0) || (iError != 0)) {
+                Disconnect(pPeer);
+                return 0;
+            }
+            pPeer->b_Connected = true;
+        }
+        if (uiEvents & EPOLLOUT) {
+            Send(pPeer);
+            if ((pPeer->i_Fd >= 0) && (pPeer->i_TxLen == 0)) Watch(iFd, EPOLLIN, false);
+        }
+        if ((pPeer->i_Fd >= 0) && (uiEvents & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+            /** A peer never replies, so anything readable is its end:              */
+            if ((recv(iFd, sBuffers[0], NET_PACKET_SIZE, MSG_DONTWAIT) >= 0) || (errno != EAGAIN)) Disconnect(pPeer);
+        }
+        return 0;
+    }
+    if (pIncoming == 0) return 0;
+    /** Each packet is preceded by its length, read as many as fit:                 */
+    while (iMax - n >= NET_MAX_RECORDS) {
+        RxLen = recv(iFd, &pIncoming->s_Rx[pIncoming->i_RxLen], sizeof(pIncoming->s_Rx) - pIncoming->i_RxLen,
+                     MSG_DONTWAIT);
+        if ((RxLen < 0) && ((errno == EAGAIN) || (errno == EINTR))) break;
+        if (RxLen <= 0) {
+            close(iFd);
+            pIncoming->i_Fd = -1;
+            break;
+        }
+        pIncoming->i_RxLen += RxLen;
+        while ((pIncoming->i_RxLen >= 2) && (iMax - n >= NET_MAX_RECORDS)) {
+            iLen = (int) Get(pIncoming->s_Rx, 2);
+            if ((iLen < NET_HEADER_SIZE + NET_MAC_SIZE) || (iLen > NET_PACKET_SIZE)) {
+                /** The stream cannot be resynchronized after a wrong length:       */
+                ul_Rejected++;
+                close(iFd);
+                pIncoming->i_Fd = -1;
+                return n;
+            }
+            if (pIncoming->i_RxLen < 2 + iLen) break;
+            iDecoded = Decode(&pIncoming->s_Rx[2], iLen, &pRecords[n], iMax - n);
+            if (iDecoded < 0) {
+                /** A forged or malformed packet ends the connection at once:       */
+                close(iFd);
+                pIncoming->i_Fd = -1;
+                return n;
+            }
+            pIncoming->b_Valid  = true;
+            n                  += iDecoded;
+            pIncoming->i_RxLen -= 2 + iLen;
+            memmove(pIncoming->s_Rx, &pIncoming->s_Rx[2 + iLen], pIncoming->i_RxLen);
+        }
+    }
+    return n;
+}
+
+/** Private Functions: **************************************************************/
+
+void CNetwork::Add(unsigned char ubKind, unsigned short uwPin, unsigned char ubGesture, unsigned long long ullTimestamp,
+                   int iCode) {
+    /** A full packet goes out right away, the rest at the end of the iteration:    */
+    if (i_Records >= NET_MAX_RECORDS) Flush();
+    Records[i_Records].ull_Timestamp = ullTimestamp;
+    Records[i_Records].ui_Node       = ui_Node;
+    Records[i_Records].uw_Pin        = uwPin;
+    Records[i_Records].ub_Gesture    = ubGesture;
+    Records[i_Records].ub_Kind       = ubKind;
+    Records[i_Records].i_Code        = iCode;
+    i_Records++;
+}
+
+void CNetwork::Connect(SNetPeer* pPeer) {
+    int iOn = 1;
+    pPeer->i_TxLen     = 0;
+    pPeer->b_Connected = false;
+    pPeer->i_Fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (pPeer->i_Fd < 0) {
+        pPeer->ull_Retry = Now(CLOCK_MONOTONIC) + NET_RETRY_NS;
+        return;
+    }
+    /** The packets are small and should not wait for more:                         */
+    setsockopt(pPeer->i_Fd, IPPROTO_TCP, TCP_NODELAY, &iOn, sizeof(iOn));
+    if (connect(pPeer->i_Fd, (struct sockaddr*) &pPeer->Address, sizeof(pPeer->Address)) == 0) {
+        pPeer->b_Connected = true;
+        Watch(pPeer->i_Fd, EPOLLIN, true);
+    }else if (errno == EINPROGRESS) {
+        Watch(pPeer->i_Fd, EPOLLIN | EPOLLOUT, true);
+    }else{
+        Disconnect(pPeer);
+    }
+}
+
+void CNetwork::Send(SNetPeer* pPeer) {
+    ssize_t TxLen;
+    if (! pPeer->b_Connected) return;
+    while (pPeer->i_TxLen > 0) {
+        TxLen = send(pPeer->i_Fd, pPeer->s_Tx, pPeer->i_TxLen, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if ((TxLen < 0) && ((errno == EAGAIN) || (errno == EINTR))) break;
+        if (TxLen <= 0) {
+            Disconnect(pPeer);
+            return;
+        }
+        pPeer->i_TxLen -= TxLen;
+        memmove(pPeer->s_Tx, &pPeer->s_Tx[TxLen], pPeer->i_TxLen);
+    }
+    /** Wait for room, the event-loop stops waiting once all is sent:               */
+    if (pPeer->i_TxLen > 0) Watch(pPeer->i_Fd, EPOLLIN | EPOLLOUT, false);
+}
+
+void CNetwork::Disconnect(SNetPeer* pPeer) {
+    if (pPeer->i_Fd >= 0) close(pPeer->i_Fd);
+    pPeer->i_Fd        = -1;
+    pPeer->b_Connected = false;
+    pPeer->i_TxLen     = 0;
+    pPeer->ull_Retry   = Now(CLOCK_MONOTONIC) + NET_RETRY_NS;
+}
+
+void CNetwork::Watch(int iFd, unsigned int uiEvents, bool bAdd) {
+    struct epoll_event Event;
+    memset(&Event, 0, sizeof(Event));
+    Event.events   = uiEvents;
+    Event.data.u64 = ((unsigned long long) ui_EpollTag << 32) | (unsigned int) iFd;
+    epoll_ctl(i_EpollFd, (bAdd) ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, iFd, &Event);
+}
+
+int CNetwork::Encode(unsigned char* pPacket) {
+    int            i;
+    unsigned char* pRecord;
+    Put(&pPacket[0],  NET_MAGIC, 4);
+    Put(&pPacket[4],  ui_Node,   4);
+    Put(&pPacket[8],  ull_Boot,  8);
+    Put(&pPacket[16], ++ui_Seq,  4);
+    Put(&pPacket[20], i_Records, 2);
+    Put(&pPacket[22], 0,         2);
+    for (i=0; i<i_Records; i++) {
+        pRecord = &pPacket[NET_HEADER_SIZE + i * NET_RECORD_SIZE];
+        Put(&pRecord[0],  Records[i].ull_Timestamp,             8);
+        Put(&pRecord[8],  Records[i].uw_Pin,                    2);
+        Put(&pRecord[10], Records[i].ub_Gesture,                1);
+        Put(&pRecord[11], Records[i].ub_Kind,                   1);
+        Put(&pRecord[12], (unsigned int) Records[i].i_Code,     4);
+    }
+    i = NET_HEADER_SIZE + i_Records * NET_RECORD_SIZE;
+    Put(&pPacket[i], Mac(pPacket, i), NET_MAC_SIZE);
+    return i + NET_MAC_SIZE;
+}
+
+int CNetwork::Decode(const unsigned char* pPacket, int iLen, SNetRecord* pRecords, int iMax) {
+    /** Variables:                                                                  */
+    unsigned int         uiNode, uiSeq;
+    unsigned long long   ullBoot;
+    int                  i, n, iCount;
+    SNetNode*            pNode = 0;
+    const unsigned char* pRecord;
+    /** Check the size, the magic and the MAC first, a forged packet returns -1:    */
+    iCount = (iLen - NET_HEADER_SIZE - NET_MAC_SIZE) / NET_RECORD_SIZE;
+    if ((iLen < NET_HEADER_SIZE + NET_MAC_SIZE) || (Get(&pPacket[0], 4) != NET_MAGIC) ||
+        (iCount > NET_MAX_RECORDS) || (iLen != NET_HEADER_SIZE + iCount * NET_RECORD_SIZE + NET_MAC_SIZE) ||
+        ((int) Get(&pPacket[20], 2) != iCount) ||
+        ((b_Key) && (Get(&pPacket[iLen - NET_MAC_SIZE], NET_MAC_SIZE) != Mac(pPacket, iLen - NET_MAC_SIZE)))) {
+        ul_Rejected++;
+        return -1;
+    }
+    uiNode  = (unsigned int) Get(&pPacket[4], 4);
+    ullBoot = Get(&pPacket[8], 8);
+    uiSeq   = (unsigned int) Get(&pPacket[16], 4);
+    /** The own packets come back via the multicast-group:                          */
+    if (uiNode == ui_Node) return 0;
+    for (i=0; i<i_Nodes; i++) {
+        if (Nodes[i].ui_Node == uiNode) pNode = &Nodes[i];
+    }
+    if (pNode == 0) {
+        /** A new sender takes a free slot or, if all are taken, the one of its id: */
+        pNode = &Nodes[(i_Nodes < NET_MAX_NODES) ? i_Nodes : uiNode % NET_MAX_NODES];
+        if (i_Nodes < NET_MAX_NODES) i_Nodes++;
+    }else if ((ullBoot < pNode->ull_Boot) || ((ullBoot == pNode->ull_Boot) && (uiSeq <= pNode->ui_Seq))) {
+        /** An old or repeated packet, which must not trigger anything again:       */
+        ul_Rejected++;
+        return 0;
+    }else if (ullBoot == pNode->ull_Boot) {
+        ul_Lost += uiSeq - pNode->ui_Seq - 1;
+    }
+    pNode->ui_Node  = uiNode;
+    pNode->ull_Boot = ullBoot;
+    pNode->ui_Seq   = uiSeq;
+    /** Hand out the records, the kinds of later versions are skipped:              */
+    for (i=n=0; (i<iCount) && (n<iMax); i++) {
+        pRecord = &pPacket[NET_HEADER_SIZE + i * NET_RECORD_SIZE];
+        if ((pRecord[11] != NET_KIND_PRESS) && (pRecord[11] != NET_KIND_RESULT)) continue;
+        pRecords[n].ull_Timestamp = Get(&pRecord[0], 8);
+        pRecords[n].ui_Node       = uiNode;
+        pRecords[n].uw_Pin        = (unsigned short) Get(&pRecord[8], 2);
+        pRecords[n].ub_Gesture    = pRecord[10];
+        pRecords[n].ub_Kind       = pRecord[11];
+        pRecords[n].i_Code        = (int) Get(&pRecord[12], 4);
+        n++;
+    }
+    ul_Received += n;
+    return n;
+}
+
+unsigned long long CNetwork::Mac(const unsigned char* pData, int iLen) {
+    return (b_Key) ? SipHash(ull_Key, pData, iLen) : 0;
+}
@@ -0,0 +1,157 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+
+/** Notes: *************************************************************************** 
+
+Optional trigger and fan-out over the network. Each daemon sends its presses and the
+results of its jobs to its peers and runs the presses it receives from them with the
+action of the same pin and gesture, so one button triggers a whole room of buzzers.
+Received presses are never sent on, so peers may list each other.
+
+All records of one iteration of the main-loop go out as one datagram, which is sent
+to all UDP-peers with a single sendmmsg(). A multicast-group counts as one peer. Peers
+behind a network, which drops UDP, may be reached via TCP instead; these connections
+are only used with a key. Each packet, in network byte-order:
+
+  0  magic    "BZD1"
+  4  node     id of the sender
+  8  boot     CLOCK_REALTIME in ns, when the sender started
+  16 seq      counts the packets of the sender, the same for all of its peers
+  20 count    number of records
+  24 records  16 bytes each: timestamp (CLOCK_REALTIME in ns), pin (16 bit), gesture
+              (8 bit), kind (8 bit), exit-code (32 bit, results only)
+  ...mac      SipHash-2-4 of all bytes before, 0 without a key
+
+A receiver keeps boot and seq of each sender: a gap in the seq is counted as lost,
+an older or repeated one is rejected, so neither duplicates nor replays trigger
+anything. A newer boot means the sender restarted. With a key, packets without the
+right MAC are rejected as well. Via TCP, each packet is preceded by its length. A
+connection, which sends a malformed or forged packet, is closed. Once all slots for
+incoming connections are taken, a new one evicts the oldest, which has not sent a
+valid packet yet, so idle strangers cannot lock out the peers.
+
+*************************************************************************************/
+
+/** Global Includes: ****************************************************************/
+
+#include <netinet/in.h>
+
+/** Local Defines: ******************************************************************/
+
+#define NET_MAGIC        0x425A4431U            // "BZD1"
+#define NET_HEADER_SIZE  24
+#define NET_RECORD_SIZE  16
+#define NET_MAC_SIZE     8
+#define NET_MAX_RECORDS  32                     // Per packet.
+#define NET_PACKET_SIZE  (NET_HEADER_SIZE + NET_MAX_RECORDS * NET_RECORD_SIZE + NET_MAC_SIZE)
+#define NET_MAX_PEERS    16
+#define NET_MAX_NODES    32                     // Senders, whose seq is kept.
+#define NET_MAX_INCOMING 8                      // Accepted TCP-connections.
+#define NET_TX_SIZE      (8 * NET_PACKET_SIZE)  // Per TCP-peer.
+#define NET_RETRY_NS     1000000000ULL          // Until a TCP-peer is connected again.
+
+#define NET_KIND_PRESS   1
+#define NET_KIND_RESULT  2
+
+/** Type-Definitions: ***************************************************************/
+
+struct SNetRecord {
+    unsigned long long ull_Timestamp;           // CLOCK_REALTIME of the sender in ns.
+    unsigned int       ui_Node;                 // Sender, only when received.
+    unsigned short     uw_Pin;
+    unsigned char      ub_Gesture;
+    unsigned char      ub_Kind;                 // One of NET_KIND_*.
+    int                i_Code;                  // Exit-code of a result.
+};
+
+struct SNetPeer {
+    struct sockaddr_in Address;
+    bool               b_Tcp;
+    int                i_Fd;                    // TCP only, -1 while not connected.
+    bool               b_Connected;
+    unsigned long long ull_Retry;               // Next attempt to connect.
+    int                i_TxLen;
+    unsigned char      s_Tx[NET_TX_SIZE];
+};
+
+struct SNetNode {
+    unsigned int       ui_Node;
+    unsigned long long ull_Boot;
+    unsigned int       ui_Seq;                  // Last accepted packet.
+};
+
+struct SNetIncoming {
+    int                i_Fd;
+    bool               b_Valid;                 // Sent a packet with the right MAC.
+    unsigned long long ull_Accepted;            // Order of the connections.
+    int                i_RxLen;
+    unsigned char      s_Rx[2 + NET_PACKET_SIZE];
+};
+
+/** Class Definition: ***************************************************************/
+
+struct SConfig;
+
+class CNetwork {
+public:
+    // Properties:
+    unsigned long      ul_Sent;                 // Records sent.
+    unsigned long      ul_Received;             // Records accepted.
+    unsigned long      ul_Lost;                 // Packets missing in the seq.
+    unsigned long      ul_Rejected;             // Packets, which were malformed, forged or old.
+    // Methods:
+    CNetwork();
+    ~CNetwork();
+    bool Open        (const SConfig* pConfig, int iEpollFd, unsigned int uiTag);
+    void Close       ();
+    bool Active      () { return ((i_UdpFd >= 0) || (i_TcpFd >= 0)); };
+    void Press       (unsigned short uwPin, unsigned char ubGesture, unsigned long long ullTimestamp);
+    void Result      (unsigned short uwPin, unsigned char ubGesture, int iCode);
+    void Flush       ();
+    int  HandleEvent (int iFd, unsigned int uiEvents, SNetRecord* pRecords, int iMax);
+private:
+    // Properties:
+    int                i_EpollFd;
+    unsigned int       ui_EpollTag;
+    int                i_UdpFd;
+    int                i_TcpFd;                 // Listens for peers, only with a key.
+    bool               b_Key;
+    unsigned long long ull_Key[2];
+    unsigned int       ui_Node;
+    unsigned long long ull_Boot;
+    unsigned int       ui_Seq;
+    int                i_Peers;
+    SNetPeer           Peers[NET_MAX_PEERS];
+    SNetNode           Nodes[NET_MAX_NODES];
+    int                i_Nodes;
+    SNetIncoming       Incoming[NET_MAX_INCOMING];
+    int                i_Records;
+    SNetRecord         Records[NET_MAX_RECORDS];
+    // Methods:
+    void Add         (unsigned char ubKind, unsigned short uwPin, unsigned char ubGesture, unsigned long long ullTimestamp,
+                      int iCode);
+    void Connect     (SNetPeer* pPeer);
+    void Send        (SNetPeer* pPeer);
+    void Disconnect  (SNetPeer* pPeer);
+    void Watch       (int iFd, unsigned int uiEvents, bool bAdd);
+    int  Encode      (unsigned char* pPacket);
+    int  Decode      (const unsigned char* pPacket, int iLen, SNetRecord* pRecords, int iMax);
+    unsigned long long Mac(const unsigned char* pData, int iLen);
+};
@@ -0,0 +1,91 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/** Notes: *************************************************************************** 
+
+Single-producer/single-consumer ring of press-events. The producer is the gesture-
+engine, which is fed by the sampling-timer (polling) or the edge-handler of the
+main-loop or by the real-time input-thread, the consumer is the main-loop. Both
+sides only use atomic loads and stores, so the input-thread pushes an event without
+a lock or a system-call. A full ring never overwrites an event, it counts the
+overrun instead.
+
+*************************************************************************************/
+
+/** Global Includes: ****************************************************************/
+
+#include <atomic>
+
+/** Local Defines: ******************************************************************/
+
+#define PRESS_RING_SIZE  1024                   // Must be a power of two.
+
+/** Type-Definitions: ***************************************************************/
+
+struct SPressEvent {
+    unsigned long long ull_Timestamp;           // CLOCK_MONOTONIC in ns.
+    unsigned short     uw_Pin;
+    unsigned char      ub_Gesture;              // One of GESTURE_*.
+};
+
+/** Class Definition: ***************************************************************/
+
+class CPressRing {
+public:
+    // Methods:
+    CPressRing() : ui_Head(0), ui_Tail(0), ul_Overruns(0) {};
+    
+    bool Push(unsigned long long ullTimestamp, unsigned short uwPin, unsigned char ubGesture) {
+        unsigned int uiHead = ui_Head.load(std::memory_order_relaxed);
+        /** Count the event as overrun, if the consumer has not caught up:          */
+        if ((uiHead - ui_Tail.load(std::memory_order_acquire)) >= PRESS_RING_SIZE) {
+            ul_Overruns.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        /** Fill the entry before publishing it via the head:                       */
+        Events[uiHead & (PRESS_RING_SIZE - 1)].ull_Timestamp = ullTimestamp;
+        Events[uiHead & (PRESS_RING_SIZE - 1)].uw_Pin        = uwPin;
+        Events[uiHead & (PRESS_RING_SIZE - 1)].ub_Gesture    = ubGesture;
+        ui_Head.store(uiHead + 1, std::memory_order_release);
+        return true;
+    };
+    
+    bool Pop(SPressEvent* pEvent) {
+        unsigned int uiTail = ui_Tail.load(std::memory_order_relaxed);
+        /** Check for a published entry and release it after copying:               */
+        if (uiTail == ui_Head.load(std::memory_order_acquire)) return false;
+        *pEvent = Events[uiTail & (PRESS_RING_SIZE - 1)];
+        ui_Tail.store(uiTail + 1, std::memory_order_release);
+        return true;
+    };
+    
+    unsigned int Pushed() {
+        return ui_Head.load(std::memory_order_relaxed);
+    };
+    
+    unsigned long Overruns() {
+        return ul_Overruns.load(std::memory_order_relaxed);
+    };
+private:
+    // Properties:
+    std::atomic<unsigned int>  ui_Head;
+    std::atomic<unsigned int>  ui_Tail;
+    std::atomic<unsigned long> ul_Overruns;
+    SPressEvent                Events[PRESS_RING_SIZE];
+};
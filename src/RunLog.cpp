@@ -0,0 +1,262 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+
+/** Global Includes: ****************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <syslog.h>
+#include <sys/epoll.h>
+
+#include "RunLog.h"
+
+/** Public Functions: ***************************************************************/
+
+CRunLog::CRunLog() {
+    int i;
+    s_LogFile[0] = 0;
+    i_LogFd      = -1;
+    i_EpollFd    = -1;
+    ui_EpollTag  = 0;
+    ul_Completed = 0;
+    i_BatchLen   = 0;
+    for (i=0; i<RUN_MAX_ACTIVE; i++) Active[i].b_Active = false;
+}
+
+CRunLog::~CRunLog() {
+    Flush();
+    if (i_LogFd >= 0) close(i_LogFd);
+}
+
+void CRunLog::SetEpoll(int iEpollFd, unsigned int uiTag) {
+    /** The pipe of each run gets registered at this event-loop:                    */
+    i_EpollFd   = iEpollFd;
+    ui_EpollTag = uiTag;
+}
+
+void CRunLog::SetLogFile(const char* sLogFile) {
+    /** Write the pending runs into the old file, before the new one is used:       */
+    if (strcmp(s_LogFile, sLogFile) == 0) return;
+    Flush();
+    if (i_LogFd >= 0) close(i_LogFd);
+    i_LogFd = -1;
+    strncpy(s_LogFile, sLogFile, sizeof(s_LogFile) - 1);
+    s_LogFile[sizeof(s_LogFile) - 1] = 0;
+}
+
+SRun* CRunLog::Begin(unsigned long ulId, unsigned long long ullStarted, int iFd) {
+    /** Variables:                                                                  */
+    int  i;
+    SRun *pRun;
+    struct epoll_event Event;
+    /** Take a free record for the run:                                             */
+    for (i=0; i<RUN_MAX_ACTIVE; i++) {
+        if (! Active[i].b_Active) break;
+    }
+    if (i >= RUN_MAX_ACTIVE) {
+        if (iFd >= 0) close(iFd);
+        return 0;
+    }
+    pRun = &Active[i];
+    pRun->ul_Id        = ulId;
+    pRun->ull_Started  = ullStarted;
+    pRun->ull_Finished = 0;
+    pRun->i_ExitCode   = 0;
+    pRun->b_Result     = false;
+    pRun->i_Fd         = iFd;
+    pRun->b_Active     = true;
+    pRun->ul_Bytes     = 0;
+    pRun->i_Len        = 0;
+    /** Let the event-loop wake up on its output:                                   */
+    if ((iFd >= 0) && (i_EpollFd >= 0)) {
+        memset(&Event, 0, sizeof(Event));
+        Event.events   = EPOLLIN;
+        Event.data.u64 = ((unsigned long long) ui_EpollTag << 32) | (unsigned int) iFd;
+        epoll_ctl(i_EpollFd, EPOLL_CTL_ADD, iFd, &Event);
+    }
+    return pRun;
+}
+
+bool CRunLog::Read(int iFd) {
+    /** Variables:                                                                  */
+    int i;
+    /** Collect the output of the run, which owns this pipe:                        */
+    for (i=0; i<RUN_MAX_ACTIVE; i++) {
+        if ((! Active[i].b_Active) || (Active[i].i_Fd != iFd)) continue;
+        Drain(&Active[i]);
+        return true;
+    }
+    return false;
+}
+
+void CRunLog::Finish(unsigned long ulId, int iExitCode, unsigned long long ullFinished) {
+    /** Variables:                                                                  */
+    int  i;
+    SRun *pRun = 0;
+    /** Find the record of the run, a run, which never started, gets an empty one:  */
+    for (i=0; i<RUN_MAX_ACTIVE; i++) {
+        if ((Active[i].b_Active) && (Active[i].ul_Id == ulId)) pRun = &Active[i];
+    }
+    if (pRun == 0) pRun = Begin(ulId, ullFinished, -1);
+    if (pRun == 0) return;
+    /** Take, what the run wrote before it exited, and close its pipe:              */
+    if (pRun->i_Fd >= 0) {
+        Drain(pRun);
+        Detach(pRun);
+    }
+    pRun->i_ExitCode   = iExitCode;
+    pRun->ull_Finished = ullFinished;
+    pRun->b_Active     = false;
+    /** Move it into the history and the batch for the log-file:                    */
+    History[ul_Completed % RUN_HISTORY] = *pRun;
+    ul_Completed++;
+    Batch(pRun);
+}
+
+bool CRunLog::SetResult(unsigned long ulId, int iResult) {
+    int i;
+    /** Only a run, which is still active, may replace its exit-code:               */
+    for (i=0; i<RUN_MAX_ACTIVE; i++) {
+        if ((! Active[i].b_Active) || (Active[i].ul_Id != ulId)) continue;
+        Active[i].b_Result = true;
+        Active[i].i_Result = iResult;
+        return true;
+    }
+    return false;
+}
+
+bool CRunLog::GetResult(unsigned long ulId, int* piResult) {
+    int i;
+    for (i=0; i<RUN_MAX_ACTIVE; i++) {
+        if ((! Active[i].b_Active) || (Active[i].ul_Id != ulId) || (! Active[i].b_Result)) continue;
+        *piResult = Active[i].i_Result;
+        return true;
+    }
+    return false;
+}
+
+void CRunLog::Flush() {
+    /** Variables:                                                                  */
+    ssize_t TxLen;
+    int     iDone = 0;
+    /** Write the batch with as few calls as possible:                              */
+    if ((i_BatchLen == 0) || (s_LogFile[0] == 0)) {
+        i_BatchLen = 0;
+        return;
+    }
+    if (i_LogFd < 0) {
+        i_LogFd = open(s_LogFile, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0666);
+        if (i_LogFd < 0) {
+            syslog(LOG_WARNING | LOG_DAEMON, "FAILURE OPENING THE CLIENT-OUTPUT %s!", s_LogFile);
+            i_BatchLen = 0;
+            return;
+        }
+    }
+    while (iDone < i_BatchLen) {
+        TxLen = write(i_LogFd, &s_Batch[iDone], i_BatchLen - iDone);
+        if ((TxLen < 0) && (errno == EINTR)) continue;
+        if (TxLen <= 0) break;
+        iDone += TxLen;
+    }
+    i_BatchLen = 0;
+}
+
+unsigned long CRunLog::Completed() {
+    return ul_Completed;
+}
+
+const SRun* CRunLog::Get(unsigned long ulSeq) {
+    /** Only the last runs are kept, the older ones have been overwritten:          */
+    if ((ulSeq >= ul_Completed) || (ul_Completed - ulSeq > RUN_HISTORY)) return 0;
+    return &History[ulSeq % RUN_HISTORY];
+}
+
+int CRunLog::Format(const SRun* pRun, char* sLine, int iSize) {
+    /** Variables:                                                                  */
+    int  i, n;
+    char c;
+    /** Put the run into one line, the output is escaped to stay on it:             */
+    n = snprintf(sLine, iSize, "run %lu %llu %llu %i %lu ", pRun->ul_Id, pRun->ull_Started,
+                 pRun->ull_Finished, pRun->i_ExitCode, pRun->ul_Bytes);
+    for (i=0; (i<pRun->i_Len) && (n<iSize-3); i++) {
+        c = pRun->s_Output[i];
+        if      (c == '\n') { sLine[n++] = '\\'; sLine[n++] = 'n';  }
+        else if (c == '\\') { sLine[n++] = '\\'; sLine[n++] = '\\'; }
+        else if (c == '\t') { sLine[n++] = '\\'; sLine[n++] = 't';  }
+        else if ((unsigned char) c < ' ') sLine[n++] = '?';
+        else sLine[n++] = c;
+    }
+    sLine[n] = 0;
+    return n;
+}
+
+/** Private Functions: **************************************************************/
+
+void CRunLog::Drain(SRun* pRun) {
+    /** Variables:                                                                  */
+    char    sBuffer[4096];
+    ssize_t RxLen;
+    int     iCopy, iReads;
+    /** Read, what is available, the output beyond the record is only counted:      */
+    for (iReads=0; iReads<16; iReads++) {
+        RxLen = read(pRun->i_Fd, sBuffer, sizeof(sBuffer));
+        if ((RxLen < 0) && (errno == EINTR)) continue;
+        if (RxLen < 0) return;
+        if (RxLen == 0) {
+            /** The run and its children have closed the pipe:                      */
+            Detach(pRun);
+            return;
+        }
+        iCopy = RUN_OUTPUT_SIZE - pRun->i_Len;
+        if (iCopy > RxLen) iCopy = RxLen;
+        memcpy(&pRun->s_Output[pRun->i_Len], sBuffer, iCopy);
+        pRun->i_Len    += iCopy;
+        pRun->ul_Bytes += RxLen;
+    }
+}
+
+void CRunLog::Batch(const SRun* pRun) {
+    /** Variables:                                                                  */
+    char sHeader[160];
+    int  iHeader, iOutput;
+    /** Describe the run, followed by its output:                                   */
+    iHeader = snprintf(sHeader, sizeof(sHeader),
+                       "buzzerd: Run %lu exited with code %i after %llu ms, %lu bytes of output%s\n",
+                       pRun->ul_Id, pRun->i_ExitCode, (pRun->ull_Finished - pRun->ull_Started) / 1000000ULL,
+                       pRun->ul_Bytes, (pRun->ul_Bytes > (unsigned long) pRun->i_Len) ? " (truncated):" : ":");
+    iOutput = pRun->i_Len;
+    if (iHeader + iOutput + 1 > RUN_BATCH_SIZE - i_BatchLen) Flush();
+    memcpy(&s_Batch[i_BatchLen], sHeader, iHeader);
+    i_BatchLen += iHeader;
+    memcpy(&s_Batch[i_BatchLen], pRun->s_Output, iOutput);
+    i_BatchLen += iOutput;
+    if ((iOutput > 0) && (pRun->s_Output[iOutput-1] != '\n')) s_Batch[i_BatchLen++] = '\n';
+}
+
+void CRunLog::Detach(SRun* pRun) {
+    /** Unregister the pipe before closing it, a forked client may still share it:  */
+    if (pRun->i_Fd < 0) return;
+    if (i_EpollFd >= 0) epoll_ctl(i_EpollFd, EPOLL_CTL_DEL, pRun->i_Fd, 0);
+    close(pRun->i_Fd);
+    pRun->i_Fd = -1;
+}
@@ -0,0 +1,87 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+
+/** Notes: *************************************************************************** 
+
+The output of each run (stdout and stderr) is read from a pipe of the daemon into the
+record of the run. Once the run has finished, its record is moved into the history,
+which keeps the last RUN_HISTORY runs in memory, and appended to a batch. The batch
+is written to the log-file at once, whenever the daemon becomes idle or it is full.
+
+*************************************************************************************/
+
+/** Local Defines: ******************************************************************/
+
+#define RUN_MAX_ACTIVE   64
+#define RUN_HISTORY      128
+#define RUN_OUTPUT_SIZE  1024
+#define RUN_LINE_SIZE    (2 * RUN_OUTPUT_SIZE + 128)
+#define RUN_BATCH_SIZE   16384
+
+/** Type-Definitions: ***************************************************************/
+
+struct SRun {
+    unsigned long      ul_Id;
+    unsigned long long ull_Started;
+    unsigned long long ull_Finished;
+    int                i_ExitCode;
+    bool               b_Result;                // The job replaced its exit-code.
+    int                i_Result;
+    int                i_Fd;
+    bool               b_Active;
+    unsigned long      ul_Bytes;
+    int                i_Len;
+    char               s_Output[RUN_OUTPUT_SIZE];
+};
+
+/** Class Definition: ***************************************************************/
+
+class CRunLog {
+public:
+    // Methods:
+    CRunLog();
+    ~CRunLog();
+    void        SetEpoll  (int iEpollFd, unsigned int uiTag);
+    void        SetLogFile(const char* sLogFile);
+    SRun*       Begin     (unsigned long ulId, unsigned long long ullStarted, int iFd);
+    bool        Read      (int iFd);
+    void        Finish    (unsigned long ulId, int iExitCode, unsigned long long ullFinished);
+    bool        SetResult (unsigned long ulId, int iResult);
+    bool        GetResult (unsigned long ulId, int* piResult);
+    void        Flush     ();
+    unsigned long Completed();
+    const SRun* Get       (unsigned long ulSeq);
+    int         Format    (const SRun* pRun, char* sLine, int iSize);
+private:
+    // Properties:
+    char               s_LogFile[1024];
+    int                i_LogFd;
+    int                i_EpollFd;
+    unsigned int       ui_EpollTag;
+    SRun               Active [RUN_MAX_ACTIVE];
+    SRun               History[RUN_HISTORY];
+    unsigned long      ul_Completed;
+    char               s_Batch[RUN_BATCH_SIZE];
+    int                i_BatchLen;
+    // Methods:
+    void        Drain     (SRun* pRun);
+    void        Batch     (const SRun* pRun);
+    void        Detach    (SRun* pRun);
+};
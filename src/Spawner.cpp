@@ -0,0 +1,283 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/** Global Includes: ****************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "Spawner.h"
+#include "JobQueue.h"
+
+/** Global Variables: ***************************************************************/
+
+extern char** environ;
+
+/** Public Functions: ***************************************************************/
+
+CSpawner::CSpawner() {
+    b_Prepared   = false;
+    s_Path[0]    = 0;
+    s_LogFile[0] = 0;
+    p_Env        = 0;
+    i_Env        = 0;
+    i_CpuSeconds = 0;
+    i_MemoryMb   = 0;
+    i_CgroupProcs = -1;
+}
+
+CSpawner::~CSpawner() {
+    delete[] p_Env;
+    if (! b_Prepared) return;
+    posix_spawnattr_destroy(&Attributes);
+}
+
+bool CSpawner::Prepare(const char* sExecutable, const char* sLogFile) {
+    /** Variables:                                                                  */
+    char*    pToken;
+    char*    pSave;
+    int      iArgs = 0;
+    sigset_t Signals;
+    /** Drop whatever was prepared before:                                          */
+    if (b_Prepared) {
+        posix_spawnattr_destroy(&Attributes);
+        b_Prepared = false;
+    }
+    /** Split the executable into its arguments, the first is the program:          */
+    strncpy(s_Args, sExecutable, sizeof(s_Args) - 1);
+    s_Args[sizeof(s_Args) - 1] = 0;
+    pToken = strtok_r(s_Args, " \t", &pSave);
+    if (pToken == 0) return false;
+    if (! Resolve(pToken)) return false;
+    /** Scripts without the executable-flag are run via bash, as in shell-mode:     */
+    if (access(s_Path, X_OK) != 0) {
+        p_Argv[iArgs++] = (char*) "bash";
+        p_Argv[iArgs++] = s_Path;
+        strcpy(s_Path, "/bin/bash");
+    }else{
+        p_Argv[iArgs++] = pToken;
+    }
+    while ((iArgs < SPAWN_MAX_ARGS) && ((pToken = strtok_r(0, " \t", &pSave)) != 0)) {
+        p_Argv[iArgs++] = pToken;
+    }
+    p_Argv[iArgs] = 0;
+    /** Batches and control-connections get their entries added to the environment: */
+    delete[] p_Env;
+    for (i_Env=0; environ[i_Env] != 0; i_Env++);
+    p_Env = new char*[i_Env + 3];
+    memcpy(p_Env, environ, i_Env * sizeof(char*));
+    p_Env[i_Env] = 0;
+    snprintf(s_Control, sizeof(s_Control), SPAWN_CONTROL_ENV "=%i", SPAWN_CONTROL_FD);
+    /** The log-file only takes the stderr of the workers directly:                 */
+    strncpy(s_LogFile, sLogFile, sizeof(s_LogFile) - 1);
+    s_LogFile[sizeof(s_LogFile) - 1] = 0;
+    /** The child starts with a clean signal-mask and default handlers:             */
+    posix_spawnattr_init(&Attributes);
+    sigemptyset(&Signals);
+    posix_spawnattr_setsigmask(&Attributes, &Signals);
+    sigaddset(&Signals, SIGPIPE);
+    posix_spawnattr_setsigdefault(&Attributes, &Signals);
+    /** Its own process-group lets a timeout stop the children of a script, too:    */
+    posix_spawnattr_setpgroup(&Attributes, 0);
+    posix_spawnattr_setflags(&Attributes, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETPGROUP);
+    b_Prepared = true;
+    return true;
+}
+
+pid_t CSpawner::Spawn(int* pOutput, const unsigned long long* pullStamps, int iStamps, int iControl) {
+    /** Variables:                                                                  */
+    pid_t pid;
+    int   OutPipe[2];
+    int   iInput = -1, iEnv;
+    /** The output goes into a pipe, the end of the daemon is non-blocking:         */
+    if (! b_Prepared) return -1;
+    if (pipe2(OutPipe, O_CLOEXEC) != 0) return -1;
+    fcntl(OutPipe[0], F_SETFL, O_NONBLOCK);
+    /** A batch reads the timestamps of its presses from stdin:                     */
+    if ((iStamps > 0) && ((iInput = BatchInput(pullStamps, iStamps)) < 0)) {
+        close(OutPipe[0]);
+        close(OutPipe[1]);
+        return -1;
+    }
+    snprintf(s_Batch, sizeof(s_Batch), SPAWN_BATCH_ENV "=%i", iStamps);
+    iEnv = i_Env;
+    if (iControl >= 0) p_Env[iEnv++] = s_Control;
+    if (iStamps  >  0) p_Env[iEnv++] = s_Batch;
+    p_Env[iEnv] = 0;
+    /** Stdin is /dev/null or the batch, stdout and stderr go into the pipe:        */
+    pid = Launch(iInput, OutPipe[1], OutPipe[1], iControl, (iEnv > i_Env) ? p_Env : environ);
+    close(OutPipe[1]);
+    if (iInput >= 0) close(iInput);
+    if (pid < 0) {
+        close(OutPipe[0]);
+        return -1;
+    }
+    *pOutput = OutPipe[0];
+    return pid;
+}
+
+pid_t CSpawner::SpawnWorker(int* pStdin, int* pStdout) {
+    /** Variables:                                                                  */
+    pid_t pid;
+    int   InPipe[2], OutPipe[2];
+    /** Create the pipes, the ends of the daemon are non-blocking:                  */
+    if (! b_Prepared) return -1;
+    if (pipe2(InPipe, O_CLOEXEC) != 0) return -1;
+    if (pipe2(OutPipe, O_CLOEXEC) != 0) {
+        close(InPipe[0]);
+        close(InPipe[1]);
+        return -1;
+    }
+    fcntl(InPipe[1],  F_SETFL, O_NONBLOCK);
+    fcntl(OutPipe[0], F_SETFL, O_NONBLOCK);
+    /** Connect the pipes to stdin and stdout, stderr is appended to the log-file:  */
+    pid = Launch(InPipe[0], OutPipe[1], -1, -1, environ);
+    /** Keep only the ends of the daemon:                                           */
+    close(InPipe[0]);
+    close(OutPipe[1]);
+    if (pid < 0) {
+        close(InPipe[1]);
+        close(OutPipe[0]);
+        return -1;
+    }
+    *pStdin  = InPipe[1];
+    *pStdout = OutPipe[0];
+    return pid;
+}
+
+void CSpawner::Limit(int iCpuSeconds, int iMemoryMb, int iCgroupProcs) {
+    /** The limits apply to all processes spawned from now on:                      */
+    i_CpuSeconds  = iCpuSeconds;
+    i_MemoryMb    = iMemoryMb;
+    i_CgroupProcs = iCgroupProcs;
+}
+
+bool CSpawner::Confine() {
+    /** Variables:                                                                  */
+    struct rlimit Resource;
+    /** Called by the new process itself, so its children inherit all of it:        */
+    if ((i_CgroupProcs >= 0) && (write(i_CgroupProcs, "0", 1) != 1)) return false;
+    if (i_CpuSeconds > 0) {
+        /** The soft limit sends SIGXCPU, the hard one a second later SIGKILL:      */
+        Resource.rlim_cur = i_CpuSeconds;
+        Resource.rlim_max = i_CpuSeconds + 1;
+        if (setrlimit(RLIMIT_CPU, &Resource) != 0) return false;
+    }
+    if (i_MemoryMb > 0) {
+        Resource.rlim_cur = Resource.rlim_max = (rlim_t) i_MemoryMb * 1024 * 1024;
+        if (setrlimit(RLIMIT_AS, &Resource) != 0) return false;
+    }
+    return true;
+}
+
+int CSpawner::BatchInput(const unsigned long long* pullStamps, int iStamps) {
+    /** Variables:                                                                  */
+    int  InPipe[2];
+    char sLines[JOB_MAX_BATCH * 24];
+    int  i, n = 0;
+    /** One timestamp per line, which always fits into the buffer of the pipe:      */
+    for (i=0; (i<iStamps) && (i<JOB_MAX_BATCH); i++) {
+        n += snprintf(&sLines[n], sizeof(sLines) - n, "%llu\n", pullStamps[i]);
+    }
+    if (pipe2(InPipe, O_CLOEXEC) != 0) return -1;
+    if (write(InPipe[1], sLines, n) != n) {
+        close(InPipe[0]);
+        close(InPipe[1]);
+        return -1;
+    }
+    /** The executable reads them up to the end of the pipe:                        */
+    close(InPipe[1]);
+    return InPipe[0];
+}
+
+/** Private Functions: **************************************************************/
+
+pid_t CSpawner::Launch(int iIn, int iOut, int iErr, int iControl, char** ppEnv) {
+    /** Variables:                                                                  */
+    pid_t                      pid;
+    int                        iFd;
+    sigset_t                   Signals;
+    posix_spawn_file_actions_t Actions;
+    /** Without limits, the executable is spawned without copying the daemon:       */
+    if ((i_CpuSeconds == 0) && (i_MemoryMb == 0) && (i_CgroupProcs < 0)) {
+        posix_spawn_file_actions_init(&Actions);
+        if (iIn >= 0) {
+            posix_spawn_file_actions_adddup2(&Actions, iIn, STDIN_FILENO);
+        }else{
+            posix_spawn_file_actions_addopen(&Actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+        }
+        posix_spawn_file_actions_adddup2(&Actions, iOut, STDOUT_FILENO);
+        if (iErr >= 0) {
+            posix_spawn_file_actions_adddup2(&Actions, iErr, STDERR_FILENO);
+        }else if (s_LogFile[0] != 0) {
+            posix_spawn_file_actions_addopen(&Actions, STDERR_FILENO, s_LogFile,
+                                             O_WRONLY | O_CREAT | O_APPEND, 0666);
+        }
+        if (iControl >= 0) posix_spawn_file_actions_adddup2(&Actions, iControl, SPAWN_CONTROL_FD);
+        if (posix_spawn(&pid, s_Path, &Actions, &Attributes, p_Argv, ppEnv) != 0) pid = -1;
+        posix_spawn_file_actions_destroy(&Actions);
+        return pid;
+    }
+    /** Otherwise the child confines itself, before the executable can fork at all: */
+    pid = fork();
+    if (pid != 0) return pid;
+    setpgid(0, 0);
+    signal(SIGPIPE, SIG_DFL);
+    sigemptyset(&Signals);
+    sigprocmask(SIG_SETMASK, &Signals, NULL);
+    if (! Confine()) _exit(126);
+    iFd = (iIn >= 0) ? iIn : open("/dev/null", O_RDONLY);
+    if ((iFd < 0) || (dup2(iFd, STDIN_FILENO) < 0) || (dup2(iOut, STDOUT_FILENO) < 0)) _exit(126);
+    iFd = (iErr >= 0) ? iErr : (s_LogFile[0] != 0) ? open(s_LogFile, O_WRONLY | O_CREAT | O_APPEND, 0666) : -1;
+    if (iFd >= 0) dup2(iFd, STDERR_FILENO);
+    if (iControl >= 0) dup2(iControl, SPAWN_CONTROL_FD);
+    execve(s_Path, p_Argv, ppEnv);
+    _exit(127);
+}
+
+bool CSpawner::Resolve(const char* sName) {
+    /** Variables:                                                                  */
+    const char* pPath;
+    const char* pEnd;
+    size_t      Len;
+    /** Names with a slash are taken as they are:                                   */
+    if (strchr(sName, '/') != 0) {
+        if (strlen(sName) >= sizeof(s_Path)) return false;
+        strcpy(s_Path, sName);
+        return (access(s_Path, F_OK) == 0);
+    }
+    /** Otherwise search the PATH once, instead of on each press:                   */
+    pPath = getenv("PATH");
+    if (pPath == 0) pPath = "/usr/local/bin:/usr/bin:/bin";
+    while (*pPath != 0) {
+        pEnd = strchr(pPath, ':');
+        Len  = (pEnd != 0) ? (size_t) (pEnd - pPath) : strlen(pPath);
+        if (snprintf(s_Path, sizeof(s_Path), "%.*s/%s", (int) Len, pPath, sName) < (int) sizeof(s_Path)) {
+            if (access(s_Path, F_OK) == 0) return true;
+        }
+        if (pEnd == 0) break;
+        pPath = pEnd + 1;
+    }
+    return false;
+}
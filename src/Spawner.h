@@ -0,0 +1,63 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/** Global Includes: ****************************************************************/
+
+#include <spawn.h>
+#include <sys/types.h>
+
+/** Local Defines: ******************************************************************/
+
+#define SPAWN_MAX_ARGS   64
+#define SPAWN_BATCH_ENV  "BUZZERD_BATCH"        // Number of presses of a batch.
+#define SPAWN_CONTROL_ENV "BUZZERD_CONTROL_FD"  // Inherited connection to the daemon.
+#define SPAWN_CONTROL_FD 3
+
+/** Class Definition: ***************************************************************/
+
+class CSpawner {
+public:
+    // Methods:
+    CSpawner();
+    ~CSpawner();
+    bool  Prepare(const char* sExecutable, const char* sLogFile);
+    void  Limit  (int iCpuSeconds, int iMemoryMb, int iCgroupProcs);
+    bool  Confine();
+    pid_t Spawn  (int* pOutput, const unsigned long long* pullStamps, int iStamps, int iControl);
+    pid_t SpawnWorker(int* pStdin, int* pStdout);
+    static int BatchInput(const unsigned long long* pullStamps, int iStamps);
+private:
+    // Properties:
+    bool                       b_Prepared;
+    char                       s_Path   [1024];
+    char                       s_Args   [1024];
+    char                       s_LogFile[1024];
+    char*                      p_Argv   [SPAWN_MAX_ARGS + 2];
+    char**                     p_Env;
+    int                        i_Env;
+    char                       s_Batch  [32];
+    char                       s_Control[32];
+    int                        i_CpuSeconds;    // 0 without a limit.
+    int                        i_MemoryMb;
+    int                        i_CgroupProcs;   // cgroup.procs or -1.
+    posix_spawnattr_t          Attributes;
+    // Methods:
+    pid_t Launch (int iIn, int iOut, int iErr, int iControl, char** ppEnv);
+    bool  Resolve(const char* sName);
+};
@@ -0,0 +1,122 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+
+/** Global Includes: ****************************************************************/
+
+#include <string.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "StatusPage.h"
+
+/** Public Functions: ***************************************************************/
+
+CStatusPage::CStatusPage() {
+    memset(&Status, 0, sizeof(Status));
+    p_Page    = 0;
+    s_File[0] = 0;
+}
+
+CStatusPage::~CStatusPage() {
+    Close();
+}
+
+bool CStatusPage::Open(const char* sFile) {
+    /** Variables:                                                                  */
+    int   iFd;
+    void* pMap;
+    Close();
+    if (strlen(sFile) >= sizeof(s_File)) return false;
+    /** A page left by a crashed daemon is simply taken over:                       */
+    iFd = open(sFile, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (iFd < 0) return false;
+    if (ftruncate(iFd, sizeof(SStatusPage)) != 0) {
+        close(iFd);
+        return false;
+    }
+    pMap = mmap(0, sizeof(SStatusPage), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, iFd, 0);
+    close(iFd);
+    if (pMap == MAP_FAILED) return false;
+    p_Page = (SStatusPage*) pMap;
+    strcpy(s_File, sFile);
+    /** Readers check the magic last, so it is written after the rest:              */
+    p_Page->ui_Seq.store(0, std::memory_order_relaxed);
+    p_Page->ui_Version = STATUS_VERSION;
+    p_Page->ui_Size    = sizeof(SStatus);
+    Publish();
+    std::atomic_thread_fence(std::memory_order_release);
+    p_Page->ui_Magic   = STATUS_MAGIC;
+    return true;
+}
+
+void CStatusPage::Close() {
+    if (p_Page == 0) return;
+    munmap(p_Page, sizeof(SStatusPage));
+    unlink(s_File);
+    p_Page = 0;
+}
+
+void CStatusPage::Publish() {
+    unsigned int uiSeq;
+    if (p_Page == 0) return;
+    /** The daemon is the only writer, so the seq needs no read-modify-write:       */
+    uiSeq = p_Page->ui_Seq.load(std::memory_order_relaxed);
+    p_Page->ui_Seq.store(uiSeq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&p_Page->Status, &Status, sizeof(Status));
+    p_Page->ui_Seq.store(uiSeq + 2, std::memory_order_release);
+}
+
+bool CStatusPage::Read(const char* sFile, SStatus* pStatus) {
+    /** Variables:                                                                  */
+    int          i, iFd;
+    void*        pMap;
+    SStatusPage* pPage;
+    unsigned int uiSeq;
+    bool         bRead = false;
+    struct stat  Stat;
+    /** A page of another size has another layout:                                  */
+    iFd = open(sFile, O_RDONLY | O_CLOEXEC);
+    if (iFd < 0) return false;
+    if ((fstat(iFd, &Stat) != 0) || (Stat.st_size != sizeof(SStatusPage))) {
+        close(iFd);
+        return false;
+    }
+    pMap = mmap(0, sizeof(SStatusPage), PROT_READ, MAP_SHARED, iFd, 0);
+    close(iFd);
+    if (pMap == MAP_FAILED) return false;
+    pPage = (SStatusPage*) pMap;
+    /** Retry, while the daemon is writing, but never wait for it forever:          */
+    for (i=0; (i<1000) && (! bRead); i++) {
+        uiSeq = pPage->ui_Seq.load(std::memory_order_acquire);
+        if ((uiSeq & 1) == 0) {
+            memcpy(pStatus, &pPage->Status, sizeof(SStatus));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            bRead = (pPage->ui_Seq.load(std::memory_order_relaxed) == uiSeq);
+        }
+        if (! bRead) sched_yield();
+    }
+    bRead = bRead && (pPage->ui_Magic == STATUS_MAGIC) && (pPage->ui_Version == STATUS_VERSION);
+    munmap(pMap, sizeof(SStatusPage));
+    return bRead;
+}
@@ -0,0 +1,92 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+
+/** Notes: *************************************************************************** 
+
+Status of the daemon in a small file in /dev/shm, which monitors map and read at any
+rate without a round-trip via the control-socket and without any load on the daemon.
+The page has a fixed layout of naturally aligned fields and is protected by a
+seqlock: the daemon makes the seq odd, writes the fields and makes it even again, a
+reader copies the fields between two reads of the same, even seq, else it retries.
+So a reader never blocks the daemon and never sees a half-written page. Once mapped,
+reading takes no system-call at all. All timestamps are CLOCK_REALTIME in ns, 0 if
+there was no such event yet. The page is removed, when the daemon shuts down.
+
+*************************************************************************************/
+
+/** Global Includes: ****************************************************************/
+
+#include <atomic>
+
+/** Local Defines: ******************************************************************/
+
+#define STATUS_MAGIC     0x425A5331U            // "BZS1"
+#define STATUS_VERSION   2                      // Raised, whenever the layout changes.
+
+/** Type-Definitions: ***************************************************************/
+
+struct SStatus {
+    int                i_Pid;
+    int                i_Queued;                // Jobs waiting in the queues.
+    int                i_Running;
+    int                i_LastCode;              // Exit-code of the last finished job.
+    unsigned int       ui_LastPin;              // Pin and gesture of the last press.
+    unsigned int       ui_LastGesture;
+    unsigned long long ull_Started;             // Start of the daemon.
+    unsigned long long ull_Updated;             // Last iteration of the main-loop.
+    unsigned long long ull_LastPress;
+    unsigned long long ull_LastFinish;
+    unsigned long long ull_Generation;          // Of the applied configuration.
+    unsigned long long ull_Presses;
+    unsigned long long ull_Jobs;                // Started jobs.
+    unsigned long long ull_Failed;
+    unsigned long long ull_TimedOut;
+    unsigned long long ull_Killed;
+    unsigned long long ull_Dropped;
+    char               s_Led[256];              // LED-mode or its pattern.
+    int                i_Held;                  // Presses held back by full queues.
+};
+
+struct SStatusPage {
+    unsigned int              ui_Magic;
+    unsigned int              ui_Version;
+    std::atomic<unsigned int> ui_Seq;           // Odd, while the daemon writes.
+    unsigned int              ui_Size;          // Of the status, newer fields are appended.
+    SStatus                   Status;
+};
+
+/** Class Definition: ***************************************************************/
+
+class CStatusPage {
+public:
+    // Properties:
+    SStatus      Status;                        // Updated freely, published as a whole.
+    // Methods:
+    CStatusPage();
+    ~CStatusPage();
+    bool Open        (const char* sFile);
+    void Close       ();
+    void Publish     ();
+    static bool Read (const char* sFile, SStatus* pStatus);
+private:
+    // Properties:
+    SStatusPage* p_Page;
+    char         s_File[256];
+};
@@ -0,0 +1,246 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/** Global Includes: ****************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <syslog.h>
+#include <sys/wait.h>
+#include <sys/epoll.h>
+
+#include "Spawner.h"
+#include "WorkerPool.h"
+
+/** Local Defines: ******************************************************************/
+
+#define BACKOFF_MIN_MS   100
+#define BACKOFF_MAX_MS   30000
+
+/** Local Functions: ****************************************************************/
+
+static unsigned long long Now() {
+    struct timespec Time;
+    clock_gettime(CLOCK_MONOTONIC, &Time);
+    return (unsigned long long) Time.tv_sec * 1000000000ULL + Time.tv_nsec;
+}
+
+/** Public Functions: ***************************************************************/
+
+CWorkerPool::CWorkerPool() {
+    p_Spawner   = 0;
+    i_Workers   = 0;
+    i_EpollFd   = -1;
+    ui_EpollTag = 0;
+}
+
+CWorkerPool::~CWorkerPool() {
+    Stop();
+}
+
+void CWorkerPool::SetEpoll(int iEpollFd, unsigned int uiTag) {
+    /** The stdout of each started worker gets registered at this event-loop:       */
+    i_EpollFd   = iEpollFd;
+    ui_EpollTag = uiTag;
+}
+
+void CWorkerPool::Start(CSpawner* pSpawner, int iWorkers) {
+    /** Variables:                                                                  */
+    int i;
+    /** Pre-warm the configured number of workers:                                  */
+    Stop();
+    p_Spawner = pSpawner;
+    i_Workers = (iWorkers < 1) ? 1 : ((iWorkers > POOL_MAX_WORKERS) ? POOL_MAX_WORKERS : iWorkers);
+    for (i=0; i<i_Workers; i++) {
+        memset(&Workers[i], 0, sizeof(SWorker));
+        Workers[i].pid        = -1;
+        Workers[i].i_In       = -1;
+        Workers[i].i_Out      = -1;
+        Workers[i].ui_Backoff = BACKOFF_MIN_MS;
+        Launch(&Workers[i]);
+    }
+}
+
+void CWorkerPool::Stop() {
+    /** Variables:                                                                  */
+    int i;
+    /** Closing stdin asks the workers to quit, SIGTERM makes sure of it:           */
+    for (i=0; i<i_Workers; i++) {
+        if (Workers[i].pid > 0) kill(Workers[i].pid, SIGTERM);
+        Retire(&Workers[i]);
+    }
+    i_Workers = 0;
+}
+
+bool CWorkerPool::HasIdle() {
+    /** Variables:                                                                  */
+    int i;
+    /** Check for a running worker, which waits for a press:                        */
+    for (i=0; i<i_Workers; i++) {
+        if ((Workers[i].pid > 0) && (! Workers[i].b_Busy)) return true;
+    }
+    return false;
+}
+
+bool CWorkerPool::Dispatch(unsigned long ulSeq, unsigned long long ullTimestamp, int iPresses) {
+    /** Variables:                                                                  */
+    char    sRecord[64];
+    int     i, iLen;
+    SWorker *pWorker;
+    /** Pass the press to the first idle worker:                                    */
+    for (i=0; i<i_Workers; i++) {
+        pWorker = &Workers[i];
+        if ((pWorker->pid <= 0) || (pWorker->b_Busy)) continue;
+        iLen = snprintf(sRecord, sizeof(sRecord), "%lu %llu %i\n", ulSeq, ullTimestamp, iPresses);
+        /** The record is smaller than PIPE_BUF, so it is written at once or not:   */
+        if (write(pWorker->i_In, sRecord, iLen) != iLen) {
+            syslog(LOG_WARNING | LOG_DAEMON, "FAILURE PASSING PRESS %lu TO WORKER %i!", ulSeq, pWorker->pid);
+            kill(pWorker->pid, SIGTERM);
+            Retire(pWorker);
+            continue;
+        }
+        pWorker->b_Busy = true;
+        pWorker->ul_Seq = ulSeq;
+        return true;
+    }
+    return false;
+}
+
+int CWorkerPool::HandleFd(int iFd, unsigned long* pSeqs, int* pCodes, int iMax) {
+    /** Variables:                                                                  */
+    int     i, n, iReplies = 0;
+    char    sBuffer[POOL_LINE_SIZE];
+    ssize_t RxLen;
+    SWorker *pWorker;
+    /** Find the worker of this descriptor:                                         */
+    pWorker = 0;
+    for (i=0; i<i_Workers; i++) {
+        if (Workers[i].i_Out == iFd) pWorker = &Workers[i];
+    }
+    if (pWorker == 0) return 0;
+    /** Read, what it replied, or retire it, if it is gone:                         */
+    RxLen = read(pWorker->i_Out, sBuffer, sizeof(sBuffer));
+    if ((RxLen < 0) && (errno == EAGAIN)) return 0;
+    if (RxLen <= 0) {
+        syslog(LOG_WARNING | LOG_DAEMON, "Worker %i terminated, restarting in %u ms.",
+               pWorker->pid, pWorker->ui_Backoff);
+        if ((pWorker->b_Busy) && (iReplies < iMax)) {
+            pSeqs [iReplies] = pWorker->ul_Seq;
+            pCodes[iReplies] = -1;
+            iReplies++;
+        }
+        Retire(pWorker);
+        return iReplies;
+    }
+    /** Each complete line is the reply to the pending press:                       */
+    for (n=0; n<RxLen; n++) {
+        if (sBuffer[n] != '\n') {
+            if (pWorker->i_LineLen < POOL_LINE_SIZE - 1) pWorker->s_Line[pWorker->i_LineLen++] = sBuffer[n];
+            continue;
+        }
+        pWorker->s_Line[pWorker->i_LineLen] = 0;
+        pWorker->i_LineLen = 0;
+        if ((! pWorker->b_Busy) || (iReplies >= iMax)) continue;
+        pSeqs [iReplies]    = pWorker->ul_Seq;
+        pCodes[iReplies]    = atoi(pWorker->s_Line);
+        pWorker->b_Busy     = false;
+        pWorker->ui_Backoff = BACKOFF_MIN_MS;
+        iReplies++;
+    }
+    return iReplies;
+}
+
+int CWorkerPool::NextRestart() {
+    /** Variables:                                                                  */
+    int i;
+    unsigned long long ullNow, ullNext = 0;
+    /** Find the earliest pending restart, -1 means none is pending:                */
+    for (i=0; i<i_Workers; i++) {
+        if (Workers[i].pid > 0) continue;
+        if ((ullNext == 0) || (Workers[i].ull_Restart < ullNext)) ullNext = Workers[i].ull_Restart;
+    }
+    if (ullNext == 0) return -1;
+    ullNow = Now();
+    if (ullNext <= ullNow) return 0;
+    /** Round up, so the loop does not wake up just before it is due:               */
+    return (int) ((ullNext - ullNow + 999999ULL) / 1000000ULL);
+}
+
+pid_t CWorkerPool::FindWorker(unsigned long ulSeq) {
+    /** Variables:                                                                  */
+    int i;
+    /** The worker, which is busy with this press, -1 if none is:                   */
+    for (i=0; i<i_Workers; i++) {
+        if ((Workers[i].b_Busy) && (Workers[i].pid > 0) && (Workers[i].ul_Seq == ulSeq)) return Workers[i].pid;
+    }
+    return -1;
+}
+
+void CWorkerPool::Service() {
+    /** Variables:                                                                  */
+    int i;
+    /** Restart the crashed workers, once their back-off has expired:               */
+    for (i=0; i<i_Workers; i++) {
+        if ((Workers[i].pid <= 0) && (Now() >= Workers[i].ull_Restart)) Launch(&Workers[i]);
+    }
+}
+
+/** Private Functions: **************************************************************/
+
+void CWorkerPool::Launch(SWorker* pWorker) {
+    /** Variables:                                                                  */
+    struct epoll_event Event;
+    /** Start the worker with pipes on its stdin and stdout:                        */
+    pWorker->b_Busy    = false;
+    pWorker->i_LineLen = 0;
+    pWorker->pid       = p_Spawner->SpawnWorker(&pWorker->i_In, &pWorker->i_Out);
+    if (pWorker->pid > 0) {
+        /** Let the event-loop wake up on its replies:                              */
+        if (i_EpollFd < 0) return;
+        memset(&Event, 0, sizeof(Event));
+        Event.events   = EPOLLIN;
+        Event.data.u64 = ((unsigned long long) ui_EpollTag << 32) | (unsigned int) pWorker->i_Out;
+        epoll_ctl(i_EpollFd, EPOLL_CTL_ADD, pWorker->i_Out, &Event);
+        return;
+    }
+    /** If it failed, try again later with a doubled back-off:                      */
+    syslog(LOG_ERR | LOG_DAEMON, "FAILURE STARTING A WORKER!");
+    Retire(pWorker);
+}
+
+void CWorkerPool::Retire(SWorker* pWorker) {
+    /** Close the pipes and collect the process, if it has already gone:            */
+    if (pWorker->i_In  >= 0) close(pWorker->i_In);
+    if ((pWorker->i_Out >= 0) && (i_EpollFd >= 0)) epoll_ctl(i_EpollFd, EPOLL_CTL_DEL, pWorker->i_Out, 0);
+    if (pWorker->i_Out >= 0) close(pWorker->i_Out);
+    if (pWorker->pid   >  0) waitpid(pWorker->pid, 0, WNOHANG);
+    pWorker->i_In        = -1;
+    pWorker->i_Out       = -1;
+    pWorker->pid         = -1;
+    pWorker->b_Busy      = false;
+    pWorker->ull_Restart = Now() + (unsigned long long) pWorker->ui_Backoff * 1000000ULL;
+    pWorker->ui_Backoff *= 2;
+    if (pWorker->ui_Backoff > BACKOFF_MAX_MS) pWorker->ui_Backoff = BACKOFF_MAX_MS;
+}
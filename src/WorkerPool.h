@@ -0,0 +1,82 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/** Notes: *************************************************************************** 
+
+A persistent worker is started once and reads one record per press from its stdin:
+
+  <job-id> <timestamp in ns> <presses>\n
+
+It has to answer each record with one line on its stdout, which starts with the
+result-code of the press (0 for success). Its stderr is appended to the log-file.
+
+*************************************************************************************/
+
+/** Global Includes: ****************************************************************/
+
+#include <sys/types.h>
+
+/** Local Defines: ******************************************************************/
+
+#define POOL_MAX_WORKERS 16
+#define POOL_LINE_SIZE   256
+
+/** Type-Definitions: ***************************************************************/
+
+struct SWorker {
+    pid_t              pid;
+    int                i_In;
+    int                i_Out;
+    bool               b_Busy;
+    unsigned long      ul_Seq;
+    unsigned long long ull_Restart;
+    unsigned int       ui_Backoff;
+    char               s_Line[POOL_LINE_SIZE];
+    int                i_LineLen;
+};
+
+/** Class Definition: ***************************************************************/
+
+class CSpawner;
+
+class CWorkerPool {
+public:
+    // Methods:
+    CWorkerPool();
+    ~CWorkerPool();
+    void SetEpoll  (int iEpollFd, unsigned int uiTag);
+    void Start     (CSpawner* pSpawner, int iWorkers);
+    void Stop      ();
+    bool HasIdle   ();
+    bool Dispatch  (unsigned long ulSeq, unsigned long long ullTimestamp, int iPresses);
+    int  HandleFd  (int iFd, unsigned long* pSeqs, int* pCodes, int iMax);
+    int  NextRestart();
+    pid_t FindWorker(unsigned long ulSeq);
+    void Service   ();
+private:
+    // Properties:
+    CSpawner*          p_Spawner;
+    int                i_Workers;
+    int                i_EpollFd;
+    unsigned int       ui_EpollTag;
+    SWorker            Workers[POOL_MAX_WORKERS];
+    // Methods:
+    void Launch    (SWorker* pWorker);
+    void Retire    (SWorker* pWorker);
+};
@@ -43,14 +43,37 @@ void ShowHelp();
 
 int main (int argc, char **argv) {
     /** Variables:                                                                  */
-    int iResult;
-    /** Check, if the deamon shall be started:                                      */
-    if (argc == 1) {
-        if (CheckSocket()) {
+    int iResult, i;
+    bool bDemon = true, bForeground = false;
+    const char* sConfigFile = "/etc/buzzerd.conf";
+    const char* sTrace      = 0;
+    /** Check, if the deamon shall be started, optionally with another config:      */
+    for (i=1; (i<argc) && (bDemon); i++) {
+        if (strcmp(argv[i], "-f") == 0) {
+            bForeground = true;
+        }else if ((strcmp(argv[i], "-c") == 0) && (i+1 < argc)) {
+            sConfigFile = argv[++i];
+        }else if ((strcmp(argv[i], "-t") == 0) && (i+1 < argc)) {
+            sTrace = argv[++i];
+        }else{
+            bDemon = false;
+        }
+    }
+    if ((bDemon) && (sTrace != 0)) {
+        /** A trace is replayed offline, a running daemon does not matter:          */
+        iResult = RunReplay(sConfigFile, sTrace);
+        if (iResult == 0) {
+            return (EXIT_SUCCESS);
+        }
+        return iResult;
+    }
+    if (bDemon) {
+        /** A socket of the service-manager is taken over, even if it is in use:    */
+        if ((getenv("LISTEN_FDS") == 0) && (CheckSocket())) {
             printf ("ERR: Deamon already running!\n");
             return -1;
         }
-        iResult = RunDemon();
+        iResult = RunDemon(sConfigFile, bForeground);
         if (iResult == 0) {
             return (EXIT_SUCCESS);
         }
@@ -74,4 +97,6 @@ int main (int argc, char **argv) {
 
 void ShowHelp(){
     printf("\nUsage:\n  BuzzerD -d <executable> [alive|on|off|success] [--debug]\n");
+    printf("  BuzzerD [-f] [-c <configuration-file>]\n");
+    printf("  BuzzerD -t <trace> [-c <configuration-file>]\n");
 }
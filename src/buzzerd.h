@@ -0,0 +1,117 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+
+/** Notes: *************************************************************************** 
+
+Header-only client-library for the executables of the daemon, usable from C and C++.
+Each job inherits a connection to the daemon, whose descriptor is given in the
+environment-variable BUZZERD_CONTROL_FD. The functions below send their command as
+one line over it, which costs a single send() instead of starting "buzzerd" and
+connecting to its socket. The daemon never answers these commands, so they never
+wait for it. All functions return 0 on success and -1 with errno set otherwise,
+e.g. ENOTCONN, if the executable was not started by the daemon.
+
+  BuzzerdLed("off");             switches the LED-mode like "buzzerd -l off"
+  BuzzerdProgress("%i %%", 50);  is published to the subscribers as "progress"
+  BuzzerdResult(3);              replaces the exit-code of the job
+  BuzzerdCommand("-x <exe>");    sends any other command of the control-socket
+
+A shell-script writes the same lines directly, e.g. echo "progress 50 %" >&3.
+
+*************************************************************************************/
+
+/** Global Includes: ****************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+
+/** Local Defines: ******************************************************************/
+
+#define BUZZERD_CONTROL_ENV  "BUZZERD_CONTROL_FD"
+#define BUZZERD_LINE_SIZE    1024               // Same as CTRL_LINE_SIZE of the daemon.
+
+/** Public Functions: ***************************************************************/
+
+static inline int BuzzerdFd(void) {
+    static int iFd = -2;
+    const char* sFd;
+    /** The environment is read once, the descriptor never changes:                 */
+    if (iFd == -2) {
+        sFd = getenv(BUZZERD_CONTROL_ENV);
+        iFd = ((sFd != 0) && (sFd[0] >= '0') && (sFd[0] <= '9')) ? atoi(sFd) : -1;
+    }
+    return iFd;
+}
+
+static inline int BuzzerdSend(const char* sPrefix, const char* sFormat, va_list Args) {
+    char    sLine[BUZZERD_LINE_SIZE];
+    int     i, iLen;
+    ssize_t TxLen;
+    if (BuzzerdFd() < 0) {
+        errno = ENOTCONN;
+        return -1;
+    }
+    /** Format the command as one line, a line-break within would split it:         */
+    iLen = snprintf(sLine, sizeof(sLine), "%s", sPrefix);
+    iLen += vsnprintf(&sLine[iLen], sizeof(sLine) - iLen, sFormat, Args);
+    if (iLen >= (int) sizeof(sLine) - 1) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+    for (i=0; i<iLen; i++) {
+        if ((sLine[i] == '\n') || (sLine[i] == '\r')) sLine[i] = ' ';
+    }
+    sLine[iLen++] = '\n';
+    /** A daemon, which is gone, must not kill the job via SIGPIPE:                 */
+    do {
+        TxLen = send(BuzzerdFd(), sLine, iLen, MSG_NOSIGNAL);
+    } while ((TxLen < 0) && (errno == EINTR));
+    return (TxLen == iLen) ? 0 : -1;
+}
+
+static inline int BuzzerdCommand(const char* sFormat, ...) {
+    va_list Args;
+    int     iResult;
+    va_start(Args, sFormat);
+    iResult = BuzzerdSend("", sFormat, Args);
+    va_end(Args);
+    return iResult;
+}
+
+static inline int BuzzerdProgress(const char* sFormat, ...) {
+    va_list Args;
+    int     iResult;
+    va_start(Args, sFormat);
+    iResult = BuzzerdSend("progress ", sFormat, Args);
+    va_end(Args);
+    return iResult;
+}
+
+static inline int BuzzerdLed(const char* sMode) {
+    return BuzzerdCommand("-l %s", sMode);
+}
+
+static inline int BuzzerdResult(int iCode) {
+    return BuzzerdCommand("result %i", iCode);
+}
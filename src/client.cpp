@@ -19,17 +19,30 @@
 /** Global Includes: ****************************************************************/
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <poll.h>
 #include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
 
 #include "client.h"
+#include "Gestures.h"
+#include "StatusPage.h"
 
 /** Local Defines: ******************************************************************/
 
 #define BUFFFERSIZE 1024
 #define SOCK_FILE (char*) "/tmp/BuzzerD.sock"
+#define STATUS_FILE (char*) "/dev/shm/BuzzerD.status"
+
+/** Forward Declarations: ***********************************************************/
+
+void ShowRuns(int iSocketID);
+int  ShowStatus();
 
 /** Main-Function: ******************************************************************/
 
@@ -37,11 +50,14 @@ int RunClient (int argc, char **argv) {
     int    iSocketID;
     char   Buffer [BUFFFERSIZE];
     struct sockaddr_un SocketAddress;
-    int    i, RxLen;
+    int    i, RxLen, Len;
     
     /** Check, that there is at least one argument:                                 */
     if (argc < 2) return -1;
     
+    /** The status is read from its page, the daemon is not bothered at all:        */
+    if (strcmp(argv[1], "-S") == 0) return ShowStatus();
+    
     /** Prepare Buffer with full argument:                                          */
     strcpy(Buffer, argv[1]);
     for (i=1; i<(argc-1); i++) {
@@ -55,17 +71,38 @@ int RunClient (int argc, char **argv) {
         return -2;
     }
     SocketAddress.sun_family = AF_LOCAL;
-    strcpy(SocketAddress.sun_path, SOCK_FILE);
+    strncpy(SocketAddress.sun_path, GetSocketFile(), sizeof(SocketAddress.sun_path) - 1);
     
     /** Try to connect:                                                             */
     if (connect ( iSocketID, (struct sockaddr *) &SocketAddress, sizeof (SocketAddress)) == 0) {
-        /** If connected, send the command:                                         */
+        /** If connected, send the command as one line:                             */
+        strcat(Buffer, "\n");
         send(iSocketID, Buffer, strlen (Buffer), 0);
-        /** Try to receive the reply:                                               */
-        RxLen = recv (iSocketID, Buffer, sizeof(Buffer)-1, 0);            
-        if( RxLen > 0) {
-            Buffer[RxLen] = 0;
+        /** The history of the runs is answered with several lines:                 */
+        if (strcmp(argv[1], "-r") == 0) {
+            ShowRuns(iSocketID);
+            close (iSocketID);
+            return 0;
+        }
+        /** Try to receive the reply, which is one line as well:                    */
+        Len = 0;
+        while ((Len < (int) sizeof(Buffer)-1) && ((Len == 0) || (Buffer[Len-1] != '\n'))) {
+            RxLen = recv (iSocketID, &Buffer[Len], sizeof(Buffer)-1-Len, 0);
+            if (RxLen <= 0) break;
+            Len += RxLen;
+        }
+        if( Len > 0) {
+            if (Buffer[Len-1] == '\n') Len--;
+            Buffer[Len] = 0;
             printf ("BuzzerD: %s\n", Buffer);
+            /** A subscription streams the events, until the daemon hangs up:       */
+            if (strcmp(argv[1], "subscribe") == 0) {
+                fflush(stdout);
+                while ((RxLen = recv (iSocketID, Buffer, sizeof(Buffer), 0)) > 0) {
+                    fwrite(Buffer, 1, RxLen, stdout);
+                    fflush(stdout);
+                }
+            }
         }else{
             printf ("ERR: No reply received from deamon!\n");
         }
@@ -76,6 +113,86 @@ int RunClient (int argc, char **argv) {
     return 0;
 }
 
+/** Print the history of the runs, which the daemon sends line by line:             */
+
+void ShowRuns(int iSocketID){
+    FILE*              fp;
+    char*              sLine = 0;
+    size_t             Size  = 0;
+    int                i, iCount, iPos;
+    unsigned long      ulId, ulBytes;
+    unsigned long long ullStarted, ullFinished;
+    int                iExitCode;
+    char*              p;
+    char               cLast;
+    
+    /** Read the header with the number of runs:                                    */
+    fp = fdopen(dup(iSocketID), "r");
+    if (fp == 0) return;
+    if ((getline(&sLine, &Size, fp) <= 0) || (sscanf(sLine, "%i", &iCount) != 1)) {
+        printf ("ERR: No reply received from deamon!\n");
+        iCount = 0;
+    }else{
+        printf ("BuzzerD: %s", sLine);
+    }
+    /** Print each run with its unescaped output:                                   */
+    for (i=0; i<iCount; i++) {
+        if (getline(&sLine, &Size, fp) <= 0) break;
+        if (sscanf(sLine, "run %lu %llu %llu %i %lu %n", &ulId, &ullStarted, &ullFinished,
+                   &iExitCode, &ulBytes, &iPos) < 5) {
+            printf ("%s", sLine);
+            continue;
+        }
+        printf ("Run %lu exited with code %i after %llu ms, %lu bytes of output:\n", ulId, iExitCode,
+                (ullFinished - ullStarted) / 1000000ULL, ulBytes);
+        cLast = '\n';
+        for (p=&sLine[iPos]; (*p != 0) && (*p != '\n'); p++) {
+            if      ((*p == '\\') && (p[1] == 'n'))  { cLast = '\n';  p++; }
+            else if ((*p == '\\') && (p[1] == 't'))  { cLast = '\t';  p++; }
+            else if ((*p == '\\') && (p[1] == '\\')) { cLast = '\\'; p++; }
+            else cLast = *p;
+            putchar(cLast);
+        }
+        if (cLast != '\n') putchar('\n');
+    }
+    free(sLine);
+    fclose(fp);
+}
+
+/** Print the status-page of the daemon in one line, the ages in ms:                */
+
+int ShowStatus(){
+    SStatus            Status;
+    struct timespec    Time;
+    unsigned long long ullNow;
+    if (! CStatusPage::Read(GetStatusFile(), &Status)) {
+        printf ("ERR: Unable to read the status-page %s!\n", GetStatusFile());
+        return -2;
+    }
+    /** A page, which was left by a crashed daemon, is not its status:              */
+    if ((kill(Status.i_Pid, 0) != 0) && (errno == ESRCH)) {
+        printf ("ERR: Deamon with PID %i is not running!\n", Status.i_Pid);
+        return -2;
+    }
+    clock_gettime(CLOCK_REALTIME, &Time);
+    ullNow = (unsigned long long) Time.tv_sec * 1000000000ULL + Time.tv_nsec;
+    printf ("BuzzerD: pid=%i led=%s queued=%i held=%i running=%i presses=%llu jobs=%llu failed=%llu timed_out=%llu "
+            "killed=%llu dropped=%llu config=%llu uptime_ms=%llu updated_ms=%llu", Status.i_Pid, Status.s_Led,
+            Status.i_Queued, Status.i_Held, Status.i_Running, Status.ull_Presses, Status.ull_Jobs, Status.ull_Failed,
+            Status.ull_TimedOut, Status.ull_Killed, Status.ull_Dropped, Status.ull_Generation,
+            (ullNow - Status.ull_Started) / 1000000ULL, (ullNow - Status.ull_Updated) / 1000000ULL);
+    if (Status.ull_LastPress != 0) {
+        printf (" last_press=%u/%s last_press_ms=%llu", Status.ui_LastPin,
+                (Status.ui_LastGesture < GESTURE_COUNT) ? CGestures::Name(Status.ui_LastGesture) : "unknown",
+                (ullNow - Status.ull_LastPress) / 1000000ULL);
+    }
+    if (Status.ull_LastFinish != 0) {
+        printf (" last_code=%i last_finish_ms=%llu", Status.i_LastCode, (ullNow - Status.ull_LastFinish) / 1000000ULL);
+    }
+    printf ("\n");
+    return 0;
+}
+
 /** Check function to avoid multiple instances:                                     */
 
 bool CheckSocket(){
@@ -86,7 +203,7 @@ bool CheckSocket(){
     /** Setup socket:                                                               */
     if((iSocketID=socket (PF_LOCAL, SOCK_STREAM, 0)) == 0) return false;
     SocketAddress.sun_family = AF_LOCAL;
-    strcpy(SocketAddress.sun_path, SOCK_FILE);
+    strncpy(SocketAddress.sun_path, GetSocketFile(), sizeof(SocketAddress.sun_path) - 1);
     
     /** Try to connect:                                                             */
     if (connect ( iSocketID, (struct sockaddr *) &SocketAddress, sizeof (SocketAddress)) == 0) {
@@ -99,3 +216,21 @@ bool CheckSocket(){
     close (iSocketID);
     return bResult;
 }
+
+/** Path of the control-socket, which may be overridden for tests and benchmarks:   */
+
+const char* GetSocketFile(){
+    const char* sSocketFile;
+    sSocketFile = getenv("BUZZERD_SOCKET");
+    if ((sSocketFile == 0) || (sSocketFile[0] == 0)) return SOCK_FILE;
+    return sSocketFile;
+}
+
+/** Path of the status-page, which may be overridden like the socket:               */
+
+const char* GetStatusFile(){
+    const char* sStatusFile;
+    sStatusFile = getenv("BUZZERD_STATUS");
+    if ((sStatusFile == 0) || (sStatusFile[0] == 0)) return STATUS_FILE;
+    return sStatusFile;
+}
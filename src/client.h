@@ -20,3 +20,5 @@
 
 int RunClient (int argc, char **argv);
 bool CheckSocket();
+const char* GetSocketFile();
+const char* GetStatusFile();
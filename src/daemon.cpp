@@ -19,81 +19,274 @@
 /** Global Includes: ****************************************************************/
 
 #include <stdio.h>
-#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <sys/time.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <sys/inotify.h>
 #include <arpa/inet.h>
-#include <poll.h>
 #include <unistd.h>
 #include <syslog.h>
 #include <signal.h>
-#include <bcm2835.h>
+#include <time.h>
+#include <stdarg.h>
+#include <stddef.h>
 
 #include "daemon.h"
 #include "ConfigHandler.h"
+#include "GpioBackend.h"
+#include "Spawner.h"
+#include "WorkerPool.h"
+#include "JobQueue.h"
+#include "PressRing.h"
+#include "Gestures.h"
+#include "InputThread.h"
+#include "LedSequencer.h"
+#include "Journal.h"
+#include "ControlServer.h"
+#include "RunLog.h"
+#include "Metrics.h"
+#include "Network.h"
+#include "StatusPage.h"
+#include "client.h"
 
 /** Local Defines: ******************************************************************/
 
-#define PIN_LED         RPI_V2_GPIO_P1_37
-#define PIN_BTN         RPI_V2_GPIO_P1_12
-#define SOCK_FILE       (char*) "/tmp/BuzzerD.sock"
+#define MAX_EVENTS      16
+
+#define EV_SERVER       1
+#define EV_BUTTON       2
+#define EV_SIGNAL       3
+#define EV_SAMPLE       4
+#define EV_LED          5
+#define EV_WORKER       6
+#define EV_CLIENT       7
+#define EV_OUTPUT       8
+#define EV_METRICS      9
+#define EV_CONFIG       10
+#define EV_GESTURE      11
+#define EV_BATCH        12
+#define EV_TIMEOUT      13
+#define EV_INPUT        14
+#define EV_NETWORK      15
+
+#define LISTEN_FDS_START 3                      // First socket of the service-manager.
+
+/** Type-Definitions: ***************************************************************/
+
+/** Each button has its own queue and executable, which are kept as its action:     */
+
+struct SAction {
+    CJobQueue          Jobs;
+    CSpawner           Spawner;
+    CWorkerPool        Pool;
+    unsigned int       ui_JournalPin;           // Key of its presses in the journal.
+    unsigned char      ub_JournalGesture;
+    unsigned long      ul_Journaled;            // Drops already journaled.
+};
+
+/** Several gestures of a button share its pin and LED:                             */
+
+struct SLed {
+    bool               b_LastResult;
+    int                i_LastCode;
+};
+
+/** A replay finishes its runs in the order of the exits, which were recorded:      */
+
+struct SReplayRun {
+    int                i_Action;
+    unsigned long      ul_Job;
+};
 
 /** Global Variables: ***************************************************************/
 
+extern char**           environ;
 CConfigHandler          Config;
-volatile bool           b_Alive;
-volatile bool           b_LastResult;
-volatile bool           b_ExecRunning;
-volatile unsigned char  ub_BuzzCount;
-volatile pid_t          p_ClientPid;
-pthread_mutex_t         mutex_BuzzCount; 
+SConfig                 Applied;
+unsigned long           ul_LedChanges;          // Overrides of the LED, which are applied.
+CGpioBackend*           Gpio;
+SAction                 Actions[CONFIG_MAX_BUTTONS];
+SLed                    Leds[CONFIG_MAX_BUTTONS];
+int                     i_Leds;
+int                     i_LedOfAction[CONFIG_MAX_BUTTONS];
+int                     i_ActionOfPin[CONFIG_MAX_PIN][GESTURE_COUNT];
+CPressRing              Presses;
+CGestures               Gestures;
+CInputThread            Input;
+CJournal                Journal;
+unsigned long long      ull_GestureDue;
+CLedSequencer           Sequencer;
+SLedPattern             LedOn, LedOff, LedMode, LedBusy, LedFailure, LedTimeout;
+bool                    b_FailureCode;
+unsigned long long      ull_LedDue;
+unsigned long long      ull_BatchDue;
+unsigned long long      ull_TimeoutDue;
+CControlServer          Control;
+CRunLog                 Runs;
+CMetrics                Metrics;
+CNetwork                Network;
+CStatusPage             StatusPage;
+bool                    b_EventInput;
+bool                    b_Alive;
+CGpioTrace*             p_Replay;               // Only set, while a trace is replayed.
+SReplayRun              ReplayRuns[CONFIG_MAX_BUTTONS * JOB_MAX_PARALLEL];
+int                     i_ReplayRuns;
+int                     i_EpollFd;
+int                     i_SampleTimer;
+int                     i_LedTimer;
+int                     i_MetricsTimer;
+int                     i_GestureTimer;
+int                     i_BatchTimer;
+int                     i_TimeoutTimer;
+int                     i_CgroupProcs = -1;
+int                     i_ConfigWatch;
+char                    s_NotifySocket[108];
 
 /** Forward Declarations: ***********************************************************/
 
-int  RunDemon      ();
-void RunExecutable ();
-void SIG_Alarm     (int signum);
-void SIG_ChildTerm (int signum);
-void SIG_Quit      (int signum);
+int  RunDemon      (const char* sConfigFile, bool bForeground);
+int  RunReplay     (const char* sConfigFile, const char* sTrace);
+void ReplayUntil   (unsigned long long ullUntil);
+void ReplayPresses ();
+void ReplayJobs    ();
+void ReplayExit    (int iExitCode);
+bool RunExecutable (int iAction, SJob* pJob);
+bool RunShell      (int iAction, SJob* pJob);
+void CaptureOutput (SJob* pJob, int iOutput);
+int  OpenControl   (SJob* pJob);
+void FinishJob     (int iAction, SJob* pJob, int iExitCode);
+void NoteResult    (int iAction, int iExitCode);
+void ReapChildren  ();
+void StartJobs     ();
+bool QueuePress    (unsigned short uwPin, unsigned char ubGesture, unsigned long long ullTimestamp);
+void HandlePeer    (const SNetRecord* pRecord);
+int  PendingJobs   ();
+void PrepareSpawner();
+unsigned long long GetTime();
+unsigned long long GetRealTime();
+void HandleEdges   ();
+void HandleSignals (int iSignalFd);
+void SampleButtons ();
+void StartInput    (const SConfig* pConfig);
+void StopInput     ();
+void UpdateLeds    ();
+void ParsePatterns (const SConfig* pConfig);
+const char* LedName (const SConfig* pConfig);
+void OpenJournal   (bool bReplay);
+void JournalActions();
+void ApplyConfig   ();
+void OverrideLed   (SConfig* pConfig);
+bool SameButtons   (const SConfig* pA, const SConfig* pB, bool bPins);
+bool ReopenGpio    (const SConfig* pConfig);
+void MapPins       (const SConfig* pConfig);
+void MapActions    (const SConfig* pConfig);
+bool SameInput     (const SConfig* pA, const SConfig* pB);
+void WatchConfig   ();
+void HandleConfigWatch();
+void ReloadConfig  ();
+void Notify        (const char* sFormat, ...);
+int  ListenFd      ();
+void NotifyManager (const char* sFormat, ...);
+void ArmTimer      (int iTimerFd, unsigned long long ullPeriod);
+void ArmAt         (int iTimerFd, unsigned long long ullDue, unsigned long long* pullArmed);
+unsigned long long SamplePeriod(const SConfig* pConfig);
+unsigned long long NextBatch();
+unsigned long long NextTimeout();
+void ExpireJobs    ();
+void OpenCgroup    ();
+void Stop          (pid_t pid, int iSignal);
+bool WriteCgroup   (const char* sDir, const char* sFile, const char* sValue);
+bool AddToEpoll    (int iFd, unsigned int uiTag);
 
 /** Main-Function: ******************************************************************/
 
-int RunDemon() {
+int RunDemon(const char* sConfigFile, bool bForeground) {
     /** Variables:                                                                  */
     pid_t     pid, sid;
     struct    sigaction sa;
-    struct    itimerval timer;
-    int       iServerID, iClientId;
+    sigset_t  Signals;
+    int       iServerID, iSignalFd;
     struct    sockaddr_un SocketAddress;
-    socklen_t AddressLen;
-    struct    pollfd pfds[1];
-    bool      b_RunExecutable = false;
-    int       iResult;
+    struct    epoll_event Events[MAX_EVENTS];
+    int       nReplies, i, j, n, iTimeout, iRestart, iAction;
+    unsigned long ulSeqs [POOL_MAX_WORKERS];
+    int       iCodes[POOL_MAX_WORKERS];
+    SPressEvent   Event;
+    SNetRecord    Remote[8 * NET_MAX_RECORDS];
+    unsigned long ulOverruns = 0;
+    unsigned long ulDropped, ulCoalesced;
+    int       iRunning, iQueued, iHeld;
+    unsigned long long ullExpired, ullWoken, ullStart, ullStartup;
+    bool      bBusy;
+    const SConfig* pConfig;
     
     /** Read configuration: *********************************************************/
-    if (! Config.ReadConfig((char*)"/etc/buzzerd.conf") ) {
+    ullStartup = GetTime();
+    if (! Config.ReadConfig(sConfigFile) ) {
         printf ("ERR: Unable to read configuration!\n");        
         return -2;
     }
+    pConfig = Config.Get();
     
     /** Set up the demon: ***********************************************************/
-    b_ExecRunning = false;
-    pid = fork();
-    if (pid < 0) {
-        return -2;
+    for (i=0; i<pConfig->i_Buttons; i++) {
+        if ((! Actions[i].Jobs.Init(pConfig->i_QueueSize, pConfig->i_MaxParallel, pConfig->ub_Overflow)) ||
+            (! Actions[i].Jobs.SetBatch(pConfig->i_BatchSize, pConfig->i_BatchWindow * 1000000ULL))) {
+            printf ("ERR: Invalid size of the job-queue!\n");        
+            return -2;
+        }
     }
+    /** Take over the socket of the service-manager or create it before the fork:   */
+    iServerID = ListenFd();
+    if (iServerID < 0) {
+        if ((iServerID=socket (AF_LOCAL, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0) {
+            printf ("ERR: Unable to create socket!\n");
+            return -2;
+        }
+        /** Bind socket to file:                                                    */
+        unlink(GetSocketFile());
+        memset(&SocketAddress, 0, sizeof (SocketAddress));
+        SocketAddress.sun_family = AF_LOCAL;
+        strncpy(SocketAddress.sun_path, GetSocketFile(), sizeof(SocketAddress.sun_path) - 1);
+        if (bind ( iServerID, (struct sockaddr *) &SocketAddress, sizeof (SocketAddress)) != 0) {
+            printf ("ERR: Unable to bind socket %s!\n", GetSocketFile());
+            return -2;
+        }
+        /** Clients may connect from now on, their commands wait in the backlog:    */
+        listen (iServerID, SOMAXCONN);
+    }
+    
+    /** Keep the notification-socket from the executables, which inherit the rest:  */
+    if (getenv("NOTIFY_SOCKET") != 0) {
+        strncpy(s_NotifySocket, getenv("NOTIFY_SOCKET"), sizeof(s_NotifySocket) - 1);
+        unsetenv("NOTIFY_SOCKET");
+    }
+    
+    /** The service-manager may keep the daemon in the foreground:                  */
+    if (! bForeground) {
+        pid = fork();
+        if (pid < 0) {
+            return -2;
+        }
 
-    /** If we got a good PID, then we can exit the parent process:                  */
-    if (pid > 0) {
-        printf("Starting Buzzer-Deamon as PID %i.\n", pid);
-        return 0;
+        /** If we got a good PID, then we can exit the parent process:              */
+        if (pid > 0) {
+            printf("Starting Buzzer-Deamon as PID %i.\n", pid);
+            return 0;
+        }
     }
     
     /** Close out the standard file descriptors:                                    */
-    if (! Config.b_Debug) {        
+    if (! pConfig->b_Debug) {        
         close(STDIN_FILENO);
         close(STDOUT_FILENO);
         close(STDERR_FILENO);
@@ -102,17 +295,11 @@ int RunDemon() {
     /** Open syslog:                                                                */
     openlog( "BuzzerD", LOG_PID | LOG_CONS | LOG_NDELAY, LOG_LOCAL0 );
     
-    /** Prepare the Mutex:                                                          */
-    if (pthread_mutex_init(&mutex_BuzzCount, NULL) != 0) {
-        syslog(LOG_ERR | LOG_DAEMON, "FAILURE CREATING MUTEX!");
-        return -2;
-    }
-
     /* Change the file mode mask */
     umask(0);
             
     /* Create a new SID for the child process */
-    sid = setsid();
+    sid = bForeground ? getsid(0) : setsid();
     if (sid < 0) {
         /* Log the failure and exit:                                                */
         syslog(LOG_ERR | LOG_DAEMON, "FAILURE SETTING UP CLIENT-PROCCESS!");
@@ -126,206 +313,1404 @@ int RunDemon() {
         return -2;
     }    
     
-    /** Setup BCM hardware-library: *************************************************/
-    if (!bcm2835_init()) {
+    /** Setup the GPIO backend:                                                     */
+    Gpio = CreateGpioBackend(pConfig);
+    if (Gpio == 0) {
         /* Log the failure and exit:                                                */
-        syslog(LOG_ERR | LOG_DAEMON, "FAILURE ACCESSING THE BCM HW LIBRARY!");
+        syslog(LOG_ERR | LOG_DAEMON, "FAILURE ACCESSING THE GPIO HARDWARE!");
         return -2;
     }
+    b_EventInput = (Gpio->GetFd() >= 0);
+    MapPins(pConfig);
     
-    /** Prepare the LED pin:                                                        */
-    bcm2835_gpio_set_pad(BCM2835_PAD_GROUP_GPIO_0_27,BCM2835_PAD_DRIVE_16mA);
-    bcm2835_gpio_fsel(PIN_LED, BCM2835_GPIO_FSEL_OUTP);
-    
-    /** Prepare the button pin:                                                     */
-    bcm2835_gpio_fsel(PIN_BTN, BCM2835_GPIO_FSEL_INPT);
-    bcm2835_gpio_set_pud(PIN_BTN, BCM2835_GPIO_PUD_UP);
+    /** Setup the event-loop: *******************************************************/
+    i_EpollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (i_EpollFd < 0) {
+        syslog(LOG_ERR | LOG_DAEMON, "FAILURE CREATING THE EVENT-LOOP!");
+        return -2;
+    }
     
-    /** Setup Signal Handler for quit: **********************************************/
+    /** Ignore broken pipes, so a dead worker or client cannot kill the daemon:     */
     memset(&sa, 0, sizeof (sa));
     sigemptyset(&sa.sa_mask);
-    sa.sa_handler = &SIG_Quit;
-    sigaction(SIGINT , &sa, NULL);
-    sigaction(SIGQUIT, &sa, NULL);
-    sigaction(SIGKILL, &sa, NULL);
-    sigaction(SIGTERM, &sa, NULL);
+    sa.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &sa, NULL);
     
-    /** Setup Signal Handler for child-term: ****************************************/
-    sa.sa_handler = &SIG_ChildTerm ;
-    sigaction (SIGCHLD, &sa, NULL );
+    /** Receive quit, reload and child-term via a descriptor, not signal-handlers:  */
+    sigemptyset(&Signals);
+    sigaddset(&Signals, SIGHUP );
+    sigaddset(&Signals, SIGINT );
+    sigaddset(&Signals, SIGQUIT);
+    sigaddset(&Signals, SIGTERM);
+    sigaddset(&Signals, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &Signals, NULL);
+    iSignalFd = signalfd(-1, &Signals, SFD_NONBLOCK | SFD_CLOEXEC);
     
-    /** Setup 50 ms timer: **********************************************************/
-    sa.sa_handler = &SIG_Alarm ;
-    sigaction ( SIGALRM, &sa, NULL );
-    timer.it_value.tv_sec = 0 ;
-    timer.it_value.tv_usec = 50000;
-    timer.it_interval.tv_sec = 0;
-    timer.it_interval.tv_usec = 50000 ;
-    setitimer ( ITIMER_REAL, &timer, NULL ) ;
-
-    /** Create Socket: **************************************************************/
-    if((iServerID=socket (AF_LOCAL, SOCK_STREAM, 0)) == 0) {
-        syslog(LOG_ERR | LOG_DAEMON, "FAILURE CREATING A SOCKET!");
-        return -2;
-    }
-    /** Bind socket to file:                                                        */
-    unlink(SOCK_FILE);
-    SocketAddress.sun_family = AF_LOCAL;
-    strcpy(SocketAddress.sun_path, SOCK_FILE);
-    if (bind ( iServerID, (struct sockaddr *) &SocketAddress, sizeof (SocketAddress)) != 0) {
-        syslog(LOG_ERR | LOG_DAEMON, "FAILURE BINDING SOCKET!");
+    /** Timers for sampling the button and blinking the LED, armed only if needed:  */
+    i_SampleTimer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    i_LedTimer    = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    i_MetricsTimer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    i_GestureTimer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    i_BatchTimer   = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    i_TimeoutTimer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if ((iSignalFd < 0) || (i_SampleTimer < 0) || (i_LedTimer < 0) || (i_MetricsTimer < 0) || (i_GestureTimer < 0) ||
+        (i_BatchTimer < 0) || (i_TimeoutTimer < 0) || (! Input.Init())) {
+        syslog(LOG_ERR | LOG_DAEMON, "FAILURE CREATING THE EVENT-SOURCES!");
         return -2;
     }
+    if (pConfig->s_MetricsFile[0] != 0) ArmTimer(i_MetricsTimer, pConfig->i_MetricsInterval * 1000000000ULL);
 
-    /** Activate the socket:                                                        */     
-    listen (iServerID, 5);
-    AddressLen = sizeof (struct sockaddr_in);
+    /** Serve the clients, which may have connected already:                        */
+    Control.Init(iServerID, i_EpollFd, EV_CLIENT, &Config, &Runs, &Metrics);
     
-    /** Prepare polling-structure: */
-    pfds[0].fd     = iServerID;
-	pfds[0].events = POLLIN;
+    /** Register all sources of the event-loop:                                     */
+    AddToEpoll(iServerID,     EV_SERVER);
+    AddToEpoll(iSignalFd,     EV_SIGNAL);
+    AddToEpoll(i_SampleTimer, EV_SAMPLE);
+    AddToEpoll(i_LedTimer,    EV_LED);
+    AddToEpoll(i_MetricsTimer, EV_METRICS);
+    AddToEpoll(i_GestureTimer, EV_GESTURE);
+    AddToEpoll(i_BatchTimer,  EV_BATCH);
+    AddToEpoll(i_TimeoutTimer, EV_TIMEOUT);
+    AddToEpoll(Input.GetFd(), EV_INPUT);
+    StartInput(pConfig);
+    for (i=0; i<CONFIG_MAX_BUTTONS; i++) Actions[i].Pool.SetEpoll(i_EpollFd, EV_WORKER);
+    Runs.SetEpoll(i_EpollFd, EV_OUTPUT);
+    WatchConfig();
+    if (! Network.Open(pConfig, i_EpollFd, EV_NETWORK)) return -2;
 
-    /** Note the successful initialization:                                         */
-    syslog(LOG_NOTICE | LOG_DAEMON, "Sucessfully initialized.");
+    /** Later snapshots are compared with this one, to apply only the differences:  */
+    Applied = *pConfig;
+    
+    /** Resolve the executable once and start the workers, if there are any:        */
+    PrepareSpawner();
+    
+    /** Run the presses again, which were accepted, but not finished before:        */
+    OpenJournal(true);
+    
+    /** Show the initial LED state:                                                 */
+    Sequencer.Attach(Gpio, i_Leds);
+    ParsePatterns(&Applied);
+    UpdateLeds();
+    
+    /** Note the successful initialization and how long it took:                    */
+    ullStartup = (GetTime() - ullStartup) / 1000;
+    Metrics.Gauge(GAUGE_STARTUP, ullStartup);
+    syslog(LOG_NOTICE | LOG_DAEMON, "Sucessfully initialized in %llu us.", ullStartup);
+    /** Publish the status for monitors, which do not want to use the socket:       */
+    StatusPage.Status.i_Pid          = getpid();
+    StatusPage.Status.ull_Started    = GetRealTime();
+    StatusPage.Status.ull_Updated    = StatusPage.Status.ull_Started;
+    StatusPage.Status.ull_Generation = Applied.ul_Generation;
+    if (! StatusPage.Open(GetStatusFile())) {
+        syslog(LOG_WARNING | LOG_DAEMON, "FAILURE CREATING THE STATUS-PAGE %s!", GetStatusFile());
+    }
+    NotifyManager("READY=1\nSTATUS=Initialized in %llu us.\nMAINPID=%i", ullStartup, getpid());
     
     /* Main-Loop: *******************************************************************/
     b_Alive = true;
     while((b_Alive) && (! Config.b_Shutdown)){
-        /** Poll the socket with a 10ms timeout:                                    */
-        iResult = poll(pfds, 1, 10);
-        /** Check, if there was a request on the poll:                              */
-        if (iResult>0) {
-            /** There was, so try to accept it:                                     */
-            iClientId = accept ( iServerID, (struct sockaddr *) &SocketAddress, &AddressLen );
-            if (iClientId < 1) continue;
-            /** It connected, so run the client-handler on it:                      */
-            Config.HandleClient(iClientId);
-            close (iClientId);
+        /** Wake up for the next gesture, LED-transition and batch, if changed:     */
+        ArmAt(i_GestureTimer, (Input.Running()) ? 0 : Gestures.NextDeadline(), &ull_GestureDue);
+        ArmAt(i_LedTimer,     Sequencer.NextDeadline(), &ull_LedDue);
+        ArmAt(i_BatchTimer,   NextBatch(),              &ull_BatchDue);
+        ArmAt(i_TimeoutTimer, NextTimeout(),            &ull_TimeoutDue);
+        /** Sleep until an event arrives or a worker is due for its restart:        */
+        iTimeout = -1;
+        for (i=0; i<Applied.i_Buttons; i++) {
+            iRestart = Actions[i].Pool.NextRestart();
+            if ((iRestart >= 0) && ((iTimeout < 0) || (iRestart < iTimeout))) iTimeout = iRestart;
+        }
+        n = epoll_wait(i_EpollFd, Events, MAX_EVENTS, iTimeout);
+        ullWoken = GetTime();
+        bBusy = (PendingJobs() > 0);
+        Config.ul_Wakeups++;
+        for (i=0; i<n; i++) {
+            switch (Events[i].data.u64 >> 32) {
+            case EV_SIGNAL:
+                /** Quit or collect the executables, which have terminated:         */
+                HandleSignals(iSignalFd);
+                bBusy = true;
+                break;
+            case EV_BUTTON:
+                /** The button has changed:                                         */
+                HandleEdges();
+                bBusy = true;
+                break;
+            case EV_CONFIG:
+                /** The directory of the configuration-file has changed:            */
+                HandleConfigWatch();
+                bBusy = true;
+                break;
+            case EV_INPUT:
+                /** The input-thread pushed gestures, which are popped below:       */
+                Input.Drain();
+                bBusy = true;
+                break;
+            case EV_SAMPLE:
+                /** Sample the button, if there are no edge-events:                 */
+                if (read(i_SampleTimer, &ullExpired, sizeof(ullExpired)) > 0) SampleButtons();
+                break;
+            case EV_GESTURE:
+                /** A gesture is due, e.g. a long-press or the release of a button: */
+                if (read(i_GestureTimer, &ullExpired, sizeof(ullExpired)) > 0) Gestures.Expire(GetTime());
+                break;
+            case EV_BATCH:
+                /** The window of a batch is over, so it starts with its presses:   */
+                if (read(i_BatchTimer, &ullExpired, sizeof(ullExpired)) > 0) StartJobs();
+                break;
+            case EV_TIMEOUT:
+                /** A run took too long, so it is terminated or killed:             */
+                if (read(i_TimeoutTimer, &ullExpired, sizeof(ullExpired)) > 0) ExpireJobs();
+                bBusy = true;
+                break;
+            case EV_LED:
+                /** The pattern of an LED reached its next transition:              */
+                if (read(i_LedTimer, &ullExpired, sizeof(ullExpired)) > 0) Sequencer.Advance(GetTime());
+                break;
+            case EV_WORKER:
+                /** A worker replied or terminated, only its own pool knows it:     */
+                for (iAction=0; iAction<CONFIG_MAX_BUTTONS; iAction++) {
+                    nReplies = Actions[iAction].Pool.HandleFd((int) (Events[i].data.u64 & 0xFFFFFFFF),
+                                                              ulSeqs, iCodes, POOL_MAX_WORKERS);
+                    for (j=0; j<nReplies; j++) {
+                        FinishJob(iAction, Actions[iAction].Jobs.FindId(ulSeqs[j]), iCodes[j]);
+                    }
+                }
+                bBusy = true;
+                break;
+            case EV_SERVER:
+                /** There are new clients, so accept them:                          */
+                Control.Accept();
+                bBusy = true;
+                break;
+            case EV_OUTPUT:
+                /** A run wrote some output:                                        */
+                Runs.Read((int) (Events[i].data.u64 & 0xFFFFFFFF));
+                bBusy = true;
+                break;
+            case EV_CLIENT:
+                /** A client sent commands or may take further replies:             */
+                ullStart = GetTime();
+                Control.HandleEvent((int) (Events[i].data.u64 & 0xFFFFFFFF), Events[i].events);
+                Metrics.Count(MET_COMMANDS);
+                Metrics.Record(HIST_COMMAND, GetTime() - ullStart);
+                bBusy = true;
+                break;
+            case EV_NETWORK:
+                /** Peers sent their presses or the results of their runs:          */
+                nReplies = Network.HandleEvent((int) (Events[i].data.u64 & 0xFFFFFFFF), Events[i].events,
+                                               Remote, 8 * NET_MAX_RECORDS);
+                for (j=0; j<nReplies; j++) HandlePeer(&Remote[j]);
+                bBusy = true;
+                break;
+            case EV_METRICS:
+                /** Rewrite the exposition-file:                                    */
+                if (read(i_MetricsTimer, &ullExpired, sizeof(ullExpired)) <= 0) break;
+                if (! Metrics.WriteFile(Config.Get()->s_MetricsFile)) {
+                    syslog(LOG_WARNING | LOG_DAEMON, "FAILURE WRITING THE METRICS TO %s!", Config.Get()->s_MetricsFile);
+                    ArmTimer(i_MetricsTimer, 0);
+                }
+                break;
+            }
         }
-        /** Check, if there was a buzzer-press:                                     */
-        pthread_mutex_lock(&mutex_BuzzCount);
-        if ((ub_BuzzCount > 0) && (! b_ExecRunning)) {
-            ub_BuzzCount --;
-            b_RunExecutable = true;
+        /** Apply a new snapshot of the configuration, commands or reloads publish: */
+        ApplyConfig();
+        if (! b_Alive) break;
+        for (i=0; i<CONFIG_MAX_BUTTONS; i++) Actions[i].Pool.Service();
+        /** Move the gestures into the job-queue of the action of their button:     */
+        while (Presses.Pop(&Event)) {
+            bBusy = true;
+            if (QueuePress(Event.uw_Pin, Event.ub_Gesture, Event.ull_Timestamp)) {
+                Network.Press(Event.uw_Pin, Event.ub_Gesture, Event.ull_Timestamp);
+            }
         }
-        pthread_mutex_unlock(&mutex_BuzzCount);
-        /** If there was, run the executable:                                       */
-        if (b_RunExecutable) {
-            b_RunExecutable = false;
-            RunExecutable();
+        StartJobs();
+        /** Send the presses and results of this iteration to the peers in one go:  */
+        Network.Flush();
+        /** Report presses, which did not fit into the ring:                        */
+        if (Presses.Overruns() != ulOverruns) {
+            ulOverruns = Presses.Overruns();
+            syslog(LOG_WARNING | LOG_DAEMON, "%lu PRESSES OVERRAN THE INPUT-RING!", ulOverruns);
         }
+        /** Journal the dropped presses and sync the records of this iteration:     */
+        JournalActions();
+        if (! Journal.Service()) syslog(LOG_WARNING | LOG_DAEMON, "FAILURE COMPACTING THE JOURNAL %s!", Applied.s_Journal);
+        /** Write the output of the runs in one go, once the burst is over:         */
+        if (PendingJobs() == 0) Runs.Flush();
+        /** Count the wake-ups, which had nothing to do but timing:                 */
+        if (! bBusy) Config.ul_IdleWakeups++;
+        /** Update the metrics, which are kept elsewhere, summed over all buttons:  */
+        ulDropped = ulCoalesced = 0;
+        iRunning  = iQueued = iHeld = 0;
+        for (i=0; i<CONFIG_MAX_BUTTONS; i++) {
+            ulDropped   += Actions[i].Jobs.ul_Dropped;
+            ulCoalesced += Actions[i].Jobs.ul_Coalesced;
+            iRunning    += Actions[i].Jobs.Running();
+            iQueued     += Actions[i].Jobs.Queued();
+            iHeld       += Actions[i].Jobs.Held();
+        }
+        Metrics.Set  (MET_OVERRUNS,     ulOverruns);
+        Metrics.Set  (MET_BOUNCES,      Gestures.ul_Bounces.load());
+        Metrics.Set  (MET_DROPPED,      ulDropped);
+        Metrics.Set  (MET_COALESCED,    ulCoalesced);
+        Metrics.Set  (MET_WAKEUPS,      Config.ul_Wakeups);
+        Metrics.Set  (MET_IDLE_WAKEUPS, Config.ul_IdleWakeups);
+        Metrics.Set  (MET_NET_SENT,     Network.ul_Sent);
+        Metrics.Set  (MET_NET_RECEIVED, Network.ul_Received);
+        Metrics.Set  (MET_NET_LOST,     Network.ul_Lost);
+        Metrics.Set  (MET_NET_REJECTED, Network.ul_Rejected);
+        Metrics.Gauge(GAUGE_QUEUED,     iQueued);
+        Metrics.Gauge(GAUGE_RUNNING,    iRunning);
+        Metrics.Gauge(GAUGE_HELD,       iHeld);
+        Metrics.Record(HIST_LOOP, GetTime() - ullWoken);
+        /** Publish the status of this iteration as a whole:                        */
+        StatusPage.Status.i_Queued       = iQueued;
+        StatusPage.Status.i_Held         = iHeld;
+        StatusPage.Status.i_Running      = iRunning;
+        StatusPage.Status.ull_Updated    = GetRealTime();
+        StatusPage.Status.ull_Generation = Applied.ul_Generation;
+        StatusPage.Status.ull_Presses    = Metrics.Get(MET_PRESSES);
+        StatusPage.Status.ull_Jobs       = Metrics.Get(MET_STARTED);
+        StatusPage.Status.ull_Failed     = Metrics.Get(MET_FAILED);
+        StatusPage.Status.ull_TimedOut   = Metrics.Get(MET_TIMEOUTS);
+        StatusPage.Status.ull_Killed     = Metrics.Get(MET_KILLED);
+        StatusPage.Status.ull_Dropped    = ulDropped;
+        StatusPage.Publish();
     }
     
     /** Shutdown: *******************************************************************/
     
-    bcm2835_gpio_fsel(PIN_LED, BCM2835_GPIO_FSEL_OUTP);
-    bcm2835_gpio_write(PIN_LED, LOW);
-    bcm2835_close();
-    
-    pthread_mutex_destroy(&mutex_BuzzCount);
+    NotifyManager("STOPPING=1");
+    Control.Close();
+    close(iServerID);
+    Network.Flush();
+    Network.Close();
+    StatusPage.Close();
+    Runs.Flush();
+    for (i=0; i<CONFIG_MAX_BUTTONS; i++) Actions[i].Pool.Stop();
+    StopInput();
+    if (Gpio != 0) {
+        for (i=0; i<i_Leds; i++) Gpio->WriteLed(i, false);
+        Gpio->Close();
+        delete Gpio;
+    }
+    if (Config.Get()->s_MetricsFile[0] != 0) Metrics.WriteFile(Config.Get()->s_MetricsFile);
+    JournalActions();
+    Journal.Close();
+    if (i_ConfigWatch >= 0) close(i_ConfigWatch);
+    close(i_TimeoutTimer);
+    close(i_BatchTimer);
+    if (i_CgroupProcs >= 0) close(i_CgroupProcs);
+    close(i_GestureTimer);
+    close(i_MetricsTimer);
+    close(i_LedTimer);
+    close(i_SampleTimer);
+    close(iSignalFd);
+    close(i_EpollFd);
 
-    syslog(LOG_NOTICE | LOG_DAEMON, "Received SigInt and closed.");
+    syslog(LOG_NOTICE | LOG_DAEMON, "Received SigInt and closed after %lu wake-ups, %lu of them idle.",
+           Config.ul_Wakeups, Config.ul_IdleWakeups);
     closelog();
     return 0;    
 }
+
+int RunReplay(const char* sConfigFile, const char* sTrace) {
+    /** Variables:                                                                  */
+    CGpioTrace         Trace(sTrace, 0);
+    STraceRecord       Record;
+    unsigned long long ullInput = 0, ullStep, ullAt;
+    unsigned long      ul, ulSamples;
+    int                i;
+    const SConfig*     pConfig;
+    
+    /** Read configuration: *********************************************************/
+    if (! Config.ReadConfig(sConfigFile) ) {
+        printf ("ERR: Unable to read configuration!\n");
+        return -2;
+    }
+    pConfig = Config.Get();
+    Applied = *pConfig;
+    for (i=0; i<pConfig->i_Buttons; i++) {
+        if ((! Actions[i].Jobs.Init(pConfig->i_QueueSize, pConfig->i_MaxParallel, pConfig->ub_Overflow)) ||
+            (! Actions[i].Jobs.SetBatch(pConfig->i_BatchSize, pConfig->i_BatchWindow * 1000000ULL))) {
+            printf ("ERR: Invalid size of the job-queue!\n");
+            return -2;
+        }
+    }
+    if (! Trace.Init(0, 0, 0)) {
+        printf ("ERR: Unable to read the trace %s!\n", sTrace);
+        return -2;
+    }
+    /** The gestures, the job-queues and the sequencer run on its virtual time:     */
+    Gpio     = &Trace;
+    p_Replay = &Trace;
+    i_ReplayRuns = 0;
+    ParsePatterns(&Applied);
+    
+    /* Replay-Loop: *****************************************************************/
+    while (Trace.Next(&Record)) {
+        switch (Record.ub_Type) {
+        case TRACE_START:
+            /** Each recording starts like a reopened GPIO:                         */
+            ReplayUntil(Record.ull_Timestamp);
+            Gestures.Reset();
+            b_EventInput = (Record.i_Value & TRACE_EDGES) != 0;
+            MapPins(&Applied);
+            Sequencer.Attach(Gpio, i_Leds);
+            Trace.Report("start %llu %s %i\n", Record.ull_Level, (b_EventInput) ? "event" : "poll", Record.ui_Index);
+            UpdateLeds();
+            ullInput = Record.ull_Timestamp;
+            break;
+        case TRACE_SAMPLE:
+            /** Equal samples are spread evenly, only the first ones can matter:    */
+            ulSamples = (Record.ul_Run < GESTURE_SAMPLES) ? Record.ul_Run : GESTURE_SAMPLES;
+            ullStep   = (Record.ull_Timestamp > ullInput) ? (Record.ull_Timestamp - ullInput) / (Record.ul_Run + 1) : 0;
+            for (ul=1; ul<=ulSamples; ul++) {
+                ullAt = ullInput + ul * ullStep;
+                ReplayUntil(ullAt);
+                Gestures.Sample(Record.ull_Before, ullAt);
+            }
+            ReplayUntil(Record.ull_Timestamp);
+            Gestures.Sample(Record.ull_Level, Record.ull_Timestamp);
+            ullInput = Record.ull_Timestamp;
+            break;
+        case TRACE_EDGE:
+            ReplayUntil(Record.ull_Timestamp);
+            Gestures.Edge(Record.ui_Index, Record.i_Value != 0, Record.ull_Timestamp);
+            ullInput = Record.ull_Timestamp;
+            break;
+        case TRACE_LED:
+            /** The LEDs of the field are shown next to the ones of the replay:     */
+            ReplayUntil(Record.ull_Timestamp);
+            Trace.Report("recorded led %u %i\n", Record.ui_Index, Record.i_Value);
+            break;
+        case TRACE_MARK:
+            ReplayUntil(Record.ull_Timestamp);
+            if (Record.c_Mark == GPIO_MARK_FORK) {
+                Trace.Report("recorded fork %i\n", Record.i_Value);
+            }else if (Record.c_Mark == GPIO_MARK_EXIT) {
+                Trace.Report("recorded exit %i\n", Record.i_Value);
+                ReplayExit(Record.i_Value);
+            }
+            break;
+        }
+    }
+    
+    /** Shutdown: *******************************************************************/
+    
+    ReplayUntil(Trace.ull_Clock);
+    Trace.Report("end %u %lu %lu\n", Presses.Pushed(), Gestures.ul_Bounces.load(), Presses.Overruns());
+    Gpio     = 0;
+    p_Replay = 0;
+    return 0;
+}
+
+void ReplayUntil(unsigned long long ullUntil) {
+    /** Variables:                                                                  */
+    unsigned long long ullDue, ullNext, ullLast = 0;
+    /** The gestures, which were emitted so far, are queued first:                  */
+    ReplayPresses();
+    /** Then the timers, which are due until then, run in the order of their time:  */
+    while (true) {
+        ullNext = Gestures.NextDeadline();
+        ullDue  = Sequencer.NextDeadline();
+        if ((ullDue != 0) && ((ullNext == 0) || (ullDue < ullNext))) ullNext = ullDue;
+        ullDue  = NextBatch();
+        if ((ullDue != 0) && ((ullNext == 0) || (ullDue < ullNext))) ullNext = ullDue;
+        if ((ullNext == 0) || (ullNext > ullUntil)) break;
+        /** A deadline, which is overdue and stays, would never end:                */
+        if ((ullNext <= p_Replay->ull_Clock) && (ullNext == ullLast)) break;
+        ullLast = ullNext;
+        if (ullNext > p_Replay->ull_Clock) p_Replay->ull_Clock = ullNext;
+        Gestures.Expire(p_Replay->ull_Clock);
+        Sequencer.Advance(p_Replay->ull_Clock);
+        ReplayPresses();
+    }
+    if (ullUntil > p_Replay->ull_Clock) p_Replay->ull_Clock = ullUntil;
+}
+
+void ReplayPresses() {
+    /** Variables:                                                                  */
+    SPressEvent Event;
+    int         iAction;
+    /** Each gesture goes into the job-queue of its action, like QueuePress() does: */
+    while (Presses.Pop(&Event)) {
+        iAction = ((Event.uw_Pin < CONFIG_MAX_PIN) && (Event.ub_Gesture < GESTURE_COUNT)) ?
+                  i_ActionOfPin[Event.uw_Pin][Event.ub_Gesture] : -1;
+        p_Replay->Report("press %u %s %i %llu\n", Event.uw_Pin, CGestures::Name(Event.ub_Gesture), iAction,
+                         (p_Replay->ull_Clock - Event.ull_Timestamp) / 1000ULL);
+        if (iAction >= 0) Actions[iAction].Jobs.Push(Event.ull_Timestamp);
+    }
+    ReplayJobs();
+}
+
+void ReplayJobs() {
+    /** Variables:                                                                  */
+    SJob* pJob;
+    int   i;
+    bool  bStarted = false;
+    /** Start the jobs, as StartJobs() would, but only note them:                   */
+    for (i=0; i<Applied.i_Buttons; i++) {
+        while ((pJob = Actions[i].Jobs.Start(GetTime())) != 0) {
+            p_Replay->Report("start %i %i\n", i, pJob->i_Presses);
+            ReplayRuns[i_ReplayRuns].i_Action = i;
+            ReplayRuns[i_ReplayRuns].ul_Job   = pJob->ul_Id;
+            i_ReplayRuns++;
+            bStarted = true;
+        }
+    }
+    if ((bStarted) && (LedBusy.i_Steps > 0)) UpdateLeds();
+}
+
+void ReplayExit(int iExitCode) {
+    /** Variables:                                                                  */
+    SJob* pJob;
+    int   iAction;
+    /** The oldest run takes the recorded exit, as the trace does not name the job: */
+    if (i_ReplayRuns == 0) return;
+    iAction = ReplayRuns[0].i_Action;
+    pJob    = Actions[iAction].Jobs.FindId(ReplayRuns[0].ul_Job);
+    i_ReplayRuns--;
+    memmove(&ReplayRuns[0], &ReplayRuns[1], i_ReplayRuns * sizeof(SReplayRun));
+    if (pJob == 0) return;
+    Actions[iAction].Jobs.Finish(pJob, iExitCode, GetTime());
+    p_Replay->Report("finish %i %i\n", iAction, iExitCode);
+    NoteResult(iAction, iExitCode);
+    UpdateLeds();
+    ReplayJobs();
+}
    
-void RunExecutable(){
+bool RunExecutable(int iAction, SJob* pJob){
+    /** Variables:                                                                  */     
+    int    iOutput, iControl, iStamps = 0;
+    const unsigned long long* pullStamps = 0;
+    /** The shell is only used, if it is explicitly configured:                     */
+    if (Applied.ub_ExecMode == EXEC_MODE_SHELL) return RunShell(iAction, pJob);
+    /** Persistent workers only get the press passed on:                            */
+    if (Applied.ub_ExecMode == EXEC_MODE_PERSISTENT) {
+        if (! Actions[iAction].Pool.Dispatch(pJob->ul_Id, pJob->ull_Enqueued, pJob->i_Presses)) {
+            syslog(LOG_ERR | LOG_DAEMON, "FAILURE PASSING JOB %lu TO A WORKER!", pJob->ul_Id);
+            return false;
+        }
+        Gpio->Mark(GPIO_MARK_FORK, pJob->ul_Id);
+        CaptureOutput(pJob, -1);
+        return true;
+    }
+    /** Spawn the executable directly, a batch gets the timestamps of its presses:  */
+    if (Applied.i_BatchSize > 1) iStamps = Actions[iAction].Jobs.Stamps(pJob, &pullStamps);
+    iControl  = OpenControl(pJob);
+    pJob->pid = Actions[iAction].Spawner.Spawn(&iOutput, pullStamps, iStamps, iControl);
+    if (iControl >= 0) close(iControl);
+    if (pJob->pid < 0) {
+        syslog(LOG_ERR | LOG_DAEMON, "FAILURE SPAWNING THE EXECUTABLE CLIENT!");
+        return false;
+    }
+    Gpio->Mark(GPIO_MARK_FORK, pJob->pid);
+    CaptureOutput(pJob, iOutput);
+    return true;
+}
+
+bool RunShell(int iAction, SJob* pJob){
     /** Variables:                                                                  */     
     int   pid;
-    char  buffer[2048];
-    int   iResult;
-    FILE  *fp;
+    char  buffer[2048], sBatch[32], sControl[32];
+    char* pArgv[4];
+    char** ppEnv;
+    int   iResult, iEnv, i;
+    int   OutPipe[2];
+    int   iInput = -1, iStamps = 0, iControl;
+    const unsigned long long* pullStamps = 0;
+    sigset_t Signals;
+    /** Build the command and its environment now, the child may only exec them:    */
+    iResult = snprintf(buffer, sizeof(buffer), "bash %s", Applied.Buttons[iAction].s_Executable);
+    if (iResult >= (int) sizeof(buffer)) {
+        syslog(LOG_ERR | LOG_DAEMON, "FAILURE BUILDING THE COMMAND OF THE EXECUTABLE CLIENT!");
+        return false;
+    }
+    pArgv[0] = (char*) "bash";
+    pArgv[1] = (char*) "-c";
+    pArgv[2] = buffer;
+    pArgv[3] = 0;
+    /** The output of the shell is passed back through a pipe:                      */
+    if (pipe2(OutPipe, O_CLOEXEC) != 0) {
+        syslog(LOG_ERR | LOG_DAEMON, "FAILURE CREATING A PIPE FOR THE EXECUTABLE CLIENT!");
+        return false;
+    }
+    /** A batch reads the timestamps of its presses from stdin:                     */
+    if (Applied.i_BatchSize > 1) iStamps = Actions[iAction].Jobs.Stamps(pJob, &pullStamps);
+    if ((iStamps > 0) && ((iInput = CSpawner::BatchInput(pullStamps, iStamps)) < 0)) {
+        syslog(LOG_ERR | LOG_DAEMON, "FAILURE CREATING A PIPE FOR THE EXECUTABLE CLIENT!");
+        close(OutPipe[0]);
+        close(OutPipe[1]);
+        return false;
+    }
+    iControl = OpenControl(pJob);
+    for (iEnv=0; environ[iEnv] != 0; iEnv++);
+    ppEnv = new char*[iEnv + 3];
+    for (i=0; i<iEnv; i++) ppEnv[i] = environ[i];
+    if (iInput >= 0) {
+        snprintf(sBatch, sizeof(sBatch), SPAWN_BATCH_ENV "=%i", iStamps);
+        ppEnv[iEnv++] = sBatch;
+    }
+    if (iControl >= 0) {
+        snprintf(sControl, sizeof(sControl), SPAWN_CONTROL_ENV "=%i", SPAWN_CONTROL_FD);
+        ppEnv[iEnv++] = sControl;
+    }
+    ppEnv[iEnv] = 0;
     /** Try to fork to run the executable as client-proccess:                       */        
     pid = fork();
+    if (pid > 0) delete[] ppEnv;
     if (pid < 0) {
+        delete[] ppEnv;
         syslog(LOG_ERR | LOG_DAEMON, "FAILURE FORKING FOR EXECUTABLE CLIENT!");
-        return;
+        close(OutPipe[0]);
+        close(OutPipe[1]);
+        if (iInput >= 0) close(iInput);
+        if (iControl >= 0) close(iControl);
+        return false;
     }
     /** If we got a good PID, then we can return to the main-loop:                  */
     if (pid > 0) {
-        b_ExecRunning = true;
+        if (iInput >= 0) close(iInput);
+        if (iControl >= 0) close(iControl);
+        setpgid(pid, pid);
+        close(OutPipe[1]);
+        fcntl(OutPipe[0], F_SETFL, O_NONBLOCK);
+        pJob->pid = pid;
+        Gpio->Mark(GPIO_MARK_FORK, pid);
+        CaptureOutput(pJob, OutPipe[0]);
+        return true;
+    }
+    /** The client must not inherit the signals blocked for the signalfd:           */
+    setpgid(0, 0);
+    if (! Actions[iAction].Spawner.Confine()) _exit(126);
+    sigemptyset(&Signals);
+    sigprocmask(SIG_SETMASK, &Signals, NULL);
+    /** Its stdout and stderr go into the pipe:                                     */
+    dup2(OutPipe[1], STDOUT_FILENO);
+    dup2(OutPipe[1], STDERR_FILENO);
+    if (iInput >= 0) dup2(iInput, STDIN_FILENO);
+    if (iControl >= 0) dup2(iControl, SPAWN_CONTROL_FD);
+    /** Run it, the daemon has threads, so nothing but exec is safe after the fork: */
+    execve("/bin/bash", pArgv, ppEnv);
+    _exit(127);
+}
+
+int OpenControl(SJob* pJob){
+    /** Variables:                                                                  */
+    int Pair[2], iFd;
+    /** The executable inherits one end, the control-server serves the other:       */
+    if (socketpair(AF_LOCAL, SOCK_STREAM | SOCK_CLOEXEC, 0, Pair) != 0) {
+        syslog(LOG_WARNING | LOG_DAEMON, "FAILURE OPENING THE CONTROL-CHANNEL OF JOB %lu!", pJob->ul_Id);
+        return -1;
+    }
+    if (Pair[1] <= SPAWN_CONTROL_FD) {
+        /** Its number must not collide with the descriptors, it is moved to:       */
+        iFd = fcntl(Pair[1], F_DUPFD_CLOEXEC, SPAWN_CONTROL_FD + 1);
+        close(Pair[1]);
+        Pair[1] = iFd;
+    }
+    fcntl(Pair[0], F_SETFL, O_NONBLOCK);
+    if ((Pair[1] < 0) || (! Control.Adopt(Pair[0], pJob->ul_Id))) {
+        syslog(LOG_WARNING | LOG_DAEMON, "FAILURE OPENING THE CONTROL-CHANNEL OF JOB %lu!", pJob->ul_Id);
+        close(Pair[0]);
+        if (Pair[1] >= 0) close(Pair[1]);
+        return -1;
+    }
+    return Pair[1];
+}
+
+void CaptureOutput(SJob* pJob, int iOutput){
+    /** Collect the output of the run in its record, as it arrives:                 */
+    if (Runs.Begin(pJob->ul_Id, pJob->ull_Started, iOutput) == 0) {
+        syslog(LOG_WARNING | LOG_DAEMON, "FAILURE CAPTURING THE OUTPUT OF JOB %lu!", pJob->ul_Id);
+    }
+}
+
+void StartJobs(){
+    /** Variables:                                                                  */
+    SJob* pJob;
+    int   i;
+    bool  bStarted = false;
+    /** Start as many queued jobs of each button, as may run in parallel:           */
+    for (i=0; i<Applied.i_Buttons; i++) {
+        while ((Applied.ub_ExecMode != EXEC_MODE_PERSISTENT) || (Actions[i].Pool.HasIdle())) {
+            pJob = Actions[i].Jobs.Start(GetTime());
+            if (pJob == 0) break;
+            Notify("start %lu %llu %i %u\n", pJob->ul_Id, pJob->ull_Started, pJob->i_Presses,
+                   Applied.Buttons[i].ui_Pin);
+            Metrics.Count(MET_STARTED);
+            if (pJob->ull_Enqueued != JOB_REPLAYED) Metrics.Record(HIST_WAIT, pJob->ull_Started - pJob->ull_Enqueued);
+            if (Applied.Buttons[i].i_Timeout > 0) pJob->ull_Deadline = pJob->ull_Started + Applied.Buttons[i].i_Timeout * 1000000ULL;
+            if (! RunExecutable(i, pJob)) {
+                FinishJob(i, pJob, -1);
+                continue;
+            }
+            if (pJob->ull_Enqueued != JOB_REPLAYED) Metrics.Record(HIST_SPAWN, GetTime() - pJob->ull_Enqueued);
+            bStarted = true;
+        }
+    }
+    /** The LEDs may show the running jobs:                                         */
+    if ((bStarted) && (LedBusy.i_Steps > 0)) UpdateLeds();
+}
+
+bool QueuePress(unsigned short uwPin, unsigned char ubGesture, unsigned long long ullTimestamp){
+    /** Move a gesture into the job-queue of the action of its button, if any:      */
+    int iAction = ((uwPin < CONFIG_MAX_PIN) && (ubGesture < GESTURE_COUNT)) ? i_ActionOfPin[uwPin][ubGesture] : -1;
+    if (iAction < 0) return false;
+    Metrics.Count(MET_PRESSES);
+    StatusPage.Status.ull_LastPress  = GetRealTime();
+    StatusPage.Status.ui_LastPin     = uwPin;
+    StatusPage.Status.ui_LastGesture = ubGesture;
+    Journal.Press(uwPin, ubGesture, 1);
+    Notify("press %llu %u %s\n", ullTimestamp, uwPin, CGestures::Name(ubGesture));
+    Actions[iAction].Jobs.Push(ullTimestamp);
+    StartJobs();
+    return true;
+}
+
+void HandlePeer(const SNetRecord* pRecord){
+    /** Variables:                                                                  */
+    const char* sGesture;
+    sGesture = (pRecord->ub_Gesture < GESTURE_COUNT) ? CGestures::Name(pRecord->ub_Gesture) : "unknown";
+    if (pRecord->ub_Kind == NET_KIND_RESULT) {
+        Notify("peer %08x finish %u %s %i\n", pRecord->ui_Node, pRecord->uw_Pin, sGesture, pRecord->i_Code);
         return;
     }
-    /** Build the execuable command:                                                */
-    strcpy(buffer, "bash ");
-    strcat(buffer, Config.s_Executable);
-    if (Config.s_ClientLog[0] != 0) {
-        strcat(buffer, " >");
-        strcat(buffer, Config.s_ClientLog);
-    }
-    /** Run it:                                                                     */    
-    iResult = system(buffer);
-    /** If a log-file is configured, add the exit-code:                             */
-    if (Config.s_ClientLog[0] != 0) {
-        fp = fopen(Config.s_ClientLog,"a");
-        if (fp == 0) _exit(1);        
-        sprintf(buffer, "\nbuzzerd: Client exited with code %i.", WEXITSTATUS(iResult));
-        fputs(buffer, fp);
-        fclose(fp);
-    }
-    _exit(WEXITSTATUS(iResult));
-}
-
-void SIG_Alarm (int signum) {
-    /** Variables:                                                                  */
-    static int ul_AliveCount    = 19;
-    static int ul_DebounceCount = 0;       
-    /** Handle the buzzer-state:                                                    */
-    if (! bcm2835_gpio_lev(PIN_BTN)) {
-        /** The level is low, thus the buzzer was pressed:                          */
-        if (ul_DebounceCount == 0) {
-            /** It was not pressed before:                                          */
-            pthread_mutex_lock(&mutex_BuzzCount);
-            ub_BuzzCount ++;
-            pthread_mutex_unlock(&mutex_BuzzCount);
+    /** A press of a peer runs the same action here, but is not sent on:            */
+    Notify("peer %08x press %llu %u %s\n", pRecord->ui_Node, pRecord->ull_Timestamp, pRecord->uw_Pin, sGesture);
+    Metrics.Record(HIST_NET, GetRealTime() - pRecord->ull_Timestamp);
+    QueuePress(pRecord->uw_Pin, pRecord->ub_Gesture, GetTime());
+}
+
+int PendingJobs(){
+    /** Variables:                                                                  */
+    int i, n = 0;
+    /** Count the running and waiting jobs and the held presses of all buttons:     */
+    for (i=0; i<CONFIG_MAX_BUTTONS; i++) {
+        n += Actions[i].Jobs.Running() + Actions[i].Jobs.Queued() + Actions[i].Jobs.Held();
+    }
+    return n;
+}
+
+void FinishJob(int iAction, SJob* pJob, int iExitCode){
+    /** Note the result of the job and free its slot:                               */
+    if (pJob == 0) return;
+    /** A run, which was stopped, reports that instead of its own exit-code:        */
+    if (pJob->ub_Stage == JOB_STAGE_TERMINATED) iExitCode = JOB_EXIT_TIMEOUT;
+    if (pJob->ub_Stage == JOB_STAGE_KILLED    ) iExitCode = JOB_EXIT_KILLED;
+    if ((iExitCode == JOB_EXIT_KILLED) && (pJob->ub_Stage != JOB_STAGE_KILLED)) {
+        syslog(LOG_WARNING | LOG_DAEMON, "JOB %lu WAS KILLED, E.G. BY ITS LIMITS!", pJob->ul_Id);
+    }
+    /** Handle, what the job sent last, its own result only counts, if it exited:   */
+    Control.Release(pJob->ul_Id);
+    if ((iExitCode != JOB_EXIT_TIMEOUT) && (iExitCode != JOB_EXIT_KILLED)) Runs.GetResult(pJob->ul_Id, &iExitCode);
+    Actions[iAction].Jobs.Finish(pJob, iExitCode, GetTime());
+    Journal.Finish(Actions[iAction].ui_JournalPin, Actions[iAction].ub_JournalGesture, pJob->ul_Id, pJob->i_Presses, iExitCode);
+    Notify("finish %lu %llu %i %llu\n", pJob->ul_Id, pJob->ull_Finished, iExitCode,
+           (pJob->ull_Finished - pJob->ull_Started) / 1000ULL);
+    Network.Result(Actions[iAction].ui_JournalPin, Actions[iAction].ub_JournalGesture, iExitCode);
+    StatusPage.Status.i_LastCode     = iExitCode;
+    StatusPage.Status.ull_LastFinish = GetRealTime();
+    NoteResult(iAction, iExitCode);
+    if (iExitCode != 0) Metrics.Count(MET_FAILED);
+    if (iExitCode == JOB_EXIT_TIMEOUT) Metrics.Count(MET_TIMEOUTS);
+    if (iExitCode == JOB_EXIT_KILLED ) Metrics.Count(MET_KILLED);
+    Metrics.Record(HIST_RUN, pJob->ull_Finished - pJob->ull_Started);
+    Gpio->Mark(GPIO_MARK_EXIT, iExitCode);
+    UpdateLeds();
+    /** Complete the record of the run with its exit-code:                          */
+    Runs.Finish(pJob->ul_Id, iExitCode, pJob->ull_Finished);
+}
+
+void NoteResult(int iAction, int iExitCode){
+    /** The LED of the action shows the last result of any of its gestures:         */
+    if (i_LedOfAction[iAction] < 0) return;
+    Leds[i_LedOfAction[iAction]].b_LastResult = (iExitCode == 0);
+    Leds[i_LedOfAction[iAction]].i_LastCode   = iExitCode;
+}
+
+void ReapChildren(){
+    /** Variables:                                                                  */
+    int   iStatus, i;
+    pid_t pid;
+    SJob* pJob;
+    /** Collect all terminated children, workers are handled via their pipes:       */
+    while ((pid = waitpid(-1, &iStatus, WNOHANG)) > 0) {
+        for (i=0; i<CONFIG_MAX_BUTTONS; i++) {
+            pJob = Actions[i].Jobs.FindPid(pid);
+            if (pJob == 0) continue;
+            FinishJob(i, pJob, WIFEXITED(iStatus) ? WEXITSTATUS(iStatus) :
+                               ((WTERMSIG(iStatus) == SIGKILL) || (WTERMSIG(iStatus) == SIGXCPU)) ? JOB_EXIT_KILLED :
+                               JOB_EXIT_FAILED);
+            break;
+        }
+    }
+}
+
+void PrepareSpawner(){
+    /** Variables:                                                                  */
+    int i;
+    /** Resolve the executables and pre-build their arguments and redirections:     */
+    Runs.SetLogFile(Applied.s_ClientLog);
+    OpenCgroup();
+    for (i=0; i<CONFIG_MAX_BUTTONS; i++) {
+        Actions[i].Spawner.Limit(Applied.i_LimitCpu, Applied.i_LimitMemory, i_CgroupProcs);
+        /** The workers of removed buttons or of other exec-modes are stopped:      */
+        if ((i >= Applied.i_Buttons) || (Applied.ub_ExecMode != EXEC_MODE_PERSISTENT)) Actions[i].Pool.Stop();
+        if ((i >= Applied.i_Buttons) || (Applied.ub_ExecMode == EXEC_MODE_SHELL)) continue;
+        if (! Actions[i].Spawner.Prepare(Applied.Buttons[i].s_Executable, Applied.s_ClientLog)) {
+            syslog(LOG_WARNING | LOG_DAEMON, "FAILURE RESOLVING THE EXECUTABLE %s!", Applied.Buttons[i].s_Executable);
+            continue;
         }
-        ul_DebounceCount = 3;
-    }
-    /** Handle the debounce-counter:                                                */
-    if (ul_DebounceCount > 0) ul_DebounceCount--;
-    /** Switch the LED according to its state:                                      */
-    if (Config.ub_LedMode == LED_MODE_ON) {
-        bcm2835_gpio_write(PIN_LED, HIGH);
-    }else if (Config.ub_LedMode == LED_MODE_OFF) {
-        bcm2835_gpio_write(PIN_LED, LOW);
-    }else if (Config.ub_LedMode == LED_MODE_SUCCESS) {
-        if (b_LastResult) {
-            bcm2835_gpio_write(PIN_LED, HIGH);
+        /** Persistent workers are (re-)started with the new executable right away: */
+        if (Applied.ub_ExecMode == EXEC_MODE_PERSISTENT) Actions[i].Pool.Start(&Actions[i].Spawner, Applied.i_Workers);
+    }
+}
+
+void HandleEdges() {
+    /** Variables:                                                                  */
+    unsigned long long ullTimestamp;
+    bool               bFalling;
+    unsigned int       uiPin;
+    /** Drain all queued edges of the buttons, the gestures debounce them:          */
+    while (Gpio->ReadEvent(&ullTimestamp, &bFalling, &uiPin)) Gestures.Edge(uiPin, bFalling, ullTimestamp);
+}
+
+void HandleSignals(int iSignalFd) {
+    /** Variables:                                                                  */
+    struct signalfd_siginfo Info;
+    /** Fetch all pending signals:                                                  */
+    while (read(iSignalFd, &Info, sizeof(Info)) == sizeof(Info)) {
+        if (Info.ssi_signo == SIGCHLD) {
+            ReapChildren();
+        }else if (Info.ssi_signo == SIGHUP) {
+            ReloadConfig();
         }else{
-            bcm2835_gpio_write(PIN_LED, LOW);
+            b_Alive = false;
         }
+    }
+}
+
+void SampleButtons() {
+    /** Read all buttons at once, each bit is a pressed pin, for the gestures:      */
+    Gestures.Sample(Gpio->ReadButtons(), GetTime());
+}
+
+void StartInput(const SConfig* pConfig) {
+    /** A real-time thread reads the buttons, if it may, else the main-loop does:   */
+    if ((pConfig->i_RealtimePriority > 0) &&
+        (Input.Start(Gpio, &Gestures, &Presses, (b_EventInput) ? 0 : SamplePeriod(pConfig),
+                     pConfig->i_RealtimePriority, pConfig->i_RealtimeCpu))) {
+        if (! Input.Realtime()) syslog(LOG_WARNING | LOG_DAEMON, "FAILURE SETTING SCHED_FIFO, THE INPUT-THREAD RUNS AS NORMAL!");
+        if (! Input.Locked())   syslog(LOG_WARNING | LOG_DAEMON, "FAILURE LOCKING THE MEMORY OF THE DAEMON!");
+        return;
+    }
+    if (pConfig->i_RealtimePriority > 0) syslog(LOG_WARNING | LOG_DAEMON, "FAILURE STARTING THE INPUT-THREAD!");
+    Input.Unlock();
+    if (b_EventInput) {
+        AddToEpoll(Gpio->GetFd(), EV_BUTTON);
     }else{
-        ul_AliveCount ++;
-        if (ul_AliveCount == 20) {
-            ul_AliveCount = 0;
-            bcm2835_gpio_write(PIN_LED, LOW );
-        }else if (ul_AliveCount == 10) {;
-            bcm2835_gpio_write(PIN_LED, HIGH);
+        ArmTimer(i_SampleTimer, SamplePeriod(pConfig));
+    }
+}
+
+void StopInput() {
+    /** Whoever read the buttons stops, before the gestures or the GPIO change:     */
+    if (Input.Running()) {
+        Input.Stop();
+    }else if ((b_EventInput) && (Gpio != 0)) {
+        epoll_ctl(i_EpollFd, EPOLL_CTL_DEL, Gpio->GetFd(), NULL);
+    }else{
+        ArmTimer(i_SampleTimer, 0);
+    }
+}
+
+void UpdateLeds() {
+    /** Variables:                                                                  */
+    bool         bRunning[CONFIG_MAX_BUTTONS];
+    SLedPattern  Code;
+    char         sCode[8];
+    const SLedPattern* pPattern;
+    unsigned long long ullNow;
+    int          i;
+    /** Find the LEDs, whose button has a running job:                              */
+    memset(bRunning, 0, sizeof(bRunning));
+    for (i=0; i<CONFIG_MAX_BUTTONS; i++) {
+        if ((i_LedOfAction[i] >= 0) && (Actions[i].Jobs.Running() > 0)) bRunning[i_LedOfAction[i]] = true;
+    }
+    /** Select the pattern of each LED, the sequencer keeps the one playing:        */
+    ullNow = GetTime();
+    for (i=0; i<i_Leds; i++) {
+        if ((bRunning[i]) && (LedBusy.i_Steps > 0)) {
+            pPattern = &LedBusy;
+        }else if (Applied.ub_LedMode != LED_MODE_SUCCESS) {
+            pPattern = &LedMode;
+        }else if (Leds[i].b_LastResult) {
+            pPattern = &LedOn;
+        }else if ((Leds[i].i_LastCode == JOB_EXIT_TIMEOUT) || (Leds[i].i_LastCode == JOB_EXIT_KILLED)) {
+            pPattern = &LedTimeout;
+        }else if ((b_FailureCode) && (Leds[i].i_LastCode != 0)) {
+            /** Blink the exit-code, anything beyond nine blinks nine times:        */
+            snprintf(sCode, sizeof(sCode), "error%i", ((Leds[i].i_LastCode > 0) && (Leds[i].i_LastCode < 9)) ? Leds[i].i_LastCode : 9);
+            CLedSequencer::Parse(sCode, &Code);
+            pPattern = &Code;
+        }else if (Leds[i].i_LastCode != 0) {
+            pPattern = &LedFailure;
+        }else{
+            pPattern = &LedOff;
         }
+        Sequencer.Play(i, pPattern, ullNow);
     }
 }
 
-void SIG_ChildTerm (int signum) {
-    int   iStatus;
-    pid_t pid;
-    /** Try to fetch the return-code of the client-process:                         */
-    pid = waitpid(-1, &iStatus, WNOHANG);
-    if ((pid == 0) || (pid == -1)) {
-        /** Return code unknown:                                                    */
-        b_ExecRunning = false;        
-        b_LastResult  = false;
+void ParsePatterns(const SConfig* pConfig) {
+    /** The patterns were checked, when the configuration was read:                 */
+    CLedSequencer::Parse("on",  &LedOn );
+    CLedSequencer::Parse("off", &LedOff);
+    if      (pConfig->ub_LedMode == LED_MODE_ON     ) CLedSequencer::Parse("on",    &LedMode);
+    else if (pConfig->ub_LedMode == LED_MODE_OFF    ) CLedSequencer::Parse("off",   &LedMode);
+    else if (pConfig->ub_LedMode == LED_MODE_ALIVE  ) CLedSequencer::Parse("alive", &LedMode);
+    else if (pConfig->ub_LedMode == LED_MODE_PATTERN) CLedSequencer::Parse(pConfig->s_LedPattern, &LedMode);
+    LedBusy.i_Steps = 0;
+    if (pConfig->s_LedBusy[0] != 0) CLedSequencer::Parse(pConfig->s_LedBusy, &LedBusy);
+    b_FailureCode = (strcmp(pConfig->s_LedFailure, "code") == 0);
+    if (! b_FailureCode) CLedSequencer::Parse(pConfig->s_LedFailure, &LedFailure);
+    CLedSequencer::Parse(pConfig->s_LedTimeout, &LedTimeout);
+    Sequencer.SetBrightness(pConfig->i_LedBrightness);
+    snprintf(StatusPage.Status.s_Led, sizeof(StatusPage.Status.s_Led), "%s", LedName(pConfig));
+}
+
+const char* LedName(const SConfig* pConfig) {
+    return (pConfig->ub_LedMode == LED_MODE_ON     ) ? "on"      : (pConfig->ub_LedMode == LED_MODE_OFF  ) ? "off"   :
+           (pConfig->ub_LedMode == LED_MODE_SUCCESS) ? "success" : (pConfig->ub_LedMode == LED_MODE_ALIVE) ? "alive" :
+           pConfig->s_LedPattern;
+}
+
+void OverrideLed(SConfig* pConfig) {
+    /** The LED set via -l replaces the one of the snapshot, until the next reload: */
+    ul_LedChanges = Config.ul_LedChanges;
+    if (Config.ub_LedOverride == 0) return;
+    pConfig->ub_LedMode = Config.ub_LedOverride;
+    if (Config.ub_LedOverride == LED_MODE_PATTERN) strcpy(pConfig->s_LedPattern, Config.s_LedOverride);
+}
+
+bool SameInput(const SConfig* pA, const SConfig* pB) {
+    /** Variables:                                                                  */
+    int i;
+    /** Compare, what the gesture-engine and the input-thread were started with:    */
+    if ((pA->i_SampleRate    != pB->i_SampleRate   ) || (pA->i_RealtimePriority != pB->i_RealtimePriority) ||
+        (pA->i_RealtimeCpu   != pB->i_RealtimeCpu  ) || (pA->i_Debounce   != pB->i_Debounce  ) ||
+        (pA->i_LongPress     != pB->i_LongPress    ) || (pA->i_DoublePress != pB->i_DoublePress) ||
+        (pA->i_HoldRepeat    != pB->i_HoldRepeat   ) || (pA->i_Buttons    != pB->i_Buttons   )) return false;
+    for (i=0; i<pA->i_Buttons; i++) {
+        if ((pA->Buttons[i].ui_Pin != pB->Buttons[i].ui_Pin) || (pA->Buttons[i].ub_Gesture != pB->Buttons[i].ub_Gesture)) return false;
+    }
+    return true;
+}
+
+bool SameButtons(const SConfig* pA, const SConfig* pB, bool bPins) {
+    /** Variables:                                                                  */
+    int i;
+    /** Compare either the pins or the executables of all buttons:                  */
+    if (pA->i_Buttons != pB->i_Buttons) return false;
+    for (i=0; i<pA->i_Buttons; i++) {
+        if ((bPins) && ((pA->Buttons[i].ui_Pin   != pB->Buttons[i].ui_Pin  ) ||
+                        (pA->Buttons[i].i_LedPin != pB->Buttons[i].i_LedPin))) return false;
+        if ((! bPins) && (strcmp(pA->Buttons[i].s_Executable, pB->Buttons[i].s_Executable) != 0)) return false;
+    }
+    return true;
+}
+
+void ApplyConfig() {
+    /** Variables:                                                                  */
+    const SConfig* pConfig;
+    static SConfig Old;
+    bool           bSpawner, bQueue, bInput, bMetrics, bLed, bJournal, bNetwork;
+    int            i;
+    /** An LED set via -l only plays its new pattern, it is no new snapshot:        */
+    pConfig = Config.Get();
+    if (pConfig->ul_Generation == Applied.ul_Generation) {
+        if (Config.ul_LedChanges == ul_LedChanges) return;
+        OverrideLed(&Applied);
+        Notify("led %s\n", LedName(&Applied));
+        ParsePatterns(&Applied);
+        UpdateLeds();
+        return;
+    }
+    /** Find out, which parts really differ from the applied snapshot:              */
+    bInput   = (pConfig->ub_InputMode != Applied.ub_InputMode) || (! SameButtons(pConfig, &Applied, true)) ||
+               (strcmp(pConfig->s_GpioChip,  Applied.s_GpioChip ) != 0) ||
+               (strcmp(pConfig->s_SimInput,  Applied.s_SimInput ) != 0) ||
+               (strcmp(pConfig->s_SimRecord, Applied.s_SimRecord) != 0) ||
+               (strcmp(pConfig->s_TraceRecord, Applied.s_TraceRecord) != 0);
+    bMetrics = (strcmp(pConfig->s_MetricsFile, Applied.s_MetricsFile) != 0) ||
+               (pConfig->i_MetricsInterval != Applied.i_MetricsInterval);
+    bJournal = (strcmp(pConfig->s_Journal, Applied.s_Journal) != 0) || (pConfig->i_JournalSize != Applied.i_JournalSize) ||
+               (pConfig->ub_JournalSync != Applied.ub_JournalSync);
+    bNetwork = (strcmp(pConfig->s_NetListen, Applied.s_NetListen) != 0) || (pConfig->ui_NetNode != Applied.ui_NetNode) ||
+               (strcmp(pConfig->s_NetGroup,  Applied.s_NetGroup ) != 0) || (pConfig->i_Peers    != Applied.i_Peers   ) ||
+               (pConfig->b_NetKey != Applied.b_NetKey) || (memcmp(pConfig->ub_NetKey, Applied.ub_NetKey, 16) != 0) ||
+               (memcmp(pConfig->Peers, Applied.Peers, pConfig->i_Peers * sizeof(SPeer)) != 0);
+    Old      = Applied;
+    Applied  = *pConfig;
+    OverrideLed(&Applied);
+    bLed     = (Applied.ub_LedMode != Old.ub_LedMode) || (Applied.i_LedBrightness != Old.i_LedBrightness) ||
+               (strcmp(Applied.s_LedPattern, Old.s_LedPattern) != 0) ||
+               (strcmp(Applied.s_LedBusy,    Old.s_LedBusy   ) != 0) ||
+               (strcmp(Applied.s_LedFailure, Old.s_LedFailure) != 0) ||
+               (strcmp(Applied.s_LedTimeout, Old.s_LedTimeout) != 0);
+    Notify("config %lu\n", Applied.ul_Generation);
+    /** Other pins or another input reopen the GPIO, else the old ones again:       */
+    if ((bInput) && (! ReopenGpio(&Applied))) {
+        syslog(LOG_ERR | LOG_DAEMON, "FAILURE ACCESSING THE GPIO HARDWARE, KEEPING THE OLD BUTTONS!");
+        if (! ReopenGpio(&Old)) {
+            syslog(LOG_ERR | LOG_DAEMON, "FAILURE ACCESSING THE GPIO HARDWARE!");
+            b_Alive = false;
+            return;
+        }
+        Applied.ub_InputMode = Old.ub_InputMode;
+        Applied.i_Buttons    = Old.i_Buttons;
+        memcpy(Applied.Buttons, Old.Buttons, sizeof(Old.Buttons));
+        strcpy(Applied.s_GpioChip,  Old.s_GpioChip );
+        strcpy(Applied.s_SimInput,  Old.s_SimInput );
+        strcpy(Applied.s_SimRecord, Old.s_SimRecord);
+        strcpy(Applied.s_TraceRecord, Old.s_TraceRecord);
+    }
+    bSpawner = (! SameButtons(&Applied, &Old, false)) || (strcmp(Applied.s_ClientLog, Old.s_ClientLog) != 0) ||
+               (Applied.ub_ExecMode != Old.ub_ExecMode) || (Applied.i_Workers != Old.i_Workers) ||
+               (Applied.i_LimitCpu  != Old.i_LimitCpu ) || (Applied.i_LimitMemory != Old.i_LimitMemory) ||
+               (strcmp(Applied.s_Cgroup, Old.s_Cgroup) != 0) || (strcmp(Applied.s_CpuMax, Old.s_CpuMax) != 0) ||
+               (strcmp(Applied.s_MemoryMax, Old.s_MemoryMax) != 0);
+    bQueue   = (Applied.i_QueueSize   != Old.i_QueueSize  ) || (Applied.i_Buttons   != Old.i_Buttons  ) ||
+               (Applied.i_MaxParallel != Old.i_MaxParallel) || (Applied.ub_Overflow != Old.ub_Overflow) ||
+               (Applied.i_BatchSize   != Old.i_BatchSize  ) || (Applied.i_BatchWindow != Old.i_BatchWindow);
+    /** The queued jobs are kept, only the limits of the queues change:             */
+    for (i=0; (bQueue) && (i<Applied.i_Buttons); i++) {
+        Actions[i].Jobs.SetBatch(Applied.i_BatchSize, Applied.i_BatchWindow * 1000000ULL);
+        if (! Actions[i].Jobs.Reconfigure(Applied.i_QueueSize, Applied.i_MaxParallel, Applied.ub_Overflow)) {
+            syslog(LOG_WARNING | LOG_DAEMON, "FAILURE RESIZING THE JOB-QUEUE, KEEPING ITS LIMITS!");
+            Applied.i_QueueSize   = Old.i_QueueSize;
+            Applied.i_MaxParallel = Old.i_MaxParallel;
+            Applied.ub_Overflow   = Old.ub_Overflow;
+            break;
+        }
+    }
+    /** Removed buttons will never start their waiting jobs:                        */
+    for (i=Applied.i_Buttons; i<Old.i_Buttons; i++) Actions[i].Jobs.Clear();
+    /** The presses of other buttons are moved to their keys in the journal:        */
+    JournalActions();
+    if (bJournal) OpenJournal(false);
+    /** A new executable has to be resolved again:                                  */
+    if (bSpawner) PrepareSpawner();
+    /** The input restarts only for other gestures or timing, else keeps sampling:  */
+    if ((! bInput) && (! SameInput(&Applied, &Old))) {
+        StopInput();
+        MapPins(&Applied);
+        StartInput(&Applied);
+    }else if (! bInput) {
+        MapActions(&Applied);
+    }
+    /** The peers change as a whole, the records of this iteration go to the old:   */
+    if (bNetwork) {
+        Network.Flush();
+        if (! Network.Open(&Applied, i_EpollFd, EV_NETWORK)) {
+            syslog(LOG_ERR | LOG_DAEMON, "FAILURE OPENING THE NETWORK, CONTINUING WITHOUT IT!");
+        }
+    }
+    /** The metrics are rewritten with the new interval or to the new file:         */
+    if (bMetrics) {
+        ArmTimer(i_MetricsTimer, (Applied.s_MetricsFile[0] != 0) ? Applied.i_MetricsInterval * 1000000000ULL : 0);
+    }
+    /** The LEDs start their new patterns right away:                               */
+    if (bLed) {
+        Notify("led %s\n", LedName(&Applied));
+        ParsePatterns(&Applied);
+        UpdateLeds();
+    }
+}
+
+void OpenJournal(bool bReplay) {
+    /** Variables:                                                                  */
+    unsigned int  uiPin;
+    unsigned char ubGesture;
+    int           i, n, iReplayed = 0;
+    /** Without a file, the presses are only kept in memory:                        */
+    JournalActions();
+    if (Applied.s_Journal[0] == 0) {
+        Journal.Close();
+        return;
+    }
+    if (! Journal.Open(Applied.s_Journal, Applied.i_JournalSize, Applied.ub_JournalSync, bReplay)) {
+        syslog(LOG_WARNING | LOG_DAEMON, "FAILURE OPENING THE JOURNAL %s, PRESSES ARE NOT KEPT!", Applied.s_Journal);
+        return;
+    }
+    if (! bReplay) return;
+    /** Queue the pending presses again, those of removed buttons are dropped:      */
+    for (uiPin=0; uiPin<CONFIG_MAX_PIN; uiPin++) {
+        for (ubGesture=0; ubGesture<GESTURE_COUNT; ubGesture++) {
+            n = Journal.Pending(uiPin, ubGesture);
+            if (n < 1) continue;
+            if (i_ActionOfPin[uiPin][ubGesture] < 0) {
+                syslog(LOG_WARNING | LOG_DAEMON, "FAILURE REPLAYING %i PRESSES OF GPIO %u WITHOUT AN ACTION!", n, uiPin);
+                Journal.Drop(uiPin, ubGesture, n);
+                continue;
+            }
+            /** Their time is lost, so they are marked, not timed as the restart:   */
+            for (i=0; i<n; i++) Actions[i_ActionOfPin[uiPin][ubGesture]].Jobs.Push(JOB_REPLAYED);
+            iReplayed += n;
+        }
+    }
+    if (iReplayed == 0) return;
+    syslog(LOG_NOTICE | LOG_DAEMON, "Replayed %i presses from the journal.", iReplayed);
+    StartJobs();
+}
+
+void JournalActions() {
+    /** Variables:                                                                  */
+    SAction* pAction;
+    int      i, n;
+    /** Journal the presses, which the queue of each action dropped:                */
+    for (i=0; i<CONFIG_MAX_BUTTONS; i++) {
+        pAction = &Actions[i];
+        if (pAction->Jobs.ul_Dropped != pAction->ul_Journaled) {
+            Journal.Drop(pAction->ui_JournalPin, pAction->ub_JournalGesture, pAction->Jobs.ul_Dropped - pAction->ul_Journaled);
+            pAction->ul_Journaled = pAction->Jobs.ul_Dropped;
+        }
+        /** An action, which now serves another button, takes its presses along:    */
+        if ((i >= Applied.i_Buttons) || ((pAction->ui_JournalPin     == Applied.Buttons[i].ui_Pin    ) &&
+                                         (pAction->ub_JournalGesture == Applied.Buttons[i].ub_Gesture))) continue;
+        n = pAction->Jobs.Presses();
+        Journal.Drop (pAction->ui_JournalPin, pAction->ub_JournalGesture, n);
+        pAction->ui_JournalPin     = Applied.Buttons[i].ui_Pin;
+        pAction->ub_JournalGesture = Applied.Buttons[i].ub_Gesture;
+        Journal.Press(pAction->ui_JournalPin, pAction->ub_JournalGesture, n);
+    }
+}
+
+bool ReopenGpio(const SConfig* pConfig) {
+    /** Variables:                                                                  */
+    int i;
+    /** The old backend releases its pins first, the new one may claim the same:    */
+    if (Gpio != 0) {
+        StopInput();
+        for (i=0; i<CONFIG_MAX_BUTTONS; i++) Gpio->WriteLed(i, false);
+        Gpio->Close();
+        delete Gpio;
+    }
+    Gpio = CreateGpioBackend(pConfig);
+    if (Gpio == 0) return false;
+    Gestures.Reset();
+    /** Either wait for its edges or sample it:                                     */
+    b_EventInput = (Gpio->GetFd() >= 0);
+    MapPins(pConfig);
+    StartInput(pConfig);
+    /** The new LEDs do not show anything yet:                                      */
+    Sequencer.Attach(Gpio, i_Leds);
+    UpdateLeds();
+    syslog(LOG_NOTICE | LOG_DAEMON, "Reopened the GPIO with %i buttons.", pConfig->i_Buttons);
+    return true;
+}
+
+void MapPins(const SConfig* pConfig) {
+    /** Variables:                                                                  */
+    unsigned long long ullGestures[GESTURE_COUNT];
+    int                i;
+    /** Polling debounces with a shift-register, the edges with the debounce-time:  */
+    MapActions(pConfig);
+    memset(ullGestures, 0, sizeof(ullGestures));
+    for (i=0; i<pConfig->i_Buttons; i++) ullGestures[pConfig->Buttons[i].ub_Gesture] |= 1ULL << pConfig->Buttons[i].ui_Pin;
+    Gestures.Configure(&Presses, ullGestures, pConfig->i_Debounce * 1000000ULL, (b_EventInput) ? 0 : SamplePeriod(pConfig),
+                       pConfig->i_LongPress * 1000000ULL, pConfig->i_DoublePress * 1000000ULL,
+                       pConfig->i_HoldRepeat * 1000000ULL);
+}
+
+void MapActions(const SConfig* pConfig) {
+    /** Variables:                                                                  */
+    unsigned int       uiPins[CONFIG_MAX_BUTTONS];
+    int                iLedPins[CONFIG_MAX_BUTTONS];
+    const SButton*     pButton;
+    int                i, j;
+    /** Each gesture is routed to the action of its pin, which has its own LED:     */
+    for (i=0; i<CONFIG_MAX_PIN; i++) {
+        for (j=0; j<GESTURE_COUNT; j++) i_ActionOfPin[i][j] = -1;
+    }
+    for (i=0; i<CONFIG_MAX_BUTTONS; i++) i_LedOfAction[i] = -1;
+    i_Leds = UniquePins(pConfig, uiPins, iLedPins);
+    for (i=0; i<pConfig->i_Buttons; i++) {
+        pButton = &pConfig->Buttons[i];
+        i_ActionOfPin[pButton->ui_Pin][pButton->ub_Gesture] = i;
+        for (j=0; (j<i_Leds) && (uiPins[j] != pButton->ui_Pin); j++);
+        i_LedOfAction[i] = j;
+    }
+}
+
+void WatchConfig() {
+    /** Variables:                                                                  */
+    char  sDirectory[4096];
+    char* p;
+    /** Editors often replace the file, so the directory is watched for it:         */
+    i_ConfigWatch = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (i_ConfigWatch < 0) {
+        syslog(LOG_WARNING | LOG_DAEMON, "FAILURE WATCHING THE CONFIGURATION, ONLY RELOADING ON REQUEST!");
+        return;
+    }
+    strncpy(sDirectory, Config.FileName(), sizeof(sDirectory) - 1);
+    sDirectory[sizeof(sDirectory) - 1] = 0;
+    p = strrchr(sDirectory, '/');
+    if (p != 0) *p = 0;
+    if ((inotify_add_watch(i_ConfigWatch, (sDirectory[0] != 0) ? sDirectory : "/", IN_CLOSE_WRITE | IN_MOVED_TO) < 0) ||
+        (! AddToEpoll(i_ConfigWatch, EV_CONFIG))) {
+        syslog(LOG_WARNING | LOG_DAEMON, "FAILURE WATCHING THE CONFIGURATION, ONLY RELOADING ON REQUEST!");
+        close(i_ConfigWatch);
+        i_ConfigWatch = -1;
+    }
+}
+
+void HandleConfigWatch() {
+    /** Variables:                                                                  */
+    char  Buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    struct inotify_event* pEvent;
+    const char* sName;
+    char* p;
+    int   n;
+    bool  bChanged = false;
+    /** Only the configuration-file itself is of interest in its directory:         */
+    sName = strrchr(Config.FileName(), '/');
+    sName = (sName != 0) ? sName + 1 : Config.FileName();
+    while ((n = read(i_ConfigWatch, Buffer, sizeof(Buffer))) > 0) {
+        for (p = Buffer; p < Buffer + n; p += sizeof(struct inotify_event) + pEvent->len) {
+            pEvent = (struct inotify_event*) p;
+            if ((pEvent->len > 0) && (strcmp(pEvent->name, sName) == 0)) bChanged = true;
+        }
+    }
+    if (bChanged) ReloadConfig();
+}
+
+void ReloadConfig() {
+    /** A broken file is only reported, the daemon keeps running as it is:          */
+    if (Config.Busy()) {
+        syslog(LOG_WARNING | LOG_DAEMON, "FAILURE RELOADING %s, TOO MANY CHANGES WITHIN A SECOND!", Config.FileName());
+    }else if (Config.Reload()) {
+        syslog(LOG_NOTICE | LOG_DAEMON, "Reloaded %s.", Config.FileName());
     }else{
-        b_ExecRunning = false;        
-        if (WEXITSTATUS(iStatus) == 0) {
-            /** Return code success:                                                */
-            b_LastResult = true;
+        syslog(LOG_WARNING | LOG_DAEMON, "FAILURE RELOADING %s, KEEPING THE CONFIGURATION!", Config.FileName());
+    }
+}
+
+void Notify(const char* sFormat, ...) {
+    /** Variables:                                                                  */
+    char    sRecord[256];
+    va_list Args;
+    /** Only format the record, if anybody has subscribed to it:                    */
+    if (Control.Subscribers() == 0) return;
+    va_start(Args, sFormat);
+    vsnprintf(sRecord, sizeof(sRecord), sFormat, Args);
+    va_end(Args);
+    Control.Publish(sRecord);
+}
+
+void ArmAt(int iTimerFd, unsigned long long ullDue, unsigned long long* pullArmed) {
+    /** Variables:                                                                  */
+    struct itimerspec Timer;
+    /** The one-shot timer is only set again, if its time has changed, 0 disarms:   */
+    if (ullDue == *pullArmed) return;
+    *pullArmed = ullDue;
+    memset(&Timer, 0, sizeof(Timer));
+    Timer.it_value.tv_sec  = ullDue / 1000000000ULL;
+    Timer.it_value.tv_nsec = ullDue % 1000000000ULL;
+    timerfd_settime(iTimerFd, TFD_TIMER_ABSTIME, &Timer, NULL);
+}
+
+void ArmTimer(int iTimerFd, unsigned long long ullPeriod) {
+    /** Variables:                                                                  */
+    struct itimerspec Timer;
+    /** A period of zero disarms the timer:                                         */
+    Timer.it_interval.tv_sec  = ullPeriod / 1000000000ULL;
+    Timer.it_interval.tv_nsec = ullPeriod % 1000000000ULL;
+    Timer.it_value            = Timer.it_interval;
+    timerfd_settime(iTimerFd, 0, &Timer, NULL);
+}
+
+unsigned long long NextBatch() {
+    /** Variables:                                                                  */
+    unsigned long long ullNow = GetTime();
+    unsigned long long ullDue, ullNext = 0;
+    int                i;
+    /** The earliest window of all batches, which still wait for presses:           */
+    if (Applied.i_BatchSize < 2) return 0;
+    for (i=0; i<Applied.i_Buttons; i++) {
+        ullDue = Actions[i].Jobs.NextBatch(ullNow);
+        if ((ullDue != 0) && ((ullNext == 0) || (ullDue < ullNext))) ullNext = ullDue;
+    }
+    return ullNext;
+}
+
+unsigned long long NextTimeout() {
+    /** Variables:                                                                  */
+    unsigned long long ullDue, ullNext = 0;
+    int                i;
+    /** The earliest timeout or grace-time of all running jobs:                     */
+    for (i=0; i<Applied.i_Buttons; i++) {
+        ullDue = Actions[i].Jobs.NextDeadline();
+        if ((ullDue != 0) && ((ullNext == 0) || (ullDue < ullNext))) ullNext = ullDue;
+    }
+    return ullNext;
+}
+
+void ExpireJobs() {
+    /** Variables:                                                                  */
+    unsigned long long ullNow = GetTime();
+    SJob* pJob;
+    pid_t pid;
+    int   i;
+    /** Terminate the runs, which are overdue, and kill them after the grace-time:  */
+    for (i=0; i<CONFIG_MAX_BUTTONS; i++) {
+        while ((pJob = Actions[i].Jobs.Overdue(ullNow)) != 0) {
+            pid = (pJob->pid > 0) ? pJob->pid : Actions[i].Pool.FindWorker(pJob->ul_Id);
+            if (pJob->ub_Stage == JOB_STAGE_RUNNING) {
+                syslog(LOG_WARNING | LOG_DAEMON, "JOB %lu TIMED OUT AFTER %llu ms, TERMINATING IT!", pJob->ul_Id,
+                       (ullNow - pJob->ull_Started) / 1000000ULL);
+                pJob->ub_Stage     = JOB_STAGE_TERMINATED;
+                pJob->ull_Deadline = ullNow + Applied.i_KillGrace * 1000000ULL;
+                if (pid > 0) Stop(pid, SIGTERM);
+            }else{
+                syslog(LOG_WARNING | LOG_DAEMON, "JOB %lu IGNORED SIGTERM, KILLING IT!", pJob->ul_Id);
+                pJob->ub_Stage     = JOB_STAGE_KILLED;
+                pJob->ull_Deadline = 0;
+                if (pid > 0) Stop(pid, SIGKILL);
+            }
+        }
+    }
+}
+
+void Stop(pid_t pid, int iSignal) {
+    /** The whole process-group of the run, else just the process, if it has none:  */
+    if (kill(-pid, iSignal) != 0) kill(pid, iSignal);
+}
+
+void OpenCgroup() {
+    /** Variables:                                                                  */
+    char  sParent[1100];
+    char* pSlash;
+    /** Without a cgroup, the runs stay in the one of the daemon:                   */
+    if (i_CgroupProcs >= 0) close(i_CgroupProcs);
+    i_CgroupProcs = -1;
+    if (Applied.s_Cgroup[0] == 0) return;
+    /** The parent has to pass its controllers on, it may already do so:            */
+    strcpy(sParent, Applied.s_Cgroup);
+    pSlash = strrchr(sParent, '/');
+    if (pSlash != 0) {
+        *pSlash = 0;
+        if (Applied.s_CpuMax[0]    != 0) WriteCgroup(sParent, "cgroup.subtree_control", "+cpu");
+        if (Applied.s_MemoryMax[0] != 0) WriteCgroup(sParent, "cgroup.subtree_control", "+memory");
+    }
+    if ((mkdir(Applied.s_Cgroup, 0755) != 0) && (errno != EEXIST)) {
+        syslog(LOG_WARNING | LOG_DAEMON, "FAILURE CREATING THE CGROUP %s!", Applied.s_Cgroup);
+        return;
+    }
+    if ((Applied.s_CpuMax[0] != 0) && (! WriteCgroup(Applied.s_Cgroup, "cpu.max", Applied.s_CpuMax))) {
+        syslog(LOG_WARNING | LOG_DAEMON, "FAILURE SETTING cpu.max OF THE CGROUP %s!", Applied.s_Cgroup);
+    }
+    if ((Applied.s_MemoryMax[0] != 0) && (! WriteCgroup(Applied.s_Cgroup, "memory.max", Applied.s_MemoryMax))) {
+        syslog(LOG_WARNING | LOG_DAEMON, "FAILURE SETTING memory.max OF THE CGROUP %s!", Applied.s_Cgroup);
+    }
+    /** Each run is moved in there by writing its PID:                              */
+    snprintf(sParent, sizeof(sParent), "%s/cgroup.procs", Applied.s_Cgroup);
+    i_CgroupProcs = open(sParent, O_WRONLY | O_CLOEXEC);
+    if (i_CgroupProcs < 0) syslog(LOG_WARNING | LOG_DAEMON, "FAILURE OPENING THE CGROUP %s!", Applied.s_Cgroup);
+}
+
+bool WriteCgroup(const char* sDir, const char* sFile, const char* sValue) {
+    /** Variables:                                                                  */
+    char sPath[1200];
+    int  iFd, n;
+    bool bResult;
+    /** Each value is written at once, as the kernel takes it:                      */
+    snprintf(sPath, sizeof(sPath), "%s/%s", sDir, sFile);
+    iFd = open(sPath, O_WRONLY | O_CLOEXEC);
+    if (iFd < 0) return false;
+    n = strlen(sValue);
+    bResult = (write(iFd, sValue, n) == n);
+    close(iFd);
+    return bResult;
+}
+
+unsigned long long SamplePeriod(const SConfig* pConfig) {
+    /** The buttons are sampled with the configured rate:                           */
+    return 1000000000ULL / pConfig->i_SampleRate;
+}
+
+bool AddToEpoll(int iFd, unsigned int uiTag) {
+    /** Variables:                                                                  */
+    struct epoll_event Event;
+    /** The tag is kept in the upper half, the descriptor in the lower:             */
+    memset(&Event, 0, sizeof(Event));
+    Event.events   = EPOLLIN;
+    Event.data.u64 = ((unsigned long long) uiTag << 32) | (unsigned int) iFd;
+    return (epoll_ctl(i_EpollFd, EPOLL_CTL_ADD, iFd, &Event) == 0);
+}
+
+int ListenFd() {
+    /** Variables:                                                                  */
+    const char* sPid = getenv("LISTEN_PID");
+    const char* sFds = getenv("LISTEN_FDS");
+    struct stat Stat;
+    int         iFd  = -1;
+    /** Only the first of the sockets passed on to this very process is used:       */
+    if ((sPid != 0) && (sFds != 0) && (atoi(sPid) == getpid()) && (atoi(sFds) >= 1)) {
+        iFd = LISTEN_FDS_START;
+        if ((fstat(iFd, &Stat) != 0) || (! S_ISSOCK(Stat.st_mode))) {
+            iFd = -1;
         }else{
-            /** Return code error:                                                  */
-            b_LastResult = false;
+            fcntl(iFd, F_SETFL, fcntl(iFd, F_GETFL) | O_NONBLOCK);
+            fcntl(iFd, F_SETFD, FD_CLOEXEC);
         }
     }
+    /** The executables must not take the sockets for their own:                    */
+    unsetenv("LISTEN_PID");
+    unsetenv("LISTEN_FDS");
+    unsetenv("LISTEN_FDNAMES");
+    return iFd;
+}
+
+void NotifyManager(const char* sFormat, ...) {
+    /** Variables:                                                                  */
+    struct sockaddr_un Address;
+    char    sMessage[256];
+    va_list Arguments;
+    int     iFd, iLength;
+    /** Only a service-manager of type notify passes on its socket:                 */
+    if ((s_NotifySocket[0] != '/') && (s_NotifySocket[0] != '@')) return;
+    va_start(Arguments, sFormat);
+    iLength = vsnprintf(sMessage, sizeof(sMessage), sFormat, Arguments);
+    va_end(Arguments);
+    if ((iLength <= 0) || (iLength >= (int) sizeof(sMessage))) return;
+    /** A leading '@' names a socket in the abstract namespace:                     */
+    memset(&Address, 0, sizeof(Address));
+    Address.sun_family = AF_UNIX;
+    memcpy(Address.sun_path, s_NotifySocket, sizeof(s_NotifySocket));
+    if (Address.sun_path[0] == '@') Address.sun_path[0] = 0;
+    iFd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (iFd < 0) return;
+    if (sendto(iFd, sMessage, iLength, MSG_NOSIGNAL, (struct sockaddr *) &Address,
+               offsetof(struct sockaddr_un, sun_path) + strlen(s_NotifySocket)) != iLength) {
+        syslog(LOG_WARNING | LOG_DAEMON, "FAILURE NOTIFYING THE SERVICE-MANAGER!");
+    }
+    close(iFd);
+}
+
+unsigned long long GetTime() {
+    struct timespec Time;
+    /** A replay runs on the virtual time of its trace:                             */
+    if (p_Replay != 0) return p_Replay->ull_Clock;
+    clock_gettime(CLOCK_MONOTONIC, &Time);
+    return (unsigned long long) Time.tv_sec * 1000000000ULL + Time.tv_nsec;
 }
 
-void SIG_Quit (int signum) {
-    b_Alive = false;    
+unsigned long long GetRealTime() {
+    struct timespec Time;
+    clock_gettime(CLOCK_REALTIME, &Time);
+    return (unsigned long long) Time.tv_sec * 1000000000ULL + Time.tv_nsec;
 }
@@ -18,4 +18,5 @@
 
 /** Forward Declarations: ***********************************************************/
 
-int  RunDemon();
+int  RunDemon(const char* sConfigFile, bool bForeground);
+int  RunReplay(const char* sConfigFile, const char* sTrace);
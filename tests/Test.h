@@ -0,0 +1,68 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+
+/** Notes: *************************************************************************** 
+
+Helpers shared by the tests. Each test is a program of its own, which drives one
+unit of the daemon through its public interface, without any hardware, daemon or
+network. A failed check prints its file, line and expression and the test goes on,
+so one run shows all failures. The exit-code is the number of failed checks, which
+lets "make check" stop at the first failing program:
+
+  TEST(Name) { CHECK(a == b); ... }
+  int main() { RUN(Name); return Result(); }
+
+*************************************************************************************/
+
+/** Global Includes: ****************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+/** Local Defines: ******************************************************************/
+
+#define TEST(Name) static void Test##Name()
+#define RUN(Name)  RunTest(#Name, Test##Name)
+#define CHECK(Expression) Check((Expression), #Expression, __FILE__, __LINE__)
+
+/** Helper Functions: ***************************************************************/
+
+static int i_Checks = 0;
+static int i_Failed = 0;
+
+inline void Check(bool bPassed, const char* sExpression, const char* sFile, int iLine) {
+    /** Report a failure, but go on with the other checks:                          */
+    i_Checks++;
+    if (bPassed) return;
+    i_Failed++;
+    printf("  FAILED %s:%i: %s\n", sFile, iLine, sExpression);
+}
+
+inline void RunTest(const char* sName, void (*pTest)()) {
+    /** Variables:                                                                  */
+    int iFailed = i_Failed;
+    pTest();
+    printf("%-6s %s\n", (i_Failed == iFailed) ? "ok" : "FAILED", sName);
+}
+
+inline int Result() {
+    printf("%i checks, %i failed\n", i_Checks, i_Failed);
+    return (i_Failed > 255) ? 255 : i_Failed;
+}
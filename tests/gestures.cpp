@@ -0,0 +1,225 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+
+/** Notes: *************************************************************************** 
+
+Tests of the gesture-engine: short, long, double and repeated presses fed as edges,
+the debouncing of the edges and of the samples and the timestamps of the gestures.
+The engine runs on made-up time, the gestures are popped from its press-ring.
+
+*************************************************************************************/
+
+/** Global Includes: ****************************************************************/
+
+#include "Test.h"
+#include "../src/PressRing.h"
+#include "../src/Gestures.h"
+
+/** Local Defines: ******************************************************************/
+
+#define MS       1000000ULL
+#define T0       (1000 * MS)                    // Time of the first edge.
+#define DEBOUNCE (20 * MS)
+#define LONG     (500 * MS)
+#define DOUBLE   (300 * MS)
+#define REPEAT   (100 * MS)
+
+/** Helper Functions: ***************************************************************/
+
+static void Setup(CGestures* pGestures, CPressRing* pRing, unsigned int uiPin, unsigned int uiGestures,
+                  unsigned long long ullPeriod) {
+    /** Variables:                                                                  */
+    unsigned long long ullPins[GESTURE_COUNT];
+    int i;
+    /** Give the pin the gestures of the bit-mask, e.g. 1 << GESTURE_LONG:          */
+    for (i=0; i<GESTURE_COUNT; i++) ullPins[i] = (uiGestures & (1 << i)) ? (1ULL << uiPin) : 0;
+    pGestures->Configure(pRing, ullPins, DEBOUNCE, ullPeriod, LONG, DOUBLE, REPEAT);
+}
+
+static void Release(CGestures* pGestures, unsigned int uiPin, unsigned long long ullTimestamp) {
+    /** The rising edge only counts, once the line stayed high:                     */
+    pGestures->Edge(uiPin, false, ullTimestamp);
+    pGestures->Expire(ullTimestamp + DEBOUNCE);
+}
+
+static bool Next(CPressRing* pRing, unsigned char ubGesture, unsigned long long ullTimestamp) {
+    /** Variables:                                                                  */
+    SPressEvent Event;
+    if (! pRing->Pop(&Event)) return false;
+    return (Event.ub_Gesture == ubGesture) && (Event.ull_Timestamp == ullTimestamp);
+}
+
+/** Tests: **************************************************************************/
+
+TEST(PressOnly) {
+    CGestures  Gestures;
+    CPressRing Ring;
+    SPressEvent Event;
+    Setup(&Gestures, &Ring, 5, 1 << GESTURE_PRESS, 0);
+    /** Without other gestures, the press is emitted on its edge:                   */
+    Gestures.Edge(5, true, T0);
+    CHECK(Ring.Pop(&Event));
+    CHECK((Event.uw_Pin == 5) && (Event.ub_Gesture == GESTURE_PRESS) && (Event.ull_Timestamp == T0));
+    Release(&Gestures, 5, T0 + 50 * MS);
+    CHECK(! Ring.Pop(&Event));
+    CHECK(Gestures.NextDeadline() == 0);
+}
+
+TEST(EdgeBounces) {
+    CGestures  Gestures;
+    CPressRing Ring;
+    SPressEvent Event;
+    Setup(&Gestures, &Ring, 5, 1 << GESTURE_PRESS, 0);
+    Gestures.Edge(5, true,  T0);
+    CHECK(Next(&Ring, GESTURE_PRESS, T0));
+    /** A release shorter than the debounce-time is a bounce, not a second press:   */
+    Gestures.Edge(5, false, T0 + 50 * MS);
+    Gestures.Edge(5, true,  T0 + 55 * MS);
+    CHECK(! Ring.Pop(&Event));
+    CHECK(Gestures.ul_Bounces.load() == 1);
+    /** A release, which lasted, lets the next edge press again:                    */
+    Release(&Gestures, 5, T0 + 100 * MS);
+    Gestures.Edge(5, true, T0 + 200 * MS);
+    CHECK(Next(&Ring, GESTURE_PRESS, T0 + 200 * MS));
+}
+
+TEST(Long) {
+    CGestures  Gestures;
+    CPressRing Ring;
+    SPressEvent Event;
+    Setup(&Gestures, &Ring, 3, (1 << GESTURE_PRESS) | (1 << GESTURE_LONG), 0);
+    Gestures.Edge(3, true, T0);
+    CHECK(! Ring.Pop(&Event));
+    CHECK(Gestures.NextDeadline() == T0 + LONG);
+    /** Held long enough, it is a long-press at its deadline, not a press:          */
+    Gestures.Expire(T0 + LONG - 1);
+    CHECK(! Ring.Pop(&Event));
+    Gestures.Expire(T0 + LONG);
+    CHECK(Next(&Ring, GESTURE_LONG, T0 + LONG));
+    Release(&Gestures, 3, T0 + 2 * LONG);
+    CHECK(! Ring.Pop(&Event));
+}
+
+TEST(ShortOfLong) {
+    CGestures  Gestures;
+    CPressRing Ring;
+    SPressEvent Event;
+    Setup(&Gestures, &Ring, 3, (1 << GESTURE_PRESS) | (1 << GESTURE_LONG), 0);
+    /** Released before the long-press time, it is a press at the time of its edge: */
+    Gestures.Edge(3, true, T0);
+    Release(&Gestures, 3, T0 + 100 * MS);
+    CHECK(Next(&Ring, GESTURE_PRESS, T0));
+    Gestures.Expire(T0 + 2 * LONG);
+    CHECK(! Ring.Pop(&Event));
+}
+
+TEST(Double) {
+    CGestures  Gestures;
+    CPressRing Ring;
+    SPressEvent Event;
+    Setup(&Gestures, &Ring, 7, (1 << GESTURE_PRESS) | (1 << GESTURE_DOUBLE), 0);
+    /** A second press within the double-press time makes it a double-press:        */
+    Gestures.Edge(7, true, T0);
+    Release(&Gestures, 7, T0 + 50 * MS);
+    CHECK(! Ring.Pop(&Event));
+    Gestures.Edge(7, true, T0 + 200 * MS);
+    CHECK(Next(&Ring, GESTURE_DOUBLE, T0 + 200 * MS));
+    Release(&Gestures, 7, T0 + 250 * MS);
+    Gestures.Expire(T0 + 250 * MS + DOUBLE);
+    CHECK(! Ring.Pop(&Event));
+    /** Without a second press, it is a press once the double-press time is over:   */
+    Gestures.Edge(7, true, T0 + 1000 * MS);
+    Release(&Gestures, 7, T0 + 1050 * MS);
+    CHECK(Gestures.NextDeadline() == T0 + 1050 * MS + DOUBLE);
+    Gestures.Expire(T0 + 1050 * MS + DOUBLE);
+    CHECK(Next(&Ring, GESTURE_PRESS, T0 + 1000 * MS));
+}
+
+TEST(Repeat) {
+    CGestures  Gestures;
+    CPressRing Ring;
+    SPressEvent Event;
+    Setup(&Gestures, &Ring, 2, (1 << GESTURE_LONG) | (1 << GESTURE_REPEAT), 0);
+    /** The long-press comes first, then a repetition every hold-repeat time:       */
+    Gestures.Edge(2, true, T0);
+    Gestures.Expire(T0 + LONG);
+    CHECK(Next(&Ring, GESTURE_LONG, T0 + LONG));
+    Gestures.Expire(T0 + LONG + REPEAT);
+    CHECK(Next(&Ring, GESTURE_REPEAT, T0 + LONG + REPEAT));
+    Gestures.Expire(T0 + LONG + 2 * REPEAT);
+    CHECK(Next(&Ring, GESTURE_REPEAT, T0 + LONG + 2 * REPEAT));
+    /** A late wake-up repeats once, it does not catch up with a burst:             */
+    Gestures.Expire(T0 + LONG + 10 * REPEAT);
+    CHECK(Next(&Ring, GESTURE_REPEAT, T0 + LONG + 10 * REPEAT));
+    CHECK(! Ring.Pop(&Event));
+    Release(&Gestures, 2, T0 + LONG + 10 * REPEAT + MS);
+    Gestures.Expire(T0 + 10 * LONG);
+    CHECK(! Ring.Pop(&Event));
+}
+
+TEST(Samples) {
+    CGestures  Gestures;
+    CPressRing Ring;
+    SPressEvent Event;
+    unsigned long long ullTime = T0;
+    int i;
+    /** With 5 ms per sample, a level is stable after 4 agreeing samples:           */
+    Setup(&Gestures, &Ring, 63, 1 << GESTURE_PRESS, 5 * MS);
+    for (i=0; i<3; i++, ullTime += 5 * MS) Gestures.Sample(1ULL << 63, ullTime);
+    CHECK(! Ring.Pop(&Event));
+    Gestures.Sample(1ULL << 63, ullTime);
+    CHECK(Ring.Pop(&Event));
+    CHECK((Event.uw_Pin == 63) && (Event.ub_Gesture == GESTURE_PRESS) && (Event.ull_Timestamp == T0));
+    /** A glitch shorter than the debounce-time is counted, but not released:       */
+    ullTime += 5 * MS;
+    Gestures.Sample(0, ullTime);
+    Gestures.Sample(1ULL << 63, ullTime + 5 * MS);
+    for (i=0; i<8; i++) Gestures.Sample(1ULL << 63, ullTime + (i + 2) * 5 * MS);
+    CHECK(! Ring.Pop(&Event));
+    CHECK(Gestures.ul_Bounces.load() == 1);
+}
+
+TEST(SampleGlitch) {
+    CGestures  Gestures;
+    CPressRing Ring;
+    SPressEvent Event;
+    int i;
+    Setup(&Gestures, &Ring, 0, 1 << GESTURE_PRESS, 5 * MS);
+    /** A press shorter than the debounce-time never becomes one:                   */
+    Gestures.Sample(1, T0);
+    Gestures.Sample(1, T0 + 5 * MS);
+    for (i=2; i<10; i++) Gestures.Sample(0, T0 + i * 5 * MS);
+    CHECK(! Ring.Pop(&Event));
+    CHECK(Gestures.ul_Bounces.load() == 1);
+}
+
+/** Main-Function: ******************************************************************/
+
+int main() {
+    RUN(PressOnly);
+    RUN(EdgeBounces);
+    RUN(Long);
+    RUN(ShortOfLong);
+    RUN(Double);
+    RUN(Repeat);
+    RUN(Samples);
+    RUN(SampleGlitch);
+    return Result();
+}
@@ -0,0 +1,236 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+
+/** Notes: *************************************************************************** 
+
+Tests of the job-queue: the overflow-policies of a full queue, the presses held back
+by "block", the limit of parallel jobs and the batches with and without a window.
+All timestamps are made up, so the tests do not depend on the clock.
+
+*************************************************************************************/
+
+/** Global Includes: ****************************************************************/
+
+#include "Test.h"
+#include "../src/JobQueue.h"
+
+/** Tests: **************************************************************************/
+
+TEST(DropNewest) {
+    CJobQueue Queue;
+    SJob*     pJob;
+    CHECK(Queue.Init(2, 1, OVERFLOW_DROP_NEWEST));
+    Queue.Push(100);
+    Queue.Push(200);
+    Queue.Push(300);
+    CHECK(Queue.Queued() == 2);
+    CHECK(Queue.ul_Dropped == 1);
+    pJob = Queue.Start(1000);
+    CHECK((pJob != 0) && (pJob->ull_Enqueued == 100));
+}
+
+TEST(DropOldest) {
+    CJobQueue Queue;
+    SJob*     pJob;
+    CHECK(Queue.Init(2, 1, OVERFLOW_DROP_OLDEST));
+    Queue.Push(100);
+    Queue.Push(200);
+    Queue.Push(300);
+    CHECK(Queue.Queued() == 2);
+    CHECK(Queue.ul_Dropped == 1);
+    pJob = Queue.Start(1000);
+    CHECK((pJob != 0) && (pJob->ull_Enqueued == 200));
+}
+
+TEST(Coalesce) {
+    CJobQueue Queue;
+    SJob*     pJob;
+    CHECK(Queue.Init(2, 2, OVERFLOW_COALESCE));
+    Queue.Push(100);
+    Queue.Push(200);
+    Queue.Push(300);
+    Queue.Push(400);
+    CHECK(Queue.Queued() == 2);
+    CHECK(Queue.ul_Coalesced == 2);
+    CHECK(Queue.ul_Dropped == 0);
+    CHECK(Queue.Presses() == 4);
+    pJob = Queue.Start(1000);
+    CHECK((pJob != 0) && (pJob->i_Presses == 1));
+    pJob = Queue.Start(1000);
+    CHECK((pJob != 0) && (pJob->i_Presses == 3) && (pJob->ull_Enqueued == 200));
+}
+
+TEST(Block) {
+    CJobQueue Queue;
+    SJob*     pJob;
+    CHECK(Queue.Init(2, 1, OVERFLOW_BLOCK));
+    Queue.Push(100);
+    Queue.Push(200);
+    Queue.Push(300);
+    Queue.Push(400);
+    /** The held presses are neither queued nor dropped:                            */
+    CHECK(Queue.Queued() == 2);
+    CHECK(Queue.Held() == 2);
+    CHECK(Queue.ul_Dropped == 0);
+    CHECK(Queue.Presses() == 4);
+    /** Starting a job admits the oldest held press with its own timestamp:         */
+    pJob = Queue.Start(1000);
+    CHECK((pJob != 0) && (pJob->ull_Enqueued == 100));
+    CHECK(Queue.Queued() == 2);
+    CHECK(Queue.Held() == 1);
+    Queue.Finish(pJob, 0, 2000);
+    pJob = Queue.Start(3000);
+    Queue.Finish(pJob, 0, 4000);
+    pJob = Queue.Start(5000);
+    CHECK((pJob != 0) && (pJob->ull_Enqueued == 300));
+    CHECK(Queue.Held() == 0);
+}
+
+TEST(BlockMerge) {
+    CJobQueue Queue;
+    SJob*     pJob;
+    CHECK(Queue.Init(1, 1, OVERFLOW_BLOCK));
+    /** Beyond the held ring, the presses merge into the newest held one:           */
+    Queue.Push(100);
+    Queue.Push(200);
+    Queue.Push(300);
+    Queue.Push(400);
+    CHECK(Queue.Held() == 3);
+    CHECK(Queue.Presses() == 4);
+    pJob = Queue.Start(1000);
+    Queue.Finish(pJob, 0, 2000);
+    pJob = Queue.Start(3000);
+    CHECK((pJob != 0) && (pJob->i_Presses == 3) && (pJob->ull_Enqueued == 200));
+    CHECK(Queue.Held() == 0);
+    CHECK(Queue.ul_Dropped == 0);
+}
+
+TEST(Parallel) {
+    CJobQueue Queue;
+    SJob*     pFirst;
+    CHECK(Queue.Init(8, 2, OVERFLOW_BLOCK));
+    Queue.Push(100);
+    Queue.Push(200);
+    Queue.Push(300);
+    pFirst = Queue.Start(1000);
+    CHECK(pFirst != 0);
+    CHECK(Queue.Start(1000) != 0);
+    CHECK(Queue.Start(1000) == 0);
+    CHECK(Queue.Running() == 2);
+    CHECK(Queue.FindId(pFirst->ul_Id) == pFirst);
+    Queue.Finish(pFirst, 3, 2000);
+    CHECK(Queue.LastJob.i_ExitCode == 3);
+    CHECK(Queue.Start(2000) != 0);
+    CHECK(Queue.Queued() == 0);
+}
+
+TEST(Reconfigure) {
+    CJobQueue Queue;
+    SJob*     pJob;
+    CHECK(Queue.Init(4, 1, OVERFLOW_BLOCK));
+    Queue.Push(100);
+    Queue.Push(200);
+    Queue.Push(300);
+    /** A smaller queue keeps the oldest jobs and drops the newest:                 */
+    CHECK(Queue.Reconfigure(2, 1, OVERFLOW_BLOCK));
+    CHECK(Queue.Queued() == 2);
+    CHECK(Queue.ul_Dropped == 1);
+    pJob = Queue.Start(1000);
+    CHECK((pJob != 0) && (pJob->ull_Enqueued == 100));
+    CHECK(! Queue.Reconfigure(0, 1, OVERFLOW_BLOCK));
+}
+
+TEST(Batch) {
+    CJobQueue Queue;
+    SJob*     pJob;
+    const unsigned long long* pullStamps;
+    CHECK(Queue.Init(8, 1, OVERFLOW_BLOCK));
+    CHECK(Queue.SetBatch(3, 0));
+    CHECK(! Queue.SetBatch(JOB_MAX_BATCH + 1, 0));
+    Queue.Push(100);
+    Queue.Push(200);
+    Queue.Push(300);
+    Queue.Push(400);
+    /** Without a window, the batch takes the presses, which are waiting:           */
+    pJob = Queue.Start(1000);
+    CHECK((pJob != 0) && (pJob->i_Presses == 3));
+    CHECK(Queue.Stamps(pJob, &pullStamps) == 3);
+    CHECK((pullStamps[0] == 100) && (pullStamps[1] == 200) && (pullStamps[2] == 300));
+    CHECK(Queue.Queued() == 1);
+}
+
+TEST(BatchWindow) {
+    CJobQueue Queue;
+    SJob*     pJob;
+    CHECK(Queue.Init(8, 1, OVERFLOW_BLOCK));
+    CHECK(Queue.SetBatch(3, 500));
+    Queue.Push(1000);
+    Queue.Push(1100);
+    /** The batch waits for its window, unless it is full earlier:                  */
+    CHECK(Queue.Start(1200) == 0);
+    CHECK(Queue.NextBatch(1200) == 1500);
+    pJob = Queue.Start(1500);
+    CHECK((pJob != 0) && (pJob->i_Presses == 2));
+    Queue.Finish(pJob, 0, 1600);
+    Queue.Push(2000);
+    Queue.Push(2100);
+    Queue.Push(2200);
+    pJob = Queue.Start(2200);
+    CHECK((pJob != 0) && (pJob->i_Presses == 3));
+}
+
+TEST(Replayed) {
+    CJobQueue Queue;
+    SJob*     pJob;
+    CHECK(Queue.Init(8, 1, OVERFLOW_BLOCK));
+    CHECK(Queue.SetBatch(3, 500));
+    /** A replayed press has no time, so its window is over at once:                */
+    Queue.Push(JOB_REPLAYED);
+    pJob = Queue.Start(1000);
+    CHECK((pJob != 0) && (pJob->ull_Enqueued == JOB_REPLAYED));
+}
+
+TEST(Clear) {
+    CJobQueue Queue;
+    CHECK(Queue.Init(1, 1, OVERFLOW_BLOCK));
+    Queue.Push(100);
+    Queue.Push(200);
+    Queue.Clear();
+    CHECK(Queue.Queued() == 0);
+    CHECK(Queue.Held() == 0);
+    CHECK(Queue.ul_Dropped == 2);
+}
+
+/** Main-Function: ******************************************************************/
+
+int main() {
+    RUN(DropNewest);
+    RUN(DropOldest);
+    RUN(Coalesce);
+    RUN(Block);
+    RUN(BlockMerge);
+    RUN(Parallel);
+    RUN(Reconfigure);
+    RUN(Batch);
+    RUN(BatchWindow);
+    RUN(Replayed);
+    RUN(Clear);
+    return Result();
+}
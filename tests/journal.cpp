@@ -0,0 +1,193 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+
+/** Notes: *************************************************************************** 
+
+Tests of the journal: the pending presses after finished and dropped jobs, their
+replay by a fresh journal, as after a restart, the end of the replay at a torn
+record and the compaction of a half full file. Each test uses a file of its own in
+a temporary directory, which is removed afterwards.
+
+*************************************************************************************/
+
+/** Global Includes: ****************************************************************/
+
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "Test.h"
+#include "../src/Journal.h"
+
+/** Local Defines: ******************************************************************/
+
+#define RECORDS 1024                            // The smallest journal.
+
+/** Helper Functions: ***************************************************************/
+
+static char s_Directory[64];
+static char s_File[128];
+
+static const char* NewFile(const char* sName) {
+    /** A file, which does not exist yet:                                           */
+    snprintf(s_File, sizeof(s_File), "%s/%s", s_Directory, sName);
+    unlink(s_File);
+    return s_File;
+}
+
+static bool Corrupt(const char* sFile, int iRecord) {
+    /** Variables:                                                                  */
+    SJournalRecord Record;
+    int  iFd;
+    bool bResult;
+    /** Change a field of the record like a torn write, but not its checksum:       */
+    iFd = open(sFile, O_RDWR);
+    if (iFd < 0) return false;
+    bResult = (pread(iFd, &Record, sizeof(Record), iRecord * sizeof(Record)) == sizeof(Record));
+    Record.i_Presses += 7;
+    bResult = bResult && (pwrite(iFd, &Record, sizeof(Record), iRecord * sizeof(Record)) == sizeof(Record));
+    close(iFd);
+    return bResult;
+}
+
+/** Tests: **************************************************************************/
+
+TEST(Pending) {
+    CJournal Journal;
+    CHECK(Journal.Open(NewFile("pending"), RECORDS, JOURNAL_SYNC_NONE, true));
+    Journal.Press(5, 0, 1);
+    Journal.Press(5, 0, 1);
+    Journal.Press(5, 0, 1);
+    Journal.Press(6, 1, 2);
+    Journal.Finish(5, 0, 1, 1, 0);
+    Journal.Drop(5, 0, 1);
+    CHECK(Journal.Pending(5, 0) == 1);
+    CHECK(Journal.Pending(6, 1) == 2);
+    /** A job, which took more presses than pending, leaves none, not less:         */
+    Journal.Finish(6, 1, 2, 5, 1);
+    CHECK(Journal.Pending(6, 1) == 0);
+    /** Keys out of range are ignored:                                              */
+    Journal.Press(JOURNAL_PINS, 0, 1);
+    Journal.Press(5, JOURNAL_GESTURES, 1);
+    CHECK(Journal.Pending(JOURNAL_PINS, 0) == 0);
+    CHECK(Journal.Pending(5, 0) == 1);
+}
+
+TEST(Replay) {
+    CJournal Journal, Restarted, Other;
+    const char* sFile = NewFile("replay");
+    CHECK(Journal.Open(sFile, RECORDS, JOURNAL_SYNC_BATCH, true));
+    Journal.Press(5, 0, 1);
+    Journal.Press(5, 0, 1);
+    Journal.Press(9, 2, 1);
+    Journal.Finish(5, 0, 1, 1, 0);
+    CHECK(Journal.Service());
+    Journal.Close();
+    /** A fresh journal, as after a restart, reads the pending presses back:        */
+    CHECK(Restarted.Open(sFile, RECORDS, JOURNAL_SYNC_BATCH, true));
+    CHECK(Restarted.Pending(5, 0) == 1);
+    CHECK(Restarted.Pending(9, 2) == 1);
+    /** ... and keeps them, when it is replayed once more:                          */
+    Restarted.Close();
+    CHECK(Other.Open(sFile, RECORDS, JOURNAL_SYNC_BATCH, true));
+    CHECK(Other.Pending(5, 0) == 1);
+    CHECK(Other.Pending(9, 2) == 1);
+    Other.Finish(5, 0, 2, 1, 0);
+    Other.Drop(9, 2, 1);
+    Other.Close();
+    CHECK(Restarted.Open(sFile, RECORDS, JOURNAL_SYNC_BATCH, true));
+    CHECK(Restarted.Pending(5, 0) == 0);
+    CHECK(Restarted.Pending(9, 2) == 0);
+}
+
+TEST(NoReplay) {
+    CJournal Journal, Restarted;
+    const char* sFile = NewFile("noreplay");
+    CHECK(Journal.Open(sFile, RECORDS, JOURNAL_SYNC_NONE, true));
+    Journal.Press(5, 0, 1);
+    Journal.Close();
+    /** Without a replay, the file starts over with the presses in memory:          */
+    CHECK(Restarted.Open(sFile, RECORDS, JOURNAL_SYNC_NONE, false));
+    CHECK(Restarted.Pending(5, 0) == 0);
+    Restarted.Close();
+    CHECK(Journal.Open(sFile, RECORDS, JOURNAL_SYNC_NONE, true));
+    CHECK(Journal.Pending(5, 0) == 0);
+}
+
+TEST(Torn) {
+    CJournal Journal, Restarted;
+    const char* sFile = NewFile("torn");
+    CHECK(Journal.Open(sFile, RECORDS, JOURNAL_SYNC_ALWAYS, true));
+    Journal.Press(5, 0, 1);
+    Journal.Press(5, 0, 1);
+    Journal.Press(5, 0, 1);
+    Journal.Close();
+    /** The replay stops at the first torn record, the ones behind it are lost:     */
+    CHECK(Corrupt(sFile, 1));
+    CHECK(Restarted.Open(sFile, RECORDS, JOURNAL_SYNC_ALWAYS, true));
+    CHECK(Restarted.Pending(5, 0) == 1);
+}
+
+TEST(Compact) {
+    CJournal    Journal, Restarted;
+    struct stat Stat;
+    const char* sFile = NewFile("compact");
+    bool bCompacted = true;
+    int  i;
+    CHECK(Journal.Open(sFile, RECORDS, JOURNAL_SYNC_BATCH, true));
+    /** Many presses and jobs compact the file, which never grows:                  */
+    for (i=0; i<3 * RECORDS; i++) {
+        Journal.Press(i % 4, 0, 1);
+        if (i % 3 != 0) Journal.Finish(i % 4, 0, i, 1, 0);
+        bCompacted = Journal.Service() && bCompacted;
+    }
+    CHECK(bCompacted);
+    CHECK((stat(sFile, &Stat) == 0) && (Stat.st_size == RECORDS * (off_t) sizeof(SJournalRecord)));
+    CHECK(Journal.Pending(0, 0) + Journal.Pending(1, 0) + Journal.Pending(2, 0) + Journal.Pending(3, 0) == RECORDS);
+    Journal.Close();
+    CHECK(Restarted.Open(sFile, RECORDS, JOURNAL_SYNC_BATCH, true));
+    for (i=0; i<4; i++) CHECK(Restarted.Pending(i, 0) == Journal.Pending(i, 0));
+}
+
+/** Main-Function: ******************************************************************/
+
+int main() {
+    /** Variables:                                                                  */
+    int iResult;
+    strcpy(s_Directory, "/tmp/buzzerd-test-XXXXXX");
+    if (mkdtemp(s_Directory) == 0) {
+        printf("ERR: Unable to create a temporary directory!\n");
+        return 1;
+    }
+    RUN(Pending);
+    RUN(Replay);
+    RUN(NoReplay);
+    RUN(Torn);
+    RUN(Compact);
+    iResult = Result();
+    unlink(NewFile("pending"));
+    unlink(NewFile("replay"));
+    unlink(NewFile("noreplay"));
+    unlink(NewFile("torn"));
+    unlink(NewFile("compact"));
+    rmdir(s_Directory);
+    return iResult;
+}
@@ -0,0 +1,310 @@
+//
+//  This file is part of Buzzer-Deamon project
+//  Copyright (C)2020 Jens Daniel Schlachter <osw.schlachter@mailbox.org>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+
+/** Notes: *************************************************************************** 
+
+Tests of the decoding of the network-packets: the records of a valid packet, the
+rejection of replayed, older, forged and malformed packets, the lost packets of a
+gap in the sequence and the restart of a sender. A sender sends its packets to a
+plain socket on the loopback, from which the test passes them on to the receiver,
+as they are or changed on the way.
+
+*************************************************************************************/
+
+/** Global Includes: ****************************************************************/
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "Test.h"
+#include "../src/ConfigHandler.h"
+#include "../src/Network.h"
+
+/** Local Defines: ******************************************************************/
+
+#define SENDER   11
+#define RECEIVER 22
+#define MAX_RECORDS (8 * NET_MAX_RECORDS)
+
+/** Helper Functions: ***************************************************************/
+
+static unsigned long long Now(clockid_t Clock) {
+    struct timespec Time;
+    clock_gettime(Clock, &Time);
+    return (unsigned long long) Time.tv_sec * 1000000000ULL + Time.tv_nsec;
+}
+
+static SConfig Config;
+static int     i_Capture = -1;                  // Takes the packets of all senders.
+static int     i_Inject  = -1;                  // Passes them on to the receivers.
+
+static int Port(int iFd) {
+    /** Variables:                                                                  */
+    struct sockaddr_in Address;
+    socklen_t          Size = sizeof(Address);
+    /** The port, which the kernel picked for the socket:                           */
+    if (getsockname(iFd, (struct sockaddr*) &Address, &Size) != 0) return -1;
+    return ntohs(Address.sin_port);
+}
+
+static int FreePort() {
+    /** Variables:                                                                  */
+    struct sockaddr_in Address;
+    int iFd, iPort;
+    /** Let the kernel pick a port, which is then used by a receiver:               */
+    iFd = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&Address, 0, sizeof(Address));
+    Address.sin_family      = AF_INET;
+    Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if ((iFd < 0) || (bind(iFd, (struct sockaddr*) &Address, sizeof(Address)) != 0)) return -1;
+    iPort = Port(iFd);
+    close(iFd);
+    return iPort;
+}
+
+static void SetKey(SConfig* pConfig, unsigned char ubSeed) {
+    /** Variables:                                                                  */
+    int i;
+    /** A seed of 0 leaves the packets without a MAC:                               */
+    pConfig->b_NetKey = (ubSeed != 0);
+    for (i=0; i<16; i++) pConfig->ub_NetKey[i] = (unsigned char) (ubSeed + i);
+}
+
+static bool OpenSender(CNetwork* pNet, unsigned int uiNode, unsigned char ubSeed) {
+    /** The sender only knows the capture-socket as its peer:                       */
+    memset(&Config, 0, sizeof(Config));
+    Config.ui_NetNode = uiNode;
+    Config.i_Peers    = 1;
+    snprintf(Config.Peers[0].s_Address, sizeof(Config.Peers[0].s_Address), "127.0.0.1:%i", Port(i_Capture));
+    SetKey(&Config, ubSeed);
+    return pNet->Open(&Config, -1, 0);
+}
+
+static int OpenReceiver(CNetwork* pNet, int iEpollFd, unsigned char ubSeed) {
+    /** Variables:                                                                  */
+    int iPort = FreePort();
+    /** The receiver listens on a port of its own and tells it the test:            */
+    memset(&Config, 0, sizeof(Config));
+    Config.ui_NetNode = RECEIVER;
+    snprintf(Config.s_NetListen, sizeof(Config.s_NetListen), "127.0.0.1:%i", iPort);
+    SetKey(&Config, ubSeed);
+    return ((iPort > 0) && (pNet->Open(&Config, iEpollFd, 1))) ? iPort : -1;
+}
+
+static int Capture(CNetwork* pSender, unsigned short uwPin, unsigned char* pPacket) {
+    /** Send one press and take the packet, which carries it:                       */
+    pSender->Press(uwPin, 1, 1000ULL * uwPin);
+    pSender->Flush();
+    return (int) recv(i_Capture, pPacket, NET_PACKET_SIZE, 0);
+}
+
+static int Deliver(CNetwork* pReceiver, int iEpollFd, int iPort, const unsigned char* pPacket, int iLen,
+                   SNetRecord* pRecords) {
+    /** Variables:                                                                  */
+    struct sockaddr_in Address;
+    struct epoll_event Event;
+    /** Pass the packet on and let the receiver decode it like the main-loop:       */
+    memset(&Address, 0, sizeof(Address));
+    Address.sin_family      = AF_INET;
+    Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    Address.sin_port        = htons(iPort);
+    if (sendto(i_Inject, pPacket, iLen, 0, (struct sockaddr*) &Address, sizeof(Address)) != iLen) return -1;
+    if (epoll_wait(iEpollFd, &Event, 1, 1000) != 1) return -1;
+    return pReceiver->HandleEvent((int) (Event.data.u64 & 0xFFFFFFFF), Event.events, pRecords, MAX_RECORDS);
+}
+
+/** Tests: **************************************************************************/
+
+TEST(Records) {
+    CNetwork      Sender, Receiver;
+    SNetRecord    Records[MAX_RECORDS];
+    unsigned char Packet[NET_PACKET_SIZE];
+    unsigned long long ullPressed;
+    int iLen, iPort, iEpollFd = epoll_create1(0);
+    CHECK(OpenSender(&Sender, SENDER, 1));
+    CHECK((iPort = OpenReceiver(&Receiver, iEpollFd, 1)) > 0);
+    /** A press and a result arrive with all their fields, the press in realtime:   */
+    ullPressed = Now(CLOCK_REALTIME) - 1000000000ULL;
+    Sender.Press(5, 2, Now(CLOCK_MONOTONIC) - 1000000000ULL);
+    Sender.Result(5, 2, -3);
+    Sender.Flush();
+    iLen = (int) recv(i_Capture, Packet, sizeof(Packet), 0);
+    CHECK(iLen == NET_HEADER_SIZE + 2 * NET_RECORD_SIZE + NET_MAC_SIZE);
+    CHECK(Deliver(&Receiver, iEpollFd, iPort, Packet, iLen, Records) == 2);
+    CHECK((Records[0].ub_Kind == NET_KIND_PRESS) && (Records[0].uw_Pin == 5) && (Records[0].ub_Gesture == 2));
+    CHECK((llabs((long long) (Records[0].ull_Timestamp - ullPressed)) < 10000000LL) && (Records[0].ui_Node == SENDER));
+    CHECK((Records[1].ub_Kind == NET_KIND_RESULT) && (Records[1].i_Code == -3));
+    CHECK((Receiver.ul_Received == 2) && (Receiver.ul_Rejected == 0) && (Receiver.ul_Lost == 0));
+    close(iEpollFd);
+}
+
+TEST(Replayed) {
+    CNetwork      Sender, Receiver;
+    SNetRecord    Records[MAX_RECORDS];
+    unsigned char First[NET_PACKET_SIZE], Second[NET_PACKET_SIZE];
+    int iFirst, iSecond, iPort, iEpollFd = epoll_create1(0);
+    CHECK(OpenSender(&Sender, SENDER, 1));
+    CHECK((iPort = OpenReceiver(&Receiver, iEpollFd, 1)) > 0);
+    iFirst  = Capture(&Sender, 1, First);
+    iSecond = Capture(&Sender, 2, Second);
+    CHECK(Deliver(&Receiver, iEpollFd, iPort, First,  iFirst,  Records) == 1);
+    CHECK(Deliver(&Receiver, iEpollFd, iPort, Second, iSecond, Records) == 1);
+    /** The same or an older packet never triggers a press again:                   */
+    CHECK(Deliver(&Receiver, iEpollFd, iPort, Second, iSecond, Records) == 0);
+    CHECK(Deliver(&Receiver, iEpollFd, iPort, First,  iFirst,  Records) == 0);
+    CHECK((Receiver.ul_Received == 2) && (Receiver.ul_Rejected == 2));
+    close(iEpollFd);
+}
+
+TEST(Lost) {
+    CNetwork      Sender, Receiver;
+    SNetRecord    Records[MAX_RECORDS];
+    unsigned char Packet[NET_PACKET_SIZE], Late[NET_PACKET_SIZE];
+    int iLen, iLate, iPort, iEpollFd = epoll_create1(0);
+    CHECK(OpenSender(&Sender, SENDER, 1));
+    CHECK((iPort = OpenReceiver(&Receiver, iEpollFd, 1)) > 0);
+    iLen = Capture(&Sender, 1, Packet);
+    CHECK(Deliver(&Receiver, iEpollFd, iPort, Packet, iLen, Records) == 1);
+    /** Two packets go missing, the one after them is accepted and counts them:     */
+    iLate = Capture(&Sender, 2, Late);
+    Capture(&Sender, 3, Packet);
+    iLen = Capture(&Sender, 4, Packet);
+    CHECK(Deliver(&Receiver, iEpollFd, iPort, Packet, iLen, Records) == 1);
+    CHECK(Records[0].uw_Pin == 4);
+    CHECK(Receiver.ul_Lost == 2);
+    /** A missing packet, which arrives late, is too old by then:                   */
+    CHECK(Deliver(&Receiver, iEpollFd, iPort, Late, iLate, Records) == 0);
+    CHECK(Receiver.ul_Rejected == 1);
+    close(iEpollFd);
+}
+
+TEST(Forged) {
+    CNetwork      Sender, Receiver, Stranger;
+    SNetRecord    Records[MAX_RECORDS];
+    unsigned char Packet[NET_PACKET_SIZE], Forged[NET_PACKET_SIZE];
+    int iLen, iPort, iEpollFd = epoll_create1(0);
+    CHECK(OpenSender(&Sender, SENDER, 1));
+    CHECK((iPort = OpenReceiver(&Receiver, iEpollFd, 1)) > 0);
+    iLen = Capture(&Sender, 1, Packet);
+    /** A changed record or MAC is rejected and does not use up the seq:            */
+    memcpy(Forged, Packet, iLen);
+    Forged[NET_HEADER_SIZE + 9] ^= 0x01;
+    CHECK(Deliver(&Receiver, iEpollFd, iPort, Forged, iLen, Records) == 0);
+    memcpy(Forged, Packet, iLen);
+    Forged[iLen - 1] ^= 0x80;
+    CHECK(Deliver(&Receiver, iEpollFd, iPort, Forged, iLen, Records) == 0);
+    CHECK(Receiver.ul_Rejected == 2);
+    CHECK(Deliver(&Receiver, iEpollFd, iPort, Packet, iLen, Records) == 1);
+    /** A sender with another key or without one is rejected as well:               */
+    CHECK(OpenSender(&Stranger, SENDER + 1, 2));
+    iLen = Capture(&Stranger, 1, Packet);
+    CHECK(Deliver(&Receiver, iEpollFd, iPort, Packet, iLen, Records) == 0);
+    CHECK(OpenSender(&Stranger, SENDER + 1, 0));
+    iLen = Capture(&Stranger, 1, Packet);
+    CHECK(Deliver(&Receiver, iEpollFd, iPort, Packet, iLen, Records) == 0);
+    CHECK((Receiver.ul_Rejected == 4) && (Receiver.ul_Received == 1));
+    close(iEpollFd);
+}
+
+TEST(Malformed) {
+    CNetwork      Sender, Receiver;
+    SNetRecord    Records[MAX_RECORDS];
+    unsigned char Packet[NET_PACKET_SIZE], Broken[NET_PACKET_SIZE];
+    int iLen, iPort, iEpollFd = epoll_create1(0);
+    CHECK(OpenSender(&Sender, SENDER, 0));
+    CHECK((iPort = OpenReceiver(&Receiver, iEpollFd, 0)) > 0);
+    iLen = Capture(&Sender, 1, Packet);
+    /** A wrong magic, a short packet and a wrong count are rejected:               */
+    memcpy(Broken, Packet, iLen);
+    Broken[0] = 'X';
+    CHECK(Deliver(&Receiver, iEpollFd, iPort, Broken, iLen, Records) == 0);
+    CHECK(Deliver(&Receiver, iEpollFd, iPort, Packet, NET_HEADER_SIZE, Records) == 0);
+    CHECK(Deliver(&Receiver, iEpollFd, iPort, Packet, iLen - 1, Records) == 0);
+    memcpy(Broken, Packet, iLen);
+    Broken[21] = 2;
+    CHECK(Deliver(&Receiver, iEpollFd, iPort, Broken, iLen, Records) == 0);
+    CHECK(Receiver.ul_Rejected == 4);
+    /** A record of an unknown kind is skipped, the packet itself is fine:          */
+    memcpy(Broken, Packet, iLen);
+    Broken[NET_HEADER_SIZE + 11] = 7;
+    CHECK(Deliver(&Receiver, iEpollFd, iPort, Broken, iLen, Records) == 0);
+    CHECK((Receiver.ul_Rejected == 4) && (Receiver.ul_Received == 0));
+    close(iEpollFd);
+}
+
+TEST(Restart) {
+    CNetwork      Sender, Restarted, Receiver;
+    SNetRecord    Records[MAX_RECORDS];
+    unsigned char Packet[NET_PACKET_SIZE], Old[NET_PACKET_SIZE];
+    int iLen, iOld, iPort, iEpollFd = epoll_create1(0);
+    CHECK(OpenSender(&Sender, SENDER, 1));
+    CHECK((iPort = OpenReceiver(&Receiver, iEpollFd, 1)) > 0);
+    Capture(&Sender, 1, Packet);
+    iOld = Capture(&Sender, 2, Old);
+    iLen = Capture(&Sender, 3, Packet);
+    CHECK(Deliver(&Receiver, iEpollFd, iPort, Packet, iLen, Records) == 1);
+    /** A restarted sender starts its seq over, which is fine with its newer boot:  */
+    usleep(1000);
+    CHECK(OpenSender(&Restarted, SENDER, 1));
+    iLen = Capture(&Restarted, 4, Packet);
+    CHECK(Deliver(&Receiver, iEpollFd, iPort, Packet, iLen, Records) == 1);
+    CHECK(Records[0].uw_Pin == 4);
+    /** Packets of the run before are older now, whatever their seq:                */
+    CHECK(Deliver(&Receiver, iEpollFd, iPort, Old, iOld, Records) == 0);
+    CHECK((Receiver.ul_Received == 2) && (Receiver.ul_Rejected == 1) && (Receiver.ul_Lost == 0));
+    close(iEpollFd);
+}
+
+/** Main-Function: ******************************************************************/
+
+int main() {
+    /** Variables:                                                                  */
+    struct sockaddr_in Address;
+    struct timeval     Timeout;
+    int iResult;
+    /** The capture-socket waits up to a second for each packet of a sender:        */
+    i_Capture = socket(AF_INET, SOCK_DGRAM, 0);
+    i_Inject  = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&Address, 0, sizeof(Address));
+    Address.sin_family      = AF_INET;
+    Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    Timeout.tv_sec  = 1;
+    Timeout.tv_usec = 0;
+    if ((i_Capture < 0) || (i_Inject < 0) || (bind(i_Capture, (struct sockaddr*) &Address, sizeof(Address)) != 0) ||
+        (setsockopt(i_Capture, SOL_SOCKET, SO_RCVTIMEO, &Timeout, sizeof(Timeout)) != 0)) {
+        printf("ERR: Unable to create the sockets on the loopback!\n");
+        return 1;
+    }
+    RUN(Records);
+    RUN(Replayed);
+    RUN(Lost);
+    RUN(Forged);
+    RUN(Malformed);
+    RUN(Restart);
+    iResult = Result();
+    close(i_Capture);
+    close(i_Inject);
+    return iResult;
+}